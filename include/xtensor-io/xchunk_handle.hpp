@@ -0,0 +1,138 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_CHUNK_HANDLE_HPP
+#define XTENSOR_IO_CHUNK_HANDLE_HPP
+
+#include <cstddef>
+#include <utility>
+
+namespace xt
+{
+    /**
+     * @class xchunk_handle
+     * @brief Pinned chunk of a chunk pool.
+     *
+     * A chunk handle gives access to a chunk of a pool and prevents it
+     * from being unloaded as long as the handle is alive. Handles are
+     * movable but not copyable; the pin is released when the handle is
+     * destroyed or reset.
+     *
+     * @tparam EC The type of a chunk
+     * @tparam O The type of the pool owning the chunk, which must provide
+     *           a release_pin(slot) method accessible to the handle
+     */
+    template <class EC, class O>
+    class xchunk_handle
+    {
+    public:
+
+        using chunk_type = EC;
+        using owner_type = O;
+
+        xchunk_handle() noexcept = default;
+        xchunk_handle(owner_type* owner, chunk_type* chunk, std::size_t slot) noexcept;
+        ~xchunk_handle();
+
+        xchunk_handle(const xchunk_handle&) = delete;
+        xchunk_handle& operator=(const xchunk_handle&) = delete;
+
+        xchunk_handle(xchunk_handle&& rhs) noexcept;
+        xchunk_handle& operator=(xchunk_handle&& rhs) noexcept;
+
+        chunk_type& operator*() const noexcept;
+        chunk_type* operator->() const noexcept;
+        chunk_type* get() const noexcept;
+        explicit operator bool() const noexcept;
+
+        void reset();
+
+    private:
+
+        owner_type* p_owner = nullptr;
+        chunk_type* p_chunk = nullptr;
+        std::size_t m_slot = 0;
+    };
+
+    /********************************
+     * xchunk_handle implementation *
+     ********************************/
+
+    template <class EC, class O>
+    inline xchunk_handle<EC, O>::xchunk_handle(owner_type* owner, chunk_type* chunk, std::size_t slot) noexcept
+        : p_owner(owner)
+        , p_chunk(chunk)
+        , m_slot(slot)
+    {
+    }
+
+    template <class EC, class O>
+    inline xchunk_handle<EC, O>::~xchunk_handle()
+    {
+        reset();
+    }
+
+    template <class EC, class O>
+    inline xchunk_handle<EC, O>::xchunk_handle(xchunk_handle&& rhs) noexcept
+        : p_owner(std::exchange(rhs.p_owner, nullptr))
+        , p_chunk(std::exchange(rhs.p_chunk, nullptr))
+        , m_slot(rhs.m_slot)
+    {
+    }
+
+    template <class EC, class O>
+    inline auto xchunk_handle<EC, O>::operator=(xchunk_handle&& rhs) noexcept -> xchunk_handle&
+    {
+        if (this != &rhs)
+        {
+            reset();
+            p_owner = std::exchange(rhs.p_owner, nullptr);
+            p_chunk = std::exchange(rhs.p_chunk, nullptr);
+            m_slot = rhs.m_slot;
+        }
+        return *this;
+    }
+
+    template <class EC, class O>
+    inline auto xchunk_handle<EC, O>::operator*() const noexcept -> chunk_type&
+    {
+        return *p_chunk;
+    }
+
+    template <class EC, class O>
+    inline auto xchunk_handle<EC, O>::operator->() const noexcept -> chunk_type*
+    {
+        return p_chunk;
+    }
+
+    template <class EC, class O>
+    inline auto xchunk_handle<EC, O>::get() const noexcept -> chunk_type*
+    {
+        return p_chunk;
+    }
+
+    template <class EC, class O>
+    inline xchunk_handle<EC, O>::operator bool() const noexcept
+    {
+        return p_chunk != nullptr;
+    }
+
+    template <class EC, class O>
+    inline void xchunk_handle<EC, O>::reset()
+    {
+        if (p_owner != nullptr)
+        {
+            p_owner->release_pin(m_slot);
+            p_owner = nullptr;
+            p_chunk = nullptr;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,749 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_CHUNK_POOL_POLICY_HPP
+#define XTENSOR_IO_CHUNK_POOL_POLICY_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace xt
+{
+    /*
+     * A replacement policy tracks the occupied slots of a chunk pool, and
+     * selects the slot to unload when the pool is full. It must provide
+     * the following methods:
+     *
+     * - reset(pool_size): forgets about all the slots.
+     * - access(slot): the chunk in slot has been accessed again (hit).
+     *   Accesses to the elements of the same chunk in a row count as
+     *   a single access.
+     * - victim(key, evictable): selects an occupied slot for which
+     *   evictable(slot) is true and stops tracking it, key being the
+     *   key of the chunk that is about to be loaded. Returns npos if
+     *   no slot can be unloaded.
+     * - insert(slot, key): the chunk identified by key has been loaded
+     *   in slot (miss). A policy which needs the coordinates of the
+     *   chunk provides insert(slot, key, index) instead.
+     */
+
+    /**
+     * @struct xchunk_pool_stats
+     * @brief Hit and miss counters of a chunk pool.
+     *
+     * Hits are counted per chunk access: consecutive accesses to the
+     * elements of the same chunk count as a single hit.
+     */
+    struct xchunk_pool_stats
+    {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+        std::size_t evictions = 0;
+        std::size_t prefetches = 0;
+
+        double hit_ratio() const;
+    };
+
+    namespace detail
+    {
+        template <class I>
+        inline std::size_t chunk_key(I first, I last)
+        {
+            std::size_t seed = 0;
+            for (auto it = first; it != last; ++it)
+            {
+                seed ^= std::hash<std::size_t>()(static_cast<std::size_t>(*it)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            }
+            return seed;
+        }
+
+        // Set of intrusive doubly-linked lists over the slots of a pool.
+        // A slot belongs to at most one list at a time.
+        class xslot_lists
+        {
+        public:
+
+            static constexpr std::size_t npos = std::size_t(-1);
+
+            void reset(std::size_t pool_size, std::size_t nb_lists);
+
+            void push_back(std::size_t list, std::size_t slot);
+            void erase(std::size_t slot);
+            std::size_t list_of(std::size_t slot) const;
+            std::size_t size(std::size_t list) const;
+
+            template <class F>
+            std::size_t find_front(std::size_t list, F&& pred) const;
+
+        private:
+
+            std::vector<std::size_t> m_prev;
+            std::vector<std::size_t> m_next;
+            std::vector<std::size_t> m_list;
+            std::vector<std::size_t> m_head;
+            std::vector<std::size_t> m_tail;
+            std::vector<std::size_t> m_size;
+        };
+
+        template <class P, class S>
+        using try_insert_index = decltype(std::declval<P&>().insert(std::size_t(0), std::size_t(0), std::declval<const S&>()));
+
+        template <class P, class S, class = void>
+        struct policy_helper
+        {
+            static void insert(P& policy, std::size_t slot, std::size_t key, const S&)
+            {
+                policy.insert(slot, key);
+            }
+        };
+
+        template <class P, class S>
+        struct policy_helper<P, S, std::void_t<try_insert_index<P, S>>>
+        {
+            static void insert(P& policy, std::size_t slot, std::size_t key, const S& index)
+            {
+                policy.insert(slot, key, index);
+            }
+        };
+    }
+
+    /**
+     * @class xlru_policy
+     * @brief Least-recently-used replacement policy for a chunk pool.
+     *
+     * The policy keeps the slots of the pool in an intrusive doubly-linked
+     * list ordered by recency, so that hits run in constant time and
+     * without allocation.
+     */
+    class xlru_policy
+    {
+    public:
+
+        static constexpr std::size_t npos = std::size_t(-1);
+
+        void reset(std::size_t pool_size);
+        void access(std::size_t slot);
+        void insert(std::size_t slot, std::size_t key);
+
+        template <class F>
+        std::size_t victim(std::size_t key, F&& evictable);
+
+    private:
+
+        detail::xslot_lists m_lists;
+    };
+
+    /**
+     * @class xclock_policy
+     * @brief CLOCK (second chance) replacement policy for a chunk pool.
+     *
+     * An approximation of LRU which only sets a reference bit on access,
+     * making hits cheaper than with xlru_policy.
+     */
+    class xclock_policy
+    {
+    public:
+
+        static constexpr std::size_t npos = std::size_t(-1);
+
+        void reset(std::size_t pool_size);
+        void access(std::size_t slot);
+        void insert(std::size_t slot, std::size_t key);
+
+        template <class F>
+        std::size_t victim(std::size_t key, F&& evictable);
+
+    private:
+
+        std::vector<char> m_occupied;
+        std::vector<char> m_referenced;
+        std::size_t m_hand = 0;
+    };
+
+    /**
+     * @class xlfu_policy
+     * @brief Least-frequently-used replacement policy for a chunk pool.
+     *
+     * Unloads the chunk which has been accessed the least number of times
+     * since it was loaded, ties being broken by recency. Suited to access
+     * patterns such as stencils, where some chunks are reused much more
+     * than others.
+     */
+    class xlfu_policy
+    {
+    public:
+
+        static constexpr std::size_t npos = std::size_t(-1);
+
+        void reset(std::size_t pool_size);
+        void access(std::size_t slot);
+        void insert(std::size_t slot, std::size_t key);
+
+        template <class F>
+        std::size_t victim(std::size_t key, F&& evictable);
+
+    private:
+
+        std::vector<std::size_t> m_count;
+        std::vector<std::uint64_t> m_last_access;
+        std::vector<char> m_occupied;
+        std::uint64_t m_clock = 0;
+    };
+
+    /**
+     * @class xarc_policy
+     * @brief Adaptive replacement cache policy for a chunk pool.
+     *
+     * Balances between recency and frequency by keeping track of
+     * recently unloaded chunks (ghost entries), which makes it resistant
+     * to scans and to sliding-window access patterns.
+     */
+    class xarc_policy
+    {
+    public:
+
+        static constexpr std::size_t npos = std::size_t(-1);
+
+        xarc_policy() = default;
+
+        xarc_policy(const xarc_policy& rhs);
+        xarc_policy& operator=(const xarc_policy& rhs);
+
+        xarc_policy(xarc_policy&&) = default;
+        xarc_policy& operator=(xarc_policy&&) = default;
+
+        void reset(std::size_t pool_size);
+        void access(std::size_t slot);
+        void insert(std::size_t slot, std::size_t key);
+
+        template <class F>
+        std::size_t victim(std::size_t key, F&& evictable);
+
+    private:
+
+        enum list_id : std::size_t { t1 = 0, t2 = 1 };
+        enum ghost_id : std::size_t { b1 = 0, b2 = 1 };
+
+        using ghost_list = std::list<std::size_t>;
+        using ghost_entry = std::pair<ghost_id, ghost_list::iterator>;
+
+        std::size_t hit_ghost(std::size_t key);
+        void add_ghost(ghost_id id, std::size_t key);
+        void trim_ghosts();
+
+        detail::xslot_lists m_lists;
+        std::vector<std::size_t> m_keys;
+        ghost_list m_ghosts[2];
+        std::unordered_map<std::size_t, ghost_entry> m_ghost_map;
+        std::size_t m_capacity = 0;
+        std::size_t m_target = 0;
+        // key of the chunk whose ghost entry was hit by the last victim()
+        std::size_t m_ghost_key = 0;
+        bool m_ghost_hit = false;
+    };
+
+    /**
+     * @class xpinned_policy
+     * @brief Replacement policy that never unloads a given set of chunks.
+     *
+     * Chunks are pinned through their coordinates in the chunk grid, and
+     * the other chunks are handled by an underlying policy.
+     *
+     * @tparam P The underlying replacement policy (default: xlru_policy)
+     */
+    template <class P = xlru_policy>
+    class xpinned_policy
+    {
+    public:
+
+        static constexpr std::size_t npos = std::size_t(-1);
+
+        template <class S>
+        void pin(const S& index);
+        template <class S>
+        void unpin(const S& index);
+        void unpin_all();
+
+        void reset(std::size_t pool_size);
+        void access(std::size_t slot);
+
+        template <class S>
+        void insert(std::size_t slot, std::size_t key, const S& index);
+
+        template <class F>
+        std::size_t victim(std::size_t key, F&& evictable);
+
+        P& underlying() noexcept;
+
+    private:
+
+        using index_type = std::vector<std::size_t>;
+
+        void update_slots();
+
+        P m_policy;
+        std::set<index_type> m_pinned_indexes;
+        std::vector<index_type> m_indexes;
+        std::vector<char> m_occupied;
+        std::vector<char> m_pinned;
+    };
+
+    /************************************
+     * xchunk_pool_stats implementation *
+     ************************************/
+
+    inline double xchunk_pool_stats::hit_ratio() const
+    {
+        std::size_t total = hits + misses;
+        return total == 0 ? 0. : static_cast<double>(hits) / static_cast<double>(total);
+    }
+
+    /******************************
+     * xslot_lists implementation *
+     ******************************/
+
+    namespace detail
+    {
+        inline void xslot_lists::reset(std::size_t pool_size, std::size_t nb_lists)
+        {
+            m_prev.assign(pool_size, npos);
+            m_next.assign(pool_size, npos);
+            m_list.assign(pool_size, npos);
+            m_head.assign(nb_lists, npos);
+            m_tail.assign(nb_lists, npos);
+            m_size.assign(nb_lists, 0);
+        }
+
+        inline void xslot_lists::push_back(std::size_t list, std::size_t slot)
+        {
+            m_prev[slot] = m_tail[list];
+            m_next[slot] = npos;
+            if (m_tail[list] != npos)
+            {
+                m_next[m_tail[list]] = slot;
+            }
+            else
+            {
+                m_head[list] = slot;
+            }
+            m_tail[list] = slot;
+            m_list[slot] = list;
+            ++m_size[list];
+        }
+
+        inline void xslot_lists::erase(std::size_t slot)
+        {
+            std::size_t list = m_list[slot];
+            if (list == npos)
+            {
+                return;
+            }
+            std::size_t prev = m_prev[slot];
+            std::size_t next = m_next[slot];
+            if (prev != npos)
+            {
+                m_next[prev] = next;
+            }
+            else
+            {
+                m_head[list] = next;
+            }
+            if (next != npos)
+            {
+                m_prev[next] = prev;
+            }
+            else
+            {
+                m_tail[list] = prev;
+            }
+            m_prev[slot] = npos;
+            m_next[slot] = npos;
+            m_list[slot] = npos;
+            --m_size[list];
+        }
+
+        inline std::size_t xslot_lists::list_of(std::size_t slot) const
+        {
+            return m_list[slot];
+        }
+
+        inline std::size_t xslot_lists::size(std::size_t list) const
+        {
+            return m_size[list];
+        }
+
+        template <class F>
+        inline std::size_t xslot_lists::find_front(std::size_t list, F&& pred) const
+        {
+            std::size_t slot = m_head[list];
+            while (slot != npos && !pred(slot))
+            {
+                slot = m_next[slot];
+            }
+            return slot;
+        }
+    }
+
+    /******************************
+     * xlru_policy implementation *
+     ******************************/
+
+    inline void xlru_policy::reset(std::size_t pool_size)
+    {
+        m_lists.reset(pool_size, 1);
+    }
+
+    inline void xlru_policy::access(std::size_t slot)
+    {
+        m_lists.erase(slot);
+        m_lists.push_back(0, slot);
+    }
+
+    inline void xlru_policy::insert(std::size_t slot, std::size_t)
+    {
+        access(slot);
+    }
+
+    template <class F>
+    inline std::size_t xlru_policy::victim(std::size_t, F&& evictable)
+    {
+        std::size_t slot = m_lists.find_front(0, std::forward<F>(evictable));
+        if (slot != npos)
+        {
+            m_lists.erase(slot);
+        }
+        return slot;
+    }
+
+    /********************************
+     * xclock_policy implementation *
+     ********************************/
+
+    inline void xclock_policy::reset(std::size_t pool_size)
+    {
+        m_occupied.assign(pool_size, 0);
+        m_referenced.assign(pool_size, 0);
+        m_hand = 0;
+    }
+
+    inline void xclock_policy::access(std::size_t slot)
+    {
+        m_referenced[slot] = 1;
+    }
+
+    inline void xclock_policy::insert(std::size_t slot, std::size_t)
+    {
+        m_occupied[slot] = 1;
+        m_referenced[slot] = 1;
+    }
+
+    template <class F>
+    inline std::size_t xclock_policy::victim(std::size_t, F&& evictable)
+    {
+        // give a second chance to the referenced slots,
+        // a candidate is found after at most two full turns
+        std::size_t size = m_occupied.size();
+        for (std::size_t n = 0; n < 2 * size; ++n)
+        {
+            std::size_t slot = m_hand;
+            m_hand = (m_hand + 1) % size;
+            if (m_occupied[slot] && evictable(slot))
+            {
+                if (m_referenced[slot])
+                {
+                    m_referenced[slot] = 0;
+                }
+                else
+                {
+                    m_occupied[slot] = 0;
+                    return slot;
+                }
+            }
+        }
+        return npos;
+    }
+
+    /******************************
+     * xlfu_policy implementation *
+     ******************************/
+
+    inline void xlfu_policy::reset(std::size_t pool_size)
+    {
+        m_count.assign(pool_size, 0);
+        m_last_access.assign(pool_size, 0);
+        m_occupied.assign(pool_size, 0);
+        m_clock = 0;
+    }
+
+    inline void xlfu_policy::access(std::size_t slot)
+    {
+        ++m_count[slot];
+        m_last_access[slot] = ++m_clock;
+    }
+
+    inline void xlfu_policy::insert(std::size_t slot, std::size_t)
+    {
+        m_occupied[slot] = 1;
+        m_count[slot] = 1;
+        m_last_access[slot] = ++m_clock;
+    }
+
+    template <class F>
+    inline std::size_t xlfu_policy::victim(std::size_t, F&& evictable)
+    {
+        // only called on misses, a linear scan is negligible
+        // compared to the loading of a chunk
+        std::size_t res = npos;
+        for (std::size_t slot = 0; slot < m_occupied.size(); ++slot)
+        {
+            if (m_occupied[slot] && evictable(slot))
+            {
+                if (res == npos || m_count[slot] < m_count[res] ||
+                    (m_count[slot] == m_count[res] && m_last_access[slot] < m_last_access[res]))
+                {
+                    res = slot;
+                }
+            }
+        }
+        if (res != npos)
+        {
+            m_occupied[res] = 0;
+        }
+        return res;
+    }
+
+    /******************************
+     * xarc_policy implementation *
+     ******************************/
+
+    inline xarc_policy::xarc_policy(const xarc_policy& rhs)
+    {
+        *this = rhs;
+    }
+
+    inline xarc_policy& xarc_policy::operator=(const xarc_policy& rhs)
+    {
+        if (this != &rhs)
+        {
+            m_lists = rhs.m_lists;
+            m_keys = rhs.m_keys;
+            m_ghosts[b1] = rhs.m_ghosts[b1];
+            m_ghosts[b2] = rhs.m_ghosts[b2];
+            // the ghost map refers to the entries of the ghost lists
+            m_ghost_map.clear();
+            for (ghost_id id: {b1, b2})
+            {
+                for (auto it = m_ghosts[id].begin(); it != m_ghosts[id].end(); ++it)
+                {
+                    m_ghost_map.emplace(*it, ghost_entry(id, it));
+                }
+            }
+            m_capacity = rhs.m_capacity;
+            m_target = rhs.m_target;
+            m_ghost_key = rhs.m_ghost_key;
+            m_ghost_hit = rhs.m_ghost_hit;
+        }
+        return *this;
+    }
+
+    inline void xarc_policy::reset(std::size_t pool_size)
+    {
+        m_lists.reset(pool_size, 2);
+        m_keys.assign(pool_size, 0);
+        m_ghosts[b1].clear();
+        m_ghosts[b2].clear();
+        m_ghost_map.clear();
+        m_capacity = pool_size;
+        m_target = 0;
+        m_ghost_hit = false;
+    }
+
+    inline void xarc_policy::access(std::size_t slot)
+    {
+        // a chunk accessed more than once is frequent
+        m_lists.erase(slot);
+        m_lists.push_back(t2, slot);
+    }
+
+    inline void xarc_policy::insert(std::size_t slot, std::size_t key)
+    {
+        m_keys[slot] = key;
+        // a chunk found in the ghost lists is frequent, its ghost entry
+        // has already been consumed if a slot was unloaded for it
+        bool frequent = hit_ghost(key) != npos || (m_ghost_hit && m_ghost_key == key);
+        m_ghost_hit = false;
+        m_lists.push_back(frequent ? t2 : t1, slot);
+    }
+
+    template <class F>
+    inline std::size_t xarc_policy::victim(std::size_t key, F&& evictable)
+    {
+        // the target size of T1 is adapted before selecting the victim
+        std::size_t ghost = hit_ghost(key);
+        m_ghost_hit = ghost != npos;
+        m_ghost_key = key;
+        bool in_b2 = ghost == b2;
+        std::size_t size_t1 = m_lists.size(t1);
+        bool from_t1 = size_t1 != 0 && (size_t1 > m_target || (in_b2 && size_t1 == m_target));
+        list_id first = from_t1 ? t1 : t2;
+        list_id second = from_t1 ? t2 : t1;
+        std::size_t slot = m_lists.find_front(first, evictable);
+        if (slot == npos)
+        {
+            slot = m_lists.find_front(second, evictable);
+        }
+        if (slot != npos)
+        {
+            add_ghost(m_lists.list_of(slot) == t1 ? b1 : b2, m_keys[slot]);
+            m_lists.erase(slot);
+        }
+        return slot;
+    }
+
+    // On a ghost hit, adapts the target size of T1 and removes the ghost
+    // entry. Returns the ghost list of the entry, or npos.
+    inline std::size_t xarc_policy::hit_ghost(std::size_t key)
+    {
+        auto it = m_ghost_map.find(key);
+        if (it == m_ghost_map.end())
+        {
+            return npos;
+        }
+        ghost_id id = it->second.first;
+        std::size_t size_b1 = m_ghosts[b1].size();
+        std::size_t size_b2 = m_ghosts[b2].size();
+        if (id == b1)
+        {
+            std::size_t delta = std::max<std::size_t>(size_b2 / size_b1, 1);
+            m_target = std::min(m_capacity, m_target + delta);
+        }
+        else
+        {
+            std::size_t delta = std::max<std::size_t>(size_b1 / size_b2, 1);
+            m_target = m_target > delta ? m_target - delta : 0;
+        }
+        m_ghosts[id].erase(it->second.second);
+        m_ghost_map.erase(it);
+        return id;
+    }
+
+    inline void xarc_policy::add_ghost(ghost_id id, std::size_t key)
+    {
+        auto it = m_ghost_map.find(key);
+        if (it != m_ghost_map.end())
+        {
+            m_ghosts[it->second.first].erase(it->second.second);
+            m_ghost_map.erase(it);
+        }
+        m_ghosts[id].push_back(key);
+        m_ghost_map.emplace(key, ghost_entry(id, std::prev(m_ghosts[id].end())));
+        trim_ghosts();
+    }
+
+    inline void xarc_policy::trim_ghosts()
+    {
+        // keep at most as many ghost entries as there are slots in the pool
+        while (m_ghosts[b1].size() + m_ghosts[b2].size() > m_capacity)
+        {
+            ghost_id id = m_lists.size(t1) + m_ghosts[b1].size() > m_capacity || m_ghosts[b2].empty() ? b1 : b2;
+            m_ghost_map.erase(m_ghosts[id].front());
+            m_ghosts[id].pop_front();
+        }
+    }
+
+    /*********************************
+     * xpinned_policy implementation *
+     *********************************/
+
+    template <class P>
+    template <class S>
+    inline void xpinned_policy<P>::pin(const S& index)
+    {
+        m_pinned_indexes.emplace(index.cbegin(), index.cend());
+        update_slots();
+    }
+
+    template <class P>
+    template <class S>
+    inline void xpinned_policy<P>::unpin(const S& index)
+    {
+        m_pinned_indexes.erase(index_type(index.cbegin(), index.cend()));
+        update_slots();
+    }
+
+    template <class P>
+    inline void xpinned_policy<P>::unpin_all()
+    {
+        m_pinned_indexes.clear();
+        update_slots();
+    }
+
+    template <class P>
+    inline void xpinned_policy<P>::reset(std::size_t pool_size)
+    {
+        m_policy.reset(pool_size);
+        m_indexes.assign(pool_size, index_type());
+        m_occupied.assign(pool_size, 0);
+        m_pinned.assign(pool_size, 0);
+    }
+
+    template <class P>
+    inline void xpinned_policy<P>::access(std::size_t slot)
+    {
+        m_policy.access(slot);
+    }
+
+    template <class P>
+    template <class S>
+    inline void xpinned_policy<P>::insert(std::size_t slot, std::size_t key, const S& index)
+    {
+        m_indexes[slot].assign(index.cbegin(), index.cend());
+        m_occupied[slot] = 1;
+        m_pinned[slot] = m_pinned_indexes.count(m_indexes[slot]) != 0;
+        detail::policy_helper<P, S>::insert(m_policy, slot, key, index);
+    }
+
+    template <class P>
+    template <class F>
+    inline std::size_t xpinned_policy<P>::victim(std::size_t key, F&& evictable)
+    {
+        std::size_t slot = m_policy.victim(key, [this, &evictable](std::size_t s)
+            { return !m_pinned[s] && evictable(s); });
+        if (slot != npos)
+        {
+            m_occupied[slot] = 0;
+            m_pinned[slot] = 0;
+        }
+        return slot;
+    }
+
+    template <class P>
+    inline P& xpinned_policy<P>::underlying() noexcept
+    {
+        return m_policy;
+    }
+
+    template <class P>
+    inline void xpinned_policy<P>::update_slots()
+    {
+        for (std::size_t slot = 0; slot < m_pinned.size(); ++slot)
+        {
+            m_pinned[slot] = m_occupied[slot] && m_pinned_indexes.count(m_indexes[slot]) != 0;
+        }
+    }
+}
+
+#endif
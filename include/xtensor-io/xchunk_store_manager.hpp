@@ -2,19 +2,38 @@
 #define XTENSOR_CHUNK_STORE_MANAGER_HPP
 
 #include <vector>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <filesystem>
 
+#include <xtl/xcomplex.hpp>
 #include <xtl/xsequence.hpp>
 
 #include "xtensor/containers/xarray.hpp"
 #include "xtensor/chunk/xchunked_array.hpp"
+#include "xtensor-io.hpp"
 #include "xfile_array.hpp"
+#include "xchunk_handle.hpp"
+#include "xchunk_pool_policy.hpp"
+#include "xstore_manifest.hpp"
+#include "xthread_pool.hpp"
 
 namespace xt
 {
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     class xchunk_store_manager;
 
     /***************************
@@ -36,12 +55,269 @@ namespace xt
         std::string m_directory;
     };
 
+    namespace detail
+    {
+        // Queue of pending chunk writes, run by a pool of worker threads.
+        // Writes are tracked by path, so that a chunk is not read back
+        // before it has been written. Each pending write owns a copy of
+        // the chunk data, hence their number is capped to twice the
+        // number of workers: push blocks until a write completes.
+        class xwrite_back_queue
+        {
+        public:
+
+            explicit xwrite_back_queue(std::size_t nthreads);
+
+            std::size_t size() const noexcept;
+
+            template <class F>
+            void push(const std::string& path, F&& task);
+
+            void wait(const std::string& path);
+            void wait_all();
+
+        private:
+
+            void done(const std::string& path);
+
+            std::unordered_map<std::string, std::size_t> m_pending;
+            std::size_t m_nb_pending;
+            std::size_t m_max_pending;
+            std::mutex m_mutex;
+            std::condition_variable m_cond;
+            // declared last so that workers are joined first
+            xthread_pool m_pool;
+        };
+
+        // Formats sharing data between the chunks of a store (e.g. a
+        // compression dictionary) keep it at the root of the store.
+        template <class FC>
+        using try_configure_store = decltype(std::declval<FC&>().configure_store(std::declval<const std::string&>()));
+
+        template <class FC, class = void>
+        struct store_config_helper
+        {
+            static void configure_store(FC&, const std::string&)
+            {
+            }
+        };
+
+        template <class FC>
+        struct store_config_helper<FC, void_t<try_configure_store<FC>>>
+        {
+            static void configure_store(FC& format_config, const std::string& directory)
+            {
+                format_config.configure_store(directory);
+            }
+        };
+
+        // The formats providing write_to and read_from record their
+        // configuration in the manifest of the store.
+        template <class FC>
+        using try_write_to = decltype(std::declval<const FC&>().write_to(std::declval<xmanifest_group&>()));
+
+        template <class FC, class = void>
+        struct manifest_config_helper
+        {
+            static void write(const FC&, xstore_manifest&)
+            {
+            }
+
+            static void read(FC&, xstore_manifest&)
+            {
+            }
+        };
+
+        template <class FC>
+        struct manifest_config_helper<FC, void_t<try_write_to<FC>>>
+        {
+            static void write(const FC& format_config, xstore_manifest& manifest)
+            {
+                manifest["codec"] = format_config.name;
+                manifest["codec.version"] = format_config.version;
+                manifest["codec.big_endian"] = format_config.big_endian;
+                xmanifest_group codec = manifest.group("codec");
+                format_config.write_to(codec);
+            }
+
+            static void read(FC& format_config, xstore_manifest& manifest)
+            {
+                if (!manifest.contains("codec"))
+                {
+                    return;
+                }
+                if (manifest["codec"].str() != format_config.name)
+                {
+                    XTENSOR_THROW(std::runtime_error, "chunk store: stored with codec " + manifest["codec"].str() +
+                                                      ", not " + format_config.name);
+                }
+                format_config.big_endian = manifest["codec.big_endian"];
+                xmanifest_group codec = manifest.group("codec");
+                format_config.read_from(codec);
+            }
+        };
+
+        template <class T>
+        inline std::string dtype_name()
+        {
+            std::string bits = std::to_string(8 * sizeof(T));
+            if constexpr (std::is_same<T, bool>::value)
+            {
+                return "bool";
+            }
+            else if constexpr (std::is_integral<T>::value)
+            {
+                return (std::is_signed<T>::value ? "int" : "uint") + bits;
+            }
+            else if constexpr (std::is_floating_point<T>::value)
+            {
+                return "float" + bits;
+            }
+            else if constexpr (xtl::is_complex<T>::value)
+            {
+                return "complex" + bits;
+            }
+            else
+            {
+                return "void" + bits;
+            }
+        }
+
+        inline std::string manifest_path(const std::string& directory)
+        {
+            return (std::filesystem::path(directory) / "xstore.manifest").string();
+        }
+
+        // Chunks of the grid which may exist in the store. A chunk which
+        // is outside of the grid does not exist.
+        struct xchunk_index
+        {
+            std::vector<std::size_t> grid_shape;
+            std::vector<bool> exists;
+            bool modified = false;
+        };
+
+        // Position of a chunk in the row-major order of the grid,
+        // or the size of the grid if the chunk is outside of it.
+        template <class I>
+        inline std::size_t grid_position(const std::vector<std::size_t>& grid_shape, I first, I last)
+        {
+            std::size_t size = compute_size(grid_shape);
+            if (static_cast<std::size_t>(std::distance(first, last)) != grid_shape.size())
+            {
+                return size;
+            }
+            std::size_t position = 0;
+            auto s = grid_shape.cbegin();
+            for (auto it = first; it != last; ++it, ++s)
+            {
+                if (static_cast<std::size_t>(*it) >= *s)
+                {
+                    return size;
+                }
+                position = position * *s + static_cast<std::size_t>(*it);
+            }
+            return position;
+        }
+
+        inline void grid_index(const std::vector<std::size_t>& grid_shape, std::size_t position, std::vector<std::size_t>& index)
+        {
+            index.resize(grid_shape.size());
+            for (std::size_t d = grid_shape.size(); d != 0; --d)
+            {
+                index[d - 1] = position % grid_shape[d - 1];
+                position /= grid_shape[d - 1];
+            }
+        }
+
+        // The bitmap is saved in hexadecimal, four chunks per digit.
+        inline std::string encode_bitmap(const std::vector<bool>& bits)
+        {
+            static const char digits[] = "0123456789abcdef";
+            std::string text((bits.size() + 3) / 4, '0');
+            for (std::size_t i = 0; i < text.size(); ++i)
+            {
+                unsigned int v = 0;
+                for (std::size_t b = 0; b < 4 && 4 * i + b < bits.size(); ++b)
+                {
+                    v |= static_cast<unsigned int>(bits[4 * i + b]) << b;
+                }
+                text[i] = digits[v];
+            }
+            return text;
+        }
+
+        inline std::vector<bool> decode_bitmap(const std::string& text, std::size_t size)
+        {
+            if (text.size() != (size + 3) / 4)
+            {
+                XTENSOR_THROW(std::runtime_error, "chunk store: invalid chunk index in manifest");
+            }
+            std::vector<bool> bits(size);
+            for (std::size_t i = 0; i < text.size(); ++i)
+            {
+                char c = text[i];
+                unsigned int v;
+                if (c >= '0' && c <= '9')
+                {
+                    v = static_cast<unsigned int>(c - '0');
+                }
+                else if (c >= 'a' && c <= 'f')
+                {
+                    v = static_cast<unsigned int>(c - 'a' + 10);
+                }
+                else
+                {
+                    XTENSOR_THROW(std::runtime_error, "chunk store: invalid chunk index in manifest");
+                }
+                for (std::size_t b = 0; b < 4 && 4 * i + b < size; ++b)
+                {
+                    bits[4 * i + b] = ((v >> b) & 1u) != 0;
+                }
+            }
+            return bits;
+        }
+
+        // Asynchronous loading of chunks into slots of the pool.
+        // The pending flags are only accessed by the thread owning
+        // the pool, the completion flags are shared with the workers.
+        class xprefetcher
+        {
+        public:
+
+            xprefetcher(std::size_t depth, std::size_t nthreads, std::size_t pool_size);
+
+            std::size_t depth() const noexcept;
+            std::size_t size() const noexcept;
+            bool is_pending(std::size_t slot) const noexcept;
+            bool is_evictable(std::size_t slot);
+            bool has_failed(std::size_t slot);
+
+            template <class F>
+            void load(std::size_t slot, F&& task);
+
+            std::exception_ptr wait(std::size_t slot);
+            void wait_all();
+
+        private:
+
+            std::size_t m_depth;
+            std::vector<char> m_pending;
+            std::vector<char> m_finished;
+            std::vector<std::exception_ptr> m_errors;
+            std::mutex m_mutex;
+            std::condition_variable m_cond;
+            // declared last so that workers are joined first
+            xthread_pool m_pool;
+        };
+    }
+
     /*********************************
      * xchunked_assigner declaration *
      *********************************/
 
-    template <class T, class EC, class IP>
-    class xchunked_assigner<T, xchunk_store_manager<EC, IP>>
+    template <class T, class EC, class IP, class EP>
+    class xchunked_assigner<T, xchunk_store_manager<EC, IP, EP>>
     {
     public:
 
@@ -55,22 +331,22 @@ namespace xt
      * xchunk_store_manager declaration *
      ************************************/
 
-    template <class EC, class IP>
-    struct xcontainer_inner_types<xchunk_store_manager<EC, IP>>
+    template <class EC, class IP, class EP>
+    struct xcontainer_inner_types<xchunk_store_manager<EC, IP, EP>>
     {
         using storage_type = EC;
         using reference = EC&;
         using const_reference = const EC&;
         using size_type = std::size_t;
-        using temporary_type = xchunk_store_manager<EC, IP>;
+        using temporary_type = xchunk_store_manager<EC, IP, EP>;
     };
 
-    template <class EC, class IP>
-    struct xiterable_inner_types<xchunk_store_manager<EC, IP>>
+    template <class EC, class IP, class EP>
+    struct xiterable_inner_types<xchunk_store_manager<EC, IP, EP>>
     {
         using inner_shape_type = std::vector<std::size_t>;
-        using stepper = xindexed_stepper<xchunk_store_manager<EC, IP>, false>;
-        using const_stepper = xindexed_stepper<xchunk_store_manager<EC, IP>, true>;
+        using stepper = xindexed_stepper<xchunk_store_manager<EC, IP, EP>, false>;
+        using const_stepper = xindexed_stepper<xchunk_store_manager<EC, IP, EP>, true>;
     };
 
     /**
@@ -85,14 +361,15 @@ namespace xt
      *
      * @tparam EC The type of a chunk (e.g. xfile_array)
      * @tparam IP The type of the index-to-path transformer (default: xindex_path)
+     * @tparam EP The replacement policy of the chunk pool (default: xlru_policy)
      */
-    template <class EC, class IP = xindex_path>
-    class xchunk_store_manager: public xaccessible<xchunk_store_manager<EC, IP>>,
-                                public xiterable<xchunk_store_manager<EC, IP>>
+    template <class EC, class IP = xindex_path, class EP = xlru_policy>
+    class xchunk_store_manager: public xaccessible<xchunk_store_manager<EC, IP, EP>>,
+                                public xiterable<xchunk_store_manager<EC, IP, EP>>
     {
     public:
 
-        using self_type = xchunk_store_manager<EC, IP>;
+        using self_type = xchunk_store_manager<EC, IP, EP>;
         using inner_types = xcontainer_inner_types<self_type>;
         using storage_type = typename inner_types::storage_type;
         using value_type = storage_type;
@@ -106,6 +383,7 @@ namespace xt
         using stepper = typename iterable_base::stepper;
         using const_stepper = typename iterable_base::const_stepper;
         using shape_type = typename iterable_base::inner_shape_type;
+        using handle_type = xchunk_handle<EC, self_type>;
 
         template <class S>
         xchunk_store_manager(S&& shape,
@@ -122,10 +400,10 @@ namespace xt
                              const T& init_value,
                              layout_type chunk_memory_layout = XTENSOR_DEFAULT_LAYOUT);
 
-        ~xchunk_store_manager() = default;
+        ~xchunk_store_manager();
 
-        xchunk_store_manager(const xchunk_store_manager&) = default;
-        xchunk_store_manager& operator=(const xchunk_store_manager&) = default;
+        xchunk_store_manager(const xchunk_store_manager& rhs);
+        xchunk_store_manager& operator=(const xchunk_store_manager& rhs);
 
         xchunk_store_manager(xchunk_store_manager&&) = default;
         xchunk_store_manager& operator=(xchunk_store_manager&&) = default;
@@ -145,6 +423,12 @@ namespace xt
         template <class It>
         const_reference element(It first, It last) const;
 
+        template <class... Idxs>
+        handle_type chunk(Idxs... idxs);
+
+        template <class It>
+        handle_type get_chunk(It first, It last);
+
         template <class O>
         stepper stepper_begin(const O& shape) noexcept;
         template <class O>
@@ -160,13 +444,32 @@ namespace xt
 
         size_type size() const;
         const std::string& get_directory() const;
-        bool get_pool_size() const;
+        std::size_t get_pool_size() const;
 
         IP& get_index_path();
+        EP& get_policy();
         void flush();
 
+        void set_write_back(std::size_t nthreads);
+        void set_prefetch(std::size_t depth, std::size_t nthreads = 1);
+
+        void set_assign_threads(std::size_t nthreads);
+        std::size_t get_assign_threads() const noexcept;
+
+        const xchunk_pool_stats& pool_stats() const noexcept;
+        void reset_pool_stats();
+
+        void set_manifest(bool enabled);
+        void set_manifest(xstore_manifest manifest);
+        bool has_manifest() const noexcept;
+        const xstore_manifest& manifest() const noexcept;
+
         template <class FC, class IOC>
         void configure(FC& format_config, IOC& io_config);
+        void configure_like(const xchunk_store_manager& other);
+
+        template <class FC, class IOC>
+        void train_dictionary(FC& format_config, IOC& io_config);
 
         template <class I>
         reference map_file_array(I first, I last);
@@ -179,9 +482,14 @@ namespace xt
 
     private:
 
+        friend handle_type;
+
         template <class... Idxs>
         std::array<std::size_t, sizeof...(Idxs)> get_indexes(Idxs... idxs) const;
 
+        void release_pin(std::size_t i);
+        void wait_workers() const;
+
         template <class S, class T>
         void initialize(S&& shape,
                         S&& chunk_shape,
@@ -191,15 +499,47 @@ namespace xt
                         std::size_t pool_size,
                         layout_type chunk_memory_layout);
 
+        template <class I>
+        std::size_t find_slot(std::size_t key, I first, I last) const;
+        std::size_t acquire_slot(std::size_t key, std::size_t excluded = npos);
+        void unmap_slot(std::size_t i);
+        void collect_slot(std::size_t i);
+
+        template <class I>
+        void prefetch(I first, I last, std::size_t current);
+
+        template <class I>
+        bool chunk_may_exist(I first, I last) const;
+        template <class I>
+        void update_chunk_index(I first, I last, bool exists);
+        void build_chunk_index();
+        void save_manifest();
+
         using chunk_pool_type = std::vector<EC>;
         using index_pool_type = std::vector<shape_type>;
+        using index_map_type = std::unordered_multimap<std::size_t, std::size_t>;
+
+        static constexpr std::size_t npos = std::size_t(-1);
 
         shape_type m_shape;
         shape_type m_chunk_shape;
         chunk_pool_type m_chunk_pool;
         index_pool_type m_index_pool;
-        std::size_t m_unload_index;
+        index_map_type m_index_map;
+        std::vector<std::size_t> m_free_slots;
+        std::vector<std::size_t> m_pin_count;
+        EP m_policy;
+        // slot of the last accessed chunk
+        std::size_t m_last_slot = npos;
+        xchunk_pool_stats m_stats;
         IP m_index_path;
+        std::shared_ptr<detail::xwrite_back_queue> m_write_back;
+        std::shared_ptr<detail::xprefetcher> m_prefetcher;
+        std::size_t m_assign_threads = 1;
+        std::function<void(const std::string&)> m_configure_store;
+        std::function<void(EC&)> m_configure_chunk;
+        xstore_manifest m_manifest;
+        std::shared_ptr<detail::xchunk_index> m_chunk_index;
     };
 
     /**
@@ -210,6 +550,7 @@ namespace xt
      * @tparam IOH The type of the IO handler (e.g. xio_disk_handler)
      * @tparam L The layout_type of the array
      * @tparam IP The type of the index-to-path transformer (default: xindex_path)
+     * @tparam EP The replacement policy of the chunk pool (default: xlru_policy)
      *
      * @param shape The shape of the array
      * @param chunk_shape The shape of a chunk
@@ -219,16 +560,16 @@ namespace xt
      *
      * @return returns a ``xchunked_array<xchunk_store_manager<xfile_array<T, IOH>>>`` with the given shape, chunk shape and memory layout.
      */
-    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class S>
-    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP>>
+    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class EP = xlru_policy, class S>
+    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
     chunked_file_array(S&& shape,
                        S&& chunk_shape,
                        const std::string& path,
                        std::size_t pool_size = 1,
                        layout_type chunk_memory_layout = XTENSOR_DEFAULT_LAYOUT);
 
-    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class S>
-    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP>>
+    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class EP = xlru_policy, class S>
+    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
     chunked_file_array(std::initializer_list<S> shape,
                        std::initializer_list<S> chunk_shape,
                        const std::string& path,
@@ -243,6 +584,7 @@ namespace xt
      * @tparam IOH The type of the IO handler (e.g. xio_disk_handler)
      * @tparam L The layout_type of the array
      * @tparam IP The type of the index-to-path transformer (default: xindex_path)
+     * @tparam EP The replacement policy of the chunk pool (default: xlru_policy)
      *
      * @param shape The shape of the array
      * @param chunk_shape The shape of a chunk
@@ -253,8 +595,8 @@ namespace xt
      *
      * @return returns a ``xchunked_array<xchunk_store_manager<xfile_array<T, IOH>>>`` with the given shape, chunk shape and memory layout.
      */
-    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class S>
-    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP>>
+    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class EP = xlru_policy, class S>
+    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
     chunked_file_array(S&& shape,
                        S&& chunk_shape,
                        const std::string& path,
@@ -262,8 +604,8 @@ namespace xt
                        std::size_t pool_size = 1,
                        layout_type chunk_memory_layout = XTENSOR_DEFAULT_LAYOUT);
 
-    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class S>
-    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP>>
+    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class EP = xlru_policy, class S>
+    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
     chunked_file_array(std::initializer_list<S> shape,
                        std::initializer_list<S> chunk_shape,
                        const std::string& path,
@@ -279,6 +621,7 @@ namespace xt
      * @tparam IOH The type of the IO handler (e.g. xio_disk_handler)
      * @tparam L The layout_type of the array
      * @tparam IP The type of the index-to-path transformer (default: xindex_path)
+     * @tparam EP The replacement policy of the chunk pool (default: xlru_policy)
      *
      * @param e The expression to initialize the chunked array from
      * @param chunk_shape The shape of a chunk
@@ -288,8 +631,8 @@ namespace xt
      *
      * @return returns a ``xchunked_array<xchunk_store_manager<xfile_array<T, IOH>>>`` from the given expression, with the given chunk shape and memory layout.
      */
-    template <class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class E, class S>
-    xchunked_array<xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP>>
+    template <class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class EP = xlru_policy, class E, class S>
+    xchunked_array<xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP, EP>>
     chunked_file_array(const xexpression<E>& e,
                        S&& chunk_shape,
                        const std::string& path,
@@ -303,6 +646,7 @@ namespace xt
      * @tparam IOH The type of the IO handler (e.g. xio_disk_handler)
      * @tparam L The layout_type of the array
      * @tparam IP The type of the index-to-path transformer (default: xindex_path)
+     * @tparam EP The replacement policy of the chunk pool (default: xlru_policy)
      *
      * @param e The expression to initialize the chunked array from
      * @param path The path to the chunk store
@@ -311,13 +655,45 @@ namespace xt
      *
      * @return returns a ``xchunked_array<xchunk_store_manager<xfile_array<T, IOH>>>`` from the given expression, with the expression's chunk shape and the given memory layout.
      */
-    template <class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class E>
-    xchunked_array<xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP>>
+    template <class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class EP = xlru_policy, class E>
+    xchunked_array<xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP, EP>>
     chunked_file_array(const xexpression<E>& e,
                        const std::string& path,
                        std::size_t pool_size = 1,
                        layout_type chunk_memory_layout = XTENSOR_DEFAULT_LAYOUT);
 
+    /**
+     * Opens a chunked file array from the manifest saved at the root of its
+     * store. The shape, the chunk shape, the init value and the configuration
+     * of the format are read from the manifest, and the chunk index of the
+     * manifest is used to avoid accessing the missing chunks.
+     *
+     * @tparam T The type of the elements (e.g. double)
+     * @tparam IOH The type of the IO handler (e.g. xio_disk_handler)
+     * @tparam L The layout_type of the array
+     * @tparam IP The type of the index-to-path transformer (default: xindex_path)
+     * @tparam EP The replacement policy of the chunk pool (default: xlru_policy)
+     *
+     * @param path The path to the chunk store
+     * @param io_config The configuration of the IO handler
+     * @param pool_size The size of the chunk pool (default: 1)
+     * @param chunk_memory_layout The layout of each chunk (default: XTENSOR_DEFAULT_LAYOUT)
+     *
+     * @return returns a ``xchunked_array<xchunk_store_manager<xfile_array<T, IOH>>>`` with the shape and chunk shape of the store.
+     */
+    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class EP = xlru_policy>
+    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
+    open_chunked_file_array(const std::string& path,
+                            const typename IOH::io_config& io_config,
+                            std::size_t pool_size = 1,
+                            layout_type chunk_memory_layout = XTENSOR_DEFAULT_LAYOUT);
+
+    template <class T, class IOH, layout_type L = XTENSOR_DEFAULT_LAYOUT, class IP = xindex_path, class EP = xlru_policy>
+    xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
+    open_chunked_file_array(const std::string& path,
+                            std::size_t pool_size = 1,
+                            layout_type chunk_memory_layout = XTENSOR_DEFAULT_LAYOUT);
+
     /******************************
      * xindex_path implementation *
      ******************************/
@@ -351,103 +727,392 @@ namespace xt
         path = m_directory + fname;
     }
 
+    /************************************
+     * xwrite_back_queue implementation *
+     ************************************/
+
+    namespace detail
+    {
+        inline xwrite_back_queue::xwrite_back_queue(std::size_t nthreads)
+            : m_nb_pending(0)
+            , m_max_pending(2 * std::max<std::size_t>(nthreads, 1))
+            , m_pool(nthreads)
+        {
+        }
+
+        inline std::size_t xwrite_back_queue::size() const noexcept
+        {
+            return m_pool.size();
+        }
+
+        template <class F>
+        inline void xwrite_back_queue::push(const std::string& path, F&& task)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this]() { return m_nb_pending < m_max_pending; });
+                ++m_nb_pending;
+                ++m_pending[path];
+            }
+            m_pool.submit([this, path, task = std::forward<F>(task)]() mutable
+            {
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    done(path);
+                    throw;
+                }
+                done(path);
+            });
+        }
+
+        inline void xwrite_back_queue::wait(const std::string& path)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this, &path]() { return m_pending.find(path) == m_pending.end(); });
+        }
+
+        inline void xwrite_back_queue::wait_all()
+        {
+            m_pool.wait();
+        }
+
+        inline void xwrite_back_queue::done(const std::string& path)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                --m_nb_pending;
+                auto it = m_pending.find(path);
+                if (--(it->second) == 0)
+                {
+                    m_pending.erase(it);
+                }
+            }
+            m_cond.notify_all();
+        }
+    }
+
+    /******************************
+     * xprefetcher implementation *
+     ******************************/
+
+    namespace detail
+    {
+        inline xprefetcher::xprefetcher(std::size_t depth, std::size_t nthreads, std::size_t pool_size)
+            : m_depth(depth)
+            , m_pending(pool_size, 0)
+            , m_finished(pool_size, 0)
+            , m_errors(pool_size)
+            , m_pool(nthreads)
+        {
+        }
+
+        inline std::size_t xprefetcher::depth() const noexcept
+        {
+            return m_depth;
+        }
+
+        inline std::size_t xprefetcher::size() const noexcept
+        {
+            return m_pool.size();
+        }
+
+        inline bool xprefetcher::is_pending(std::size_t slot) const noexcept
+        {
+            return m_pending[slot];
+        }
+
+        inline bool xprefetcher::is_evictable(std::size_t slot)
+        {
+            if (!m_pending[slot])
+            {
+                return true;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_finished[slot];
+        }
+
+        // Whether the loading of the chunk has failed, once it is finished.
+        inline bool xprefetcher::has_failed(std::size_t slot)
+        {
+            if (!m_pending[slot])
+            {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_errors[slot] != nullptr;
+        }
+
+        template <class F>
+        inline void xprefetcher::load(std::size_t slot, F&& task)
+        {
+            m_pending[slot] = 1;
+            m_pool.submit([this, slot, task = std::forward<F>(task)]() mutable
+            {
+                std::exception_ptr error;
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_finished[slot] = 1;
+                    m_errors[slot] = error;
+                }
+                m_cond.notify_all();
+            });
+        }
+
+        inline std::exception_ptr xprefetcher::wait(std::size_t slot)
+        {
+            std::exception_ptr error;
+            if (m_pending[slot])
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this, slot]() { return m_finished[slot] != 0; });
+                error = m_errors[slot];
+                m_errors[slot] = nullptr;
+                m_finished[slot] = 0;
+                m_pending[slot] = 0;
+            }
+            return error;
+        }
+
+        inline void xprefetcher::wait_all()
+        {
+            m_pool.wait();
+        }
+    }
+
     /************************************
      * xchunked_assigner implementation *
      ************************************/
 
-    template <class T, class EC, class IP>
+    template <class T, class EC, class IP, class EP>
     template <class E, class DST>
-    inline void xchunked_assigner<T, xchunk_store_manager<EC, IP>>::build_and_assign_temporary(const xexpression<E>& e,
+    inline void xchunked_assigner<T, xchunk_store_manager<EC, IP, EP>>::build_and_assign_temporary(const xexpression<E>& e,
                                                                                                DST& dst)
     {
-        using store_type = xchunk_store_manager<EC, IP>;
-        store_type store(e.derived_cast().shape(), dst.chunk_shape(), dst.chunks().get_temporary_directory(), dst.chunks().get_pool_size());
-        temporary_type tmp(e, std::move(store), dst.chunk_shape());
-        tmp.chunks().flush();
-        dst.chunks().reset_to_directory(tmp.chunks().get_directory());
+        using store_type = xchunk_store_manager<EC, IP, EP>;
+        std::size_t nthreads = dst.chunks().get_assign_threads();
+        if (nthreads < 2)
+        {
+            store_type store(e.derived_cast().shape(), dst.chunk_shape(), dst.chunks().get_temporary_directory(), dst.chunks().get_pool_size());
+            // the chunks are written as dst reads them
+            store.configure_like(dst.chunks());
+            temporary_type tmp(e, std::move(store), dst.chunk_shape());
+            tmp.chunks().flush();
+            dst.chunks().reset_to_directory(tmp.chunks().get_directory());
+            return;
+        }
+
+        namespace fs = std::filesystem;
+        using shape_type = typename store_type::shape_type;
+        const E& ex = e.derived_cast();
+        shape_type shape(ex.shape().cbegin(), ex.shape().cend());
+        shape_type chunk_shape(dst.chunk_shape().cbegin(), dst.chunk_shape().cend());
+        shape_type grid_shape(shape.size());
+        for (std::size_t d = 0; d < shape.size(); ++d)
+        {
+            grid_shape[d] = (shape[d] + chunk_shape[d] - 1) / chunk_shape[d];
+        }
+        std::size_t nb_chunks = compute_size(grid_shape);
+        std::string directory = dst.chunks().get_temporary_directory();
+        fs::create_directories(directory);
+
+        std::atomic<std::size_t> next_chunk(0);
+        std::mutex expression_mutex;
+        xthread_pool pool(std::min(nthreads, nb_chunks));
+        for (std::size_t w = 0; w < pool.size(); ++w)
+        {
+            pool.submit([&]()
+            {
+                // each worker owns its chunk buffer and writes distinct files
+                store_type store(shape, chunk_shape, directory, 1);
+                store.configure_like(dst.chunks());
+                store.resize(grid_shape);
+                shape_type index(grid_shape.size());
+                xstrided_slice_vector slices(shape.size());
+                xstrided_slice_vector chunk_slices(shape.size());
+                for (std::size_t k = next_chunk++; k < nb_chunks; k = next_chunk++)
+                {
+                    bool full_chunk = true;
+                    std::size_t rem = k;
+                    for (std::size_t d = grid_shape.size(); d != 0; --d)
+                    {
+                        index[d - 1] = rem % grid_shape[d - 1];
+                        rem /= grid_shape[d - 1];
+                        std::size_t range_start = index[d - 1] * chunk_shape[d - 1];
+                        std::size_t range_end = std::min(range_start + chunk_shape[d - 1], shape[d - 1]);
+                        slices[d - 1] = range(range_start, range_end);
+                        chunk_slices[d - 1] = range(std::size_t(0), range_end - range_start);
+                        full_chunk = full_chunk && (range_end - range_start == chunk_shape[d - 1]);
+                    }
+                    auto& chunk = store.element(index.cbegin(), index.cend());
+                    {
+                        // the expression may refer to stored arrays, which
+                        // cannot be accessed concurrently
+                        std::lock_guard<std::mutex> lock(expression_mutex);
+                        auto rhs = strided_view(ex, slices);
+                        if (full_chunk)
+                        {
+                            noalias(chunk) = rhs;
+                        }
+                        else
+                        {
+                            noalias(strided_view(chunk, chunk_slices)) = rhs;
+                        }
+                    }
+                    chunk.flush();
+                }
+            });
+        }
+        try
+        {
+            pool.wait();
+        }
+        catch (...)
+        {
+            fs::remove_all(directory);
+            throw;
+        }
+        dst.chunks().reset_to_directory(directory);
     }
 
     /******************************************
      * xchunk_store_manager factory functions *
      ******************************************/
 
-    template <class T, class IOH, layout_type L, class IP, class S>
-    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP>>
+    template <class T, class IOH, layout_type L, class IP, class EP, class S>
+    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
     chunked_file_array(S&& shape, S&& chunk_shape, const std::string& path, std::size_t pool_size, layout_type chunk_memory_layout)
     {
-        using chunk_storage = xchunk_store_manager<xfile_array<T, IOH, L>, IP>;
+        using chunk_storage = xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>;
         chunk_storage chunks(shape, chunk_shape, path, pool_size, chunk_memory_layout);
         return xchunked_array<chunk_storage>(std::move(chunks), std::forward<S>(shape), std::forward<S>(chunk_shape));
     }
 
-    template <class T, class IOH, layout_type L, class IP, class S>
-    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP>>
+    template <class T, class IOH, layout_type L, class IP, class EP, class S>
+    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
     chunked_file_array(std::initializer_list<S> shape, std::initializer_list<S> chunk_shape, const std::string& path, std::size_t pool_size, layout_type chunk_memory_layout)
     {
         using sh_type = std::vector<std::size_t>;
         auto sh = xtl::forward_sequence<sh_type, std::initializer_list<S>>(shape);
         auto ch_sh = xtl::forward_sequence<sh_type, std::initializer_list<S>>(chunk_shape);
-        return chunked_file_array<T, IOH, L, IP, sh_type>(std::move(sh), std::move(ch_sh), path, pool_size, chunk_memory_layout);
+        return chunked_file_array<T, IOH, L, IP, EP, sh_type>(std::move(sh), std::move(ch_sh), path, pool_size, chunk_memory_layout);
     }
 
-    template <class T, class IOH, layout_type L, class IP, class S>
-    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP>>
+    template <class T, class IOH, layout_type L, class IP, class EP, class S>
+    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
     chunked_file_array(S&& shape, S&& chunk_shape, const std::string& path, const T& init_value, std::size_t pool_size, layout_type chunk_memory_layout)
     {
-        using chunk_storage = xchunk_store_manager<xfile_array<T, IOH, L>, IP>;
+        using chunk_storage = xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>;
         chunk_storage chunks(shape, chunk_shape, path, pool_size, init_value, chunk_memory_layout);
         return xchunked_array<chunk_storage>(std::move(chunks), std::forward<S>(shape), std::forward<S>(chunk_shape));
     }
 
-    template <class T, class IOH, layout_type L, class IP, class S>
-    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP>>
+    template <class T, class IOH, layout_type L, class IP, class EP, class S>
+    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
     chunked_file_array(std::initializer_list<S> shape, std::initializer_list<S> chunk_shape, const std::string& path, const T& init_value, std::size_t pool_size, layout_type chunk_memory_layout)
     {
         using sh_type = std::vector<std::size_t>;
         auto sh = xtl::forward_sequence<sh_type, std::initializer_list<S>>(shape);
         auto ch_sh = xtl::forward_sequence<sh_type, std::initializer_list<S>>(chunk_shape);
-        return chunked_file_array<T, IOH, L, IP, sh_type>(std::move(sh), std::move(ch_sh), path, init_value, pool_size, chunk_memory_layout);
+        return chunked_file_array<T, IOH, L, IP, EP, sh_type>(std::move(sh), std::move(ch_sh), path, init_value, pool_size, chunk_memory_layout);
     }
 
-    template <class IOH, layout_type L, class IP, class E, class S>
-    inline xchunked_array<xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP>>
+    template <class IOH, layout_type L, class IP, class EP, class E, class S>
+    inline xchunked_array<xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP, EP>>
     chunked_file_array(const xexpression<E>& e, S&& chunk_shape, const std::string& path, std::size_t pool_size, layout_type chunk_memory_layout)
     {
-        using chunk_storage = xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP>;
+        using chunk_storage = xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP, EP>;
         chunk_storage chunks(e.derived_cast().shape(), chunk_shape, path, pool_size, chunk_memory_layout);
         return xchunked_array<chunk_storage>(e, chunk_storage(), std::forward<S>(chunk_shape));
     }
 
-    template <class IOH, layout_type L, class IP, class E>
-    inline xchunked_array<xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP>>
+    template <class IOH, layout_type L, class IP, class EP, class E>
+    inline xchunked_array<xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP, EP>>
     chunked_file_array(const xexpression<E>& e, const std::string& path, std::size_t pool_size, layout_type chunk_memory_layout)
     {
-        using chunk_storage = xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP>;
+        using chunk_storage = xchunk_store_manager<xfile_array<typename E::value_type, IOH, L>, IP, EP>;
         chunk_storage chunks(e.derived_cast().shape(), detail::chunk_helper<E>::chunk_shape(e), path, pool_size, chunk_memory_layout);
         return xchunked_array<chunk_storage>(e, chunk_storage());
     }
 
+    template <class T, class IOH, layout_type L, class IP, class EP>
+    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
+    open_chunked_file_array(const std::string& path, const typename IOH::io_config& io_config, std::size_t pool_size, layout_type chunk_memory_layout)
+    {
+        using chunk_storage = xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>;
+        using result_type = xchunked_array<chunk_storage>;
+        using sh_type = std::vector<std::size_t>;
+        xstore_manifest manifest;
+        if (!manifest.load(detail::manifest_path(path)))
+        {
+            XTENSOR_THROW(std::runtime_error, "open_chunked_file_array: no manifest in " + path);
+        }
+        if (manifest["dtype"].str() != detail::dtype_name<T>())
+        {
+            XTENSOR_THROW(std::runtime_error, "open_chunked_file_array: the store holds " + manifest["dtype"].str() +
+                                              " values, not " + detail::dtype_name<T>());
+        }
+        sh_type shape = manifest["shape"].as<sh_type>();
+        sh_type chunk_shape = manifest["chunk_shape"].as<sh_type>();
+        auto make_array = [&]() -> result_type
+        {
+            if constexpr (std::is_arithmetic<T>::value)
+            {
+                if (manifest.contains("fill_value"))
+                {
+                    T init_value = manifest["fill_value"].as<T>();
+                    return chunked_file_array<T, IOH, L, IP, EP>(shape, chunk_shape, path, init_value, pool_size, chunk_memory_layout);
+                }
+            }
+            return chunked_file_array<T, IOH, L, IP, EP>(shape, chunk_shape, path, pool_size, chunk_memory_layout);
+        };
+        result_type a = make_array();
+        typename IOH::format_config format_config;
+        detail::manifest_config_helper<typename IOH::format_config>::read(format_config, manifest);
+        a.chunks().configure(format_config, io_config);
+        a.chunks().set_manifest(std::move(manifest));
+        return a;
+    }
+
+    template <class T, class IOH, layout_type L, class IP, class EP>
+    inline xchunked_array<xchunk_store_manager<xfile_array<T, IOH, L>, IP, EP>>
+    open_chunked_file_array(const std::string& path, std::size_t pool_size, layout_type chunk_memory_layout)
+    {
+        typename IOH::io_config io_config = {};
+        return open_chunked_file_array<T, IOH, L, IP, EP>(path, io_config, pool_size, chunk_memory_layout);
+    }
+
     /***************************************
      * xchunk_store_manager implementation *
      ***************************************/
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class S>
-    inline xchunk_store_manager<EC, IP>::xchunk_store_manager(S&& shape,
+    inline xchunk_store_manager<EC, IP, EP>::xchunk_store_manager(S&& shape,
                                                               S&& chunk_shape,
                                                               const std::string& directory,
                                                               std::size_t pool_size,
                                                               layout_type chunk_memory_layout)
         : m_shape(xtl::forward_sequence<shape_type, S>(shape))
         , m_chunk_shape(xtl::forward_sequence<shape_type, S>(chunk_shape))
-        , m_unload_index(0u)
     {
         initialize(shape, chunk_shape, directory, false, 0, pool_size, chunk_memory_layout);
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class S, class T>
-    inline xchunk_store_manager<EC, IP>::xchunk_store_manager(S&& shape,
+    inline xchunk_store_manager<EC, IP, EP>::xchunk_store_manager(S&& shape,
                                                               S&& chunk_shape,
                                                               const std::string& directory,
                                                               std::size_t pool_size,
@@ -455,14 +1120,107 @@ namespace xt
                                                               layout_type chunk_memory_layout)
         : m_shape(xtl::forward_sequence<shape_type, S>(shape))
         , m_chunk_shape(xtl::forward_sequence<shape_type, S>(chunk_shape))
-        , m_unload_index(0u)
     {
         initialize(shape, chunk_shape, directory, true, init_value, pool_size, chunk_memory_layout);
     }
 
-    template <class EC, class IP>
+    /**
+     * Flushes the chunks and saves the manifest, if the store has one,
+     * so that the manifest lists the chunks written by the destruction
+     * of the pool. Otherwise, waits for the pending writes. Errors cannot
+     * be thrown from the destructor and are reported on the standard
+     * error; call flush() before to handle them.
+     */
+    template <class EC, class IP, class EP>
+    inline xchunk_store_manager<EC, IP, EP>::~xchunk_store_manager()
+    {
+        try
+        {
+            if (m_chunk_index)
+            {
+                flush();
+            }
+            else if (m_write_back)
+            {
+                m_write_back->wait_all();
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "xtensor-io: chunk store flush failed: " << e.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cerr << "xtensor-io: chunk store flush failed" << std::endl;
+        }
+    }
+
+    /**
+     * Copies a store manager. The pending loads and writes of the original
+     * store are finished first. The copy has its own worker threads and
+     * chunk index, and its chunks are not pinned.
+     */
+    template <class EC, class IP, class EP>
+    inline xchunk_store_manager<EC, IP, EP>::xchunk_store_manager(const xchunk_store_manager& rhs)
+    {
+        *this = rhs;
+    }
+
+    template <class EC, class IP, class EP>
+    inline auto xchunk_store_manager<EC, IP, EP>::operator=(const xchunk_store_manager& rhs) -> xchunk_store_manager&
+    {
+        if (this != &rhs)
+        {
+            // the workers of both stores access their pools
+            wait_workers();
+            rhs.wait_workers();
+            m_shape = rhs.m_shape;
+            m_chunk_shape = rhs.m_chunk_shape;
+            m_chunk_pool = rhs.m_chunk_pool;
+            m_index_pool = rhs.m_index_pool;
+            m_index_map = rhs.m_index_map;
+            m_free_slots = rhs.m_free_slots;
+            m_pin_count.assign(rhs.m_pin_count.size(), 0);
+            m_policy = rhs.m_policy;
+            m_last_slot = rhs.m_last_slot;
+            m_stats = rhs.m_stats;
+            m_index_path = rhs.m_index_path;
+            m_write_back.reset();
+            if (rhs.m_write_back)
+            {
+                m_write_back = std::make_shared<detail::xwrite_back_queue>(rhs.m_write_back->size());
+            }
+            m_prefetcher.reset();
+            if (rhs.m_prefetcher)
+            {
+                m_prefetcher = std::make_shared<detail::xprefetcher>(rhs.m_prefetcher->depth(),
+                                                                     rhs.m_prefetcher->size(),
+                                                                     m_chunk_pool.size());
+                for (std::size_t i = 0; i < m_chunk_pool.size(); ++i)
+                {
+                    if (rhs.m_prefetcher->has_failed(i))
+                    {
+                        // the chunk will be loaded again on next access
+                        unmap_slot(i);
+                    }
+                }
+            }
+            m_assign_threads = rhs.m_assign_threads;
+            m_configure_store = rhs.m_configure_store;
+            m_configure_chunk = rhs.m_configure_chunk;
+            m_manifest = rhs.m_manifest;
+            m_chunk_index.reset();
+            if (rhs.m_chunk_index)
+            {
+                m_chunk_index = std::make_shared<detail::xchunk_index>(*rhs.m_chunk_index);
+            }
+        }
+        return *this;
+    }
+
+    template <class EC, class IP, class EP>
     template <class S, class T>
-    inline void xchunk_store_manager<EC, IP>::initialize(S&& shape,
+    inline void xchunk_store_manager<EC, IP, EP>::initialize(S&& shape,
                                                          S&& chunk_shape,
                                                          const std::string& directory,
                                                          bool init,
@@ -484,146 +1242,541 @@ namespace xt
             m_chunk_pool.resize(pool_size, EC("", xfile_mode::init_on_fail));
         }
         m_index_pool.resize(pool_size);
+        m_index_map.reserve(pool_size);
+        // free slots are taken from the back
+        m_free_slots.resize(pool_size);
+        m_pin_count.assign(pool_size, 0);
+        for (std::size_t i = 0; i < pool_size; ++i)
+        {
+            m_free_slots[i] = pool_size - i - 1;
+        }
+        m_policy.reset(pool_size);
+        m_last_slot = npos;
         // resize the pool chunks
         for (auto& chunk: m_chunk_pool)
         {
             chunk.resize(chunk_shape, chunk_memory_layout);
         }
         m_index_path.set_directory(directory);
+        using chunk_value_type = typename EC::value_type;
+        m_manifest["shape"] = shape;
+        m_manifest["chunk_shape"] = m_chunk_shape;
+        m_manifest["dtype"] = detail::dtype_name<chunk_value_type>();
+        if constexpr (std::is_arithmetic<chunk_value_type>::value)
+        {
+            if (init)
+            {
+                m_manifest["fill_value"] = static_cast<chunk_value_type>(init_value);
+            }
+        }
     }
 
-    template <class EC, class IP>
-    inline auto xchunk_store_manager<EC, IP>::shape() const noexcept -> const shape_type&
+    template <class EC, class IP, class EP>
+    inline auto xchunk_store_manager<EC, IP, EP>::shape() const noexcept -> const shape_type&
     {
         return m_shape;
     }
 
-    template <class EC, class IP>
-    inline auto xchunk_store_manager<EC, IP>::chunk_shape() const noexcept -> const shape_type&
+    template <class EC, class IP, class EP>
+    inline auto xchunk_store_manager<EC, IP, EP>::chunk_shape() const noexcept -> const shape_type&
     {
         return m_chunk_shape;
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class... Idxs>
-    inline auto xchunk_store_manager<EC, IP>::operator()(Idxs... idxs) -> reference
+    inline auto xchunk_store_manager<EC, IP, EP>::operator()(Idxs... idxs) -> reference
     {
         auto index = get_indexes(idxs...);
         return map_file_array(index.cbegin(), index.cend());
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class... Idxs>
-    inline auto xchunk_store_manager<EC, IP>::operator()(Idxs... idxs) const -> const_reference
+    inline auto xchunk_store_manager<EC, IP, EP>::operator()(Idxs... idxs) const -> const_reference
     {
         auto index = get_indexes(idxs...);
         return map_file_array(index.cbegin(), index.cend());
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class It>
-    inline auto xchunk_store_manager<EC, IP>::element(It first, It last) -> reference
+    inline auto xchunk_store_manager<EC, IP, EP>::element(It first, It last) -> reference
     {
         return map_file_array(first, last);
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class It>
-    inline auto xchunk_store_manager<EC, IP>::element(It first, It last) const -> const_reference
+    inline auto xchunk_store_manager<EC, IP, EP>::element(It first, It last) const -> const_reference
     {
         return map_file_array(first, last);
     }
 
-    template <class EC, class IP>
-    template <class O>
-    inline auto xchunk_store_manager<EC, IP>::stepper_begin(const O& shape) noexcept -> stepper
+    /**
+     * Returns a handle on the chunk at the given position in the chunk grid,
+     * loading it if it is not in the pool. The chunk is pinned in the pool
+     * as long as the handle is alive, contrary to the references returned
+     * by operator(), which are silently repurposed when the chunk is unloaded.
+     * The handle must not outlive the store manager.
+     */
+    template <class EC, class IP, class EP>
+    template <class... Idxs>
+    inline auto xchunk_store_manager<EC, IP, EP>::chunk(Idxs... idxs) -> handle_type
     {
-        size_type offset = shape.size() - this->dimension();
-        return stepper(this, offset);
+        auto index = get_indexes(idxs...);
+        return get_chunk(index.cbegin(), index.cend());
+    }
+
+    template <class EC, class IP, class EP>
+    template <class It>
+    inline auto xchunk_store_manager<EC, IP, EP>::get_chunk(It first, It last) -> handle_type
+    {
+        EC& chunk = map_file_array(first, last);
+        std::size_t i = static_cast<std::size_t>(&chunk - m_chunk_pool.data());
+        ++m_pin_count[i];
+        return handle_type(this, &chunk, i);
+    }
+
+    template <class EC, class IP, class EP>
+    template <class O>
+    inline auto xchunk_store_manager<EC, IP, EP>::stepper_begin(const O& shape) noexcept -> stepper
+    {
+        size_type offset = shape.size() - this->dimension();
+        return stepper(this, offset);
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class O>
-    inline auto xchunk_store_manager<EC, IP>::stepper_end(const O& shape, layout_type) noexcept -> stepper
+    inline auto xchunk_store_manager<EC, IP, EP>::stepper_end(const O& shape, layout_type) noexcept -> stepper
     {
         size_type offset = shape.size() - this->dimension();
         return stepper(this, offset, true);
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class O>
-    inline auto xchunk_store_manager<EC, IP>::stepper_begin(const O& shape) const noexcept -> const_stepper
+    inline auto xchunk_store_manager<EC, IP, EP>::stepper_begin(const O& shape) const noexcept -> const_stepper
     {
         size_type offset = shape.size() - this->dimension();
         return const_stepper(this, offset);
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class O>
-    inline auto xchunk_store_manager<EC, IP>::stepper_end(const O& shape, layout_type) const noexcept -> const_stepper
+    inline auto xchunk_store_manager<EC, IP, EP>::stepper_end(const O& shape, layout_type) const noexcept -> const_stepper
     {
         size_type offset = shape.size() - this->dimension();
         return const_stepper(this, offset, true);
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class S>
-    inline void xchunk_store_manager<EC, IP>::resize(S&& shape)
+    inline void xchunk_store_manager<EC, IP, EP>::resize(S&& shape)
     {
         // don't resize according to total number of chunks
         // instead the pool manages a number of in-memory chunks
         m_shape = shape;
+        if (m_chunk_index && m_chunk_index->grid_shape != m_shape)
+        {
+            // keep the chunks which are still in the grid
+            const auto& grid_shape = m_chunk_index->grid_shape;
+            std::vector<bool> exists(compute_size(m_shape), false);
+            shape_type index;
+            for (std::size_t k = 0; k < m_chunk_index->exists.size(); ++k)
+            {
+                if (m_chunk_index->exists[k])
+                {
+                    detail::grid_index(grid_shape, k, index);
+                    std::size_t position = detail::grid_position(m_shape, index.cbegin(), index.cend());
+                    if (position < exists.size())
+                    {
+                        exists[position] = true;
+                    }
+                }
+            }
+            m_chunk_index->grid_shape = m_shape;
+            m_chunk_index->exists = std::move(exists);
+            m_chunk_index->modified = true;
+        }
     }
 
-    template <class EC, class IP>
-    inline auto xchunk_store_manager<EC, IP>::size() const -> size_type
+    template <class EC, class IP, class EP>
+    inline auto xchunk_store_manager<EC, IP, EP>::size() const -> size_type
     {
         return compute_size(m_shape);
     }
 
-    template <class EC, class IP>
-    inline const std::string& xchunk_store_manager<EC, IP>::get_directory() const
+    template <class EC, class IP, class EP>
+    inline const std::string& xchunk_store_manager<EC, IP, EP>::get_directory() const
     {
         return m_index_path.get_directory();
     }
 
-    template <class EC, class IP>
-    inline bool  xchunk_store_manager<EC, IP>::get_pool_size() const
+    template <class EC, class IP, class EP>
+    inline std::size_t xchunk_store_manager<EC, IP, EP>::get_pool_size() const
     {
         return m_chunk_pool.size();
     }
 
-    template <class EC, class IP>
-    inline void xchunk_store_manager<EC, IP>::flush()
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::flush()
     {
-        for (auto& chunk: m_chunk_pool)
+        if (m_prefetcher)
+        {
+            m_prefetcher->wait_all();
+        }
+        if (m_write_back)
+        {
+            // write the chunks in parallel, and wait for all
+            // the pending writes
+            for (auto& chunk: m_chunk_pool)
+            {
+                chunk.flush_async(*m_write_back);
+            }
+            m_write_back->wait_all();
+        }
+        else
+        {
+            for (auto& chunk: m_chunk_pool)
+            {
+                chunk.flush();
+            }
+        }
+        if (m_chunk_index)
+        {
+            for (std::size_t i = 0; i < m_chunk_pool.size(); ++i)
+            {
+                const auto& index = m_index_pool[i];
+                if (!index.empty())
+                {
+                    update_chunk_index(index.cbegin(), index.cend(), m_chunk_pool[i].file_may_exist());
+                }
+            }
+            save_manifest();
+        }
+    }
+
+    /**
+     * Enables the asynchronous write-back of the chunks unloaded from the pool.
+     * Compression and writing are then performed by worker threads instead of
+     * the thread accessing the array, and flush() waits for all the pending
+     * writes. At most 2 * nthreads writes are pending: unloading a chunk
+     * blocks until a worker completes a write when this limit is reached.
+     *
+     * @param nthreads The number of worker threads, 0 disables the write-back
+     */
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::set_write_back(std::size_t nthreads)
+    {
+        if (m_write_back)
         {
-            chunk.flush();
+            m_write_back->wait_all();
+        }
+        if (nthreads == 0)
+        {
+            m_write_back.reset();
+        }
+        else
+        {
+            m_write_back = std::make_shared<detail::xwrite_back_queue>(nthreads);
         }
     }
 
-    template <class EC, class IP>
+    /**
+     * Enables the prefetching of chunks. When a chunk is loaded, the next
+     * chunks in the row-major order of the chunk grid are asynchronously
+     * read and decoded into the pool, overlapping I/O with computation
+     * when the array is traversed sequentially.
+     *
+     * @param depth The number of chunks to prefetch, 0 disables the prefetching
+     * @param nthreads The number of I/O threads (default: 1)
+     */
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::set_prefetch(std::size_t depth, std::size_t nthreads)
+    {
+        if (m_prefetcher)
+        {
+            m_prefetcher->wait_all();
+            for (std::size_t i = 0; i < m_chunk_pool.size(); ++i)
+            {
+                collect_slot(i);
+            }
+        }
+        // at least one chunk of the pool is not prefetched
+        depth = std::min(depth, m_chunk_pool.size() - 1);
+        if (depth == 0)
+        {
+            m_prefetcher.reset();
+        }
+        else
+        {
+            m_prefetcher = std::make_shared<detail::xprefetcher>(depth, nthreads, m_chunk_pool.size());
+        }
+    }
+
+    /**
+     * Sets the number of threads used when an expression is assigned to
+     * the array. The chunks of the grid are then distributed over the
+     * threads, each of them encoding and writing its own chunks.
+     *
+     * @param nthreads The number of threads, 0 or 1 for a sequential assignment
+     */
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::set_assign_threads(std::size_t nthreads)
+    {
+        m_assign_threads = nthreads;
+    }
+
+    template <class EC, class IP, class EP>
+    inline std::size_t xchunk_store_manager<EC, IP, EP>::get_assign_threads() const noexcept
+    {
+        return m_assign_threads;
+    }
+
+    /**
+     * Configures the format and the IO handler of all the chunks. Formats
+     * sharing data between the chunks, such as the dictionary of
+     * xio_zstd_config, save it at the root of the store, or read it from
+     * there if the configuration doesn't have it.
+     *
+     * @param format_config The configuration of the format
+     * @param io_config The configuration of the IO handler
+     */
+    template <class EC, class IP, class EP>
     template <class FC, class IOC>
-    void xchunk_store_manager<EC, IP>::configure(FC& format_config, IOC& io_config)
+    void xchunk_store_manager<EC, IP, EP>::configure(FC& format_config, IOC& io_config)
     {
+        if (m_prefetcher)
+        {
+            m_prefetcher->wait_all();
+        }
+        detail::store_config_helper<FC>::configure_store(format_config, m_index_path.get_directory());
+        m_configure_store = [format_config](const std::string& directory) mutable
+        {
+            detail::store_config_helper<FC>::configure_store(format_config, directory);
+        };
+        m_configure_chunk = [format_config, io_config](EC& chunk) mutable
+        {
+            chunk.configure(format_config, io_config);
+        };
+        detail::manifest_config_helper<FC>::write(format_config, m_manifest);
+        if (m_chunk_index)
+        {
+            m_chunk_index->modified = true;
+        }
         for (auto& chunk: m_chunk_pool)
         {
             chunk.configure(format_config, io_config);
         }
     }
 
-    template <class EC, class IP>
-    IP& xchunk_store_manager<EC, IP>::get_index_path()
+    /**
+     * Configures the chunks with the format and IO handler configurations
+     * of another store, e.g. a temporary store whose chunks are moved to the
+     * other store. The data shared by the chunks is not copied.
+     *
+     * @param other The store whose configuration is applied
+     */
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::configure_like(const xchunk_store_manager& other)
+    {
+        if (m_prefetcher)
+        {
+            m_prefetcher->wait_all();
+        }
+        m_configure_chunk = other.m_configure_chunk;
+        if (m_configure_chunk)
+        {
+            for (auto& chunk: m_chunk_pool)
+            {
+                m_configure_chunk(chunk);
+            }
+        }
+    }
+
+    /**
+     * Trains a compression dictionary on the chunks currently in the pool,
+     * and configures all the chunks with it. Small chunks compress much
+     * better with a dictionary, which is built once and shared by all the
+     * chunks. It is saved at the root of the store along with the
+     * dictionaries it replaces, so that the chunks written before the
+     * training can still be read.
+     *
+     * @param format_config The configuration of the format (e.g. xio_zstd_config)
+     * @param io_config The configuration of the IO handler
+     */
+    template <class EC, class IP, class EP>
+    template <class FC, class IOC>
+    void xchunk_store_manager<EC, IP, EP>::train_dictionary(FC& format_config, IOC& io_config)
+    {
+        using chunk_value_type = typename EC::value_type;
+        if (m_prefetcher)
+        {
+            m_prefetcher->wait_all();
+        }
+        // the samples must be in the byte order of the files
+        bool swap = (sizeof(chunk_value_type) > 1) && (format_config.big_endian != is_big_endian());
+        std::string samples;
+        std::vector<std::size_t> sample_sizes;
+        for (std::size_t i = 0; i < m_chunk_pool.size(); ++i)
+        {
+            if (!m_index_pool[i].empty())
+            {
+                const auto& storage = m_chunk_pool[i].storage();
+                std::size_t offset = samples.size();
+                std::size_t nbytes = storage.size() * sizeof(chunk_value_type);
+                samples.resize(offset + nbytes);
+                std::memcpy(&samples[offset], storage.data(), nbytes);
+                if (swap)
+                {
+                    swap_endianness(reinterpret_cast<chunk_value_type*>(&samples[offset]), storage.size());
+                }
+                sample_sizes.push_back(nbytes);
+            }
+        }
+        format_config.train_dictionary(samples, sample_sizes);
+        configure(format_config, io_config);
+    }
+
+    template <class EC, class IP, class EP>
+    IP& xchunk_store_manager<EC, IP, EP>::get_index_path()
     {
         return m_index_path;
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
+    EP& xchunk_store_manager<EC, IP, EP>::get_policy()
+    {
+        return m_policy;
+    }
+
+    template <class EC, class IP, class EP>
+    inline const xchunk_pool_stats& xchunk_store_manager<EC, IP, EP>::pool_stats() const noexcept
+    {
+        return m_stats;
+    }
+
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::reset_pool_stats()
+    {
+        m_stats = xchunk_pool_stats();
+    }
+
+    /**
+     * Enables or disables the manifest of the store. The manifest is saved
+     * at the root of the store by flush(), and records the shape, the chunk
+     * shape, the type of the elements, the init value and the configuration
+     * of the format, with the index of the chunks which exist. The missing
+     * chunks are then initialized without accessing the storage.
+     * If the store already has a manifest, it is loaded, otherwise the index
+     * is built by listing the directory of the store once. Disabling the
+     * manifest removes it from the store.
+     *
+     * @param enabled true to enable the manifest
+     */
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::set_manifest(bool enabled)
+    {
+        std::string path = detail::manifest_path(m_index_path.get_directory());
+        if (enabled && !m_chunk_index)
+        {
+            xstore_manifest manifest;
+            if (manifest.load(path))
+            {
+                set_manifest(std::move(manifest));
+            }
+            else
+            {
+                m_chunk_index = std::make_shared<detail::xchunk_index>();
+                build_chunk_index();
+            }
+        }
+        else if (!enabled && m_chunk_index)
+        {
+            m_chunk_index.reset();
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+        }
+    }
+
+    /**
+     * Enables the manifest of the store, with a manifest already loaded from
+     * the root of the store. The chunk shape and the type of the elements
+     * must be the ones of the store.
+     *
+     * @param manifest The manifest of the store
+     */
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::set_manifest(xstore_manifest manifest)
+    {
+        if (manifest.contains("chunk_shape") && manifest["chunk_shape"].as<shape_type>() != m_chunk_shape)
+        {
+            XTENSOR_THROW(std::runtime_error, "chunk store: the manifest has another chunk shape");
+        }
+        if (manifest.contains("dtype") && manifest["dtype"].str() != m_manifest["dtype"].str())
+        {
+            XTENSOR_THROW(std::runtime_error, "chunk store: the manifest has another type of elements");
+        }
+        auto chunk_index = std::make_shared<detail::xchunk_index>();
+        bool indexed = manifest.contains("grid_shape") && manifest.contains("chunks");
+        if (indexed)
+        {
+            chunk_index->grid_shape = manifest["grid_shape"].as<shape_type>();
+            chunk_index->exists = detail::decode_bitmap(manifest["chunks"].str(), compute_size(chunk_index->grid_shape));
+            manifest.erase("grid_shape");
+            manifest.erase("chunks");
+        }
+        // the entries of the store take precedence
+        if (!m_manifest.contains("fill_value"))
+        {
+            manifest.erase("fill_value");
+        }
+        manifest.update(m_manifest);
+        m_manifest = std::move(manifest);
+        m_chunk_index = std::move(chunk_index);
+        if (indexed)
+        {
+            resize(shape_type(m_shape));
+            if (m_prefetcher)
+            {
+                m_prefetcher->wait_all();
+            }
+            for (std::size_t i = 0; i < m_chunk_pool.size(); ++i)
+            {
+                const auto& index = m_index_pool[i];
+                if (!index.empty())
+                {
+                    update_chunk_index(index.cbegin(), index.cend(), m_chunk_pool[i].file_may_exist());
+                }
+            }
+        }
+        else
+        {
+            build_chunk_index();
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    inline bool xchunk_store_manager<EC, IP, EP>::has_manifest() const noexcept
+    {
+        return m_chunk_index != nullptr;
+    }
+
+    /**
+     * Returns the manifest entries describing the store, without the chunk
+     * index.
+     */
+    template <class EC, class IP, class EP>
+    inline const xstore_manifest& xchunk_store_manager<EC, IP, EP>::manifest() const noexcept
+    {
+        return m_manifest;
+    }
+
+    template <class EC, class IP, class EP>
     template <class I>
-    inline auto xchunk_store_manager<EC, IP>::map_file_array(I first, I last) -> reference
+    inline auto xchunk_store_manager<EC, IP, EP>::map_file_array(I first, I last) -> reference
     {
-        std::string path;
-        m_index_path.index_to_path(first, last, path);
         if (first == last)
         {
             return m_chunk_pool[0];
@@ -631,45 +1784,75 @@ namespace xt
         else
         {
             // check if the chunk is already loaded in memory
-            const auto it1 = std::find_if(m_index_pool.cbegin(), m_index_pool.cend(), [first, last](const auto& v)
-                { return std::equal(v.cbegin(), v.cend(), first, last); });
-            std::size_t i;
-            if (it1 != m_index_pool.cend())
+            std::size_t key = detail::chunk_key(first, last);
+            std::size_t i = find_slot(key, first, last);
+            if (i != npos)
             {
-                i = static_cast<std::size_t>(std::distance(m_index_pool.cbegin(), it1));
+                if (m_prefetcher)
+                {
+                    collect_slot(i);
+                }
+                // the policy and the counters see the accesses to chunks,
+                // not to elements
+                if (i != m_last_slot)
+                {
+                    m_policy.access(i);
+                    ++m_stats.hits;
+                    m_last_slot = i;
+                }
                 return m_chunk_pool[i];
             }
-            // if not, find a free chunk in the pool
-            std::vector<std::size_t> empty_index;
-            const auto it2 = std::find(m_index_pool.cbegin(), m_index_pool.cend(), empty_index);
-            if (it2 != m_index_pool.cend())
+            // if not, take a free chunk in the pool, or unload one
+            // according to the replacement policy
+            ++m_stats.misses;
+            i = acquire_slot(key);
+            if (i == npos && m_prefetcher)
             {
-                i = static_cast<std::size_t>(std::distance(m_index_pool.cbegin(), it2));
-                m_chunk_pool[i].set_path(path);
-                m_index_pool[i].resize(static_cast<size_t>(std::distance(first, last)));
-                std::copy(first, last, m_index_pool[i].begin());
-                return m_chunk_pool[i];
+                // all the chunks are being prefetched
+                m_prefetcher->wait_all();
+                i = acquire_slot(key);
             }
-            // no free chunk, take one (which will thus be unloaded)
-            // fairness is guaranteed through the use of a walking index
-            m_chunk_pool[m_unload_index].set_path(path);
-            m_index_pool[m_unload_index].resize(static_cast<size_t>(std::distance(first, last)));
-            std::copy(first, last, m_index_pool[m_unload_index].begin());
-            auto& chunk = m_chunk_pool[m_unload_index];
-            m_unload_index = (m_unload_index + 1) % m_index_pool.size();
-            return chunk;
+            if (i == npos)
+            {
+                XTENSOR_THROW(std::runtime_error, "chunk pool: no chunk can be unloaded");
+            }
+            // the path is only needed when the chunk is not in memory
+            std::string path;
+            m_index_path.index_to_path(first, last, path);
+            bool may_exist = chunk_may_exist(first, last);
+            if (m_write_back)
+            {
+                m_chunk_pool[i].flush_async(*m_write_back);
+                // the chunk may have been unloaded and not written yet
+                m_write_back->wait(path);
+            }
+            m_chunk_pool[i].set_path(path, may_exist);
+            if (may_exist)
+            {
+                update_chunk_index(first, last, m_chunk_pool[i].file_may_exist());
+            }
+            m_index_pool[i].resize(static_cast<size_t>(std::distance(first, last)));
+            std::copy(first, last, m_index_pool[i].begin());
+            m_index_map.emplace(key, i);
+            detail::policy_helper<EP, shape_type>::insert(m_policy, i, key, m_index_pool[i]);
+            m_last_slot = i;
+            if (m_prefetcher)
+            {
+                prefetch(first, last, i);
+            }
+            return m_chunk_pool[i];
         }
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class I>
-    inline auto xchunk_store_manager<EC, IP>::map_file_array(I first, I last) const -> const_reference
+    inline auto xchunk_store_manager<EC, IP, EP>::map_file_array(I first, I last) const -> const_reference
     {
-        return const_cast<xchunk_store_manager<EC, IP>*>(this)->map_file_array(first, last);
+        return const_cast<xchunk_store_manager<EC, IP, EP>*>(this)->map_file_array(first, last);
     }
 
-    template <class EC, class IP>
-    inline std::string xchunk_store_manager<EC, IP>::get_temporary_directory() const
+    template <class EC, class IP, class EP>
+    inline std::string xchunk_store_manager<EC, IP, EP>::get_temporary_directory() const
     {
         namespace fs = std::filesystem;
         fs::path tmp_dir = fs::temp_directory_path();
@@ -681,19 +1864,301 @@ namespace xt
         return tmp_dir / std::to_string(count);
     }
 
-    template <class EC, class IP>
-    inline void xchunk_store_manager<EC, IP>::reset_to_directory(const std::string& directory)
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::reset_to_directory(const std::string& directory)
     {
         namespace fs = std::filesystem;
+        if (m_prefetcher)
+        {
+            m_prefetcher->wait_all();
+        }
+        if (m_write_back)
+        {
+            m_write_back->wait_all();
+        }
         fs::remove_all(get_directory());
         fs::rename(directory, get_directory());
-        m_unload_index = 0u;
+        if (m_configure_store)
+        {
+            // the data shared by the chunks was in the replaced directory
+            m_configure_store(m_index_path.get_directory());
+        }
+        if (m_chunk_index)
+        {
+            // so was the manifest
+            build_chunk_index();
+            save_manifest();
+        }
+        m_policy.reset(m_chunk_pool.size());
+        m_last_slot = npos;
+        for (std::size_t i = 0; i < m_index_pool.size(); ++i)
+        {
+            const auto& index = m_index_pool[i];
+            if (!index.empty())
+            {
+                detail::policy_helper<EP, shape_type>::insert(m_policy, i, detail::chunk_key(index.cbegin(), index.cend()), index);
+            }
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    template <class I>
+    inline std::size_t xchunk_store_manager<EC, IP, EP>::find_slot(std::size_t key, I first, I last) const
+    {
+        auto range = m_index_map.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const auto& index = m_index_pool[it->second];
+            if (std::equal(index.cbegin(), index.cend(), first, last))
+            {
+                return it->second;
+            }
+        }
+        return npos;
+    }
+
+    template <class EC, class IP, class EP>
+    inline std::size_t xchunk_store_manager<EC, IP, EP>::acquire_slot(std::size_t key, std::size_t excluded)
+    {
+        std::size_t i;
+        if (!m_free_slots.empty())
+        {
+            i = m_free_slots.back();
+            m_free_slots.pop_back();
+        }
+        else
+        {
+            // no free chunk, take one (which will thus be unloaded)
+            i = m_policy.victim(key, [this, excluded](std::size_t slot)
+                {
+                    return slot != excluded && m_pin_count[slot] == 0 &&
+                           (!m_prefetcher || m_prefetcher->is_evictable(slot));
+                });
+            if (i == npos)
+            {
+                return npos;
+            }
+            ++m_stats.evictions;
+            if (m_prefetcher)
+            {
+                // the prefetched chunk has not been accessed,
+                // a loading error can be ignored
+                static_cast<void>(m_prefetcher->wait(i));
+            }
+            if (m_chunk_index)
+            {
+                // the chunk is written when the slot is reused
+                const auto& index = m_index_pool[i];
+                update_chunk_index(index.cbegin(), index.cend(), m_chunk_pool[i].file_may_exist());
+            }
+            unmap_slot(i);
+        }
+        return i;
+    }
+
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::release_pin(std::size_t i)
+    {
+        --m_pin_count[i];
+    }
+
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::wait_workers() const
+    {
+        if (m_prefetcher)
+        {
+            m_prefetcher->wait_all();
+        }
+        if (m_write_back)
+        {
+            m_write_back->wait_all();
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::unmap_slot(std::size_t i)
+    {
+        const auto& index = m_index_pool[i];
+        auto range = m_index_map.equal_range(detail::chunk_key(index.cbegin(), index.cend()));
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == i)
+            {
+                m_index_map.erase(it);
+                break;
+            }
+        }
+        m_index_pool[i].clear();
+        if (i == m_last_slot)
+        {
+            m_last_slot = npos;
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::collect_slot(std::size_t i)
+    {
+        if (m_prefetcher->is_pending(i))
+        {
+            std::exception_ptr error = m_prefetcher->wait(i);
+            if (error)
+            {
+                // the chunk will be loaded again on next access
+                unmap_slot(i);
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    template <class I>
+    inline void xchunk_store_manager<EC, IP, EP>::prefetch(I first, I last, std::size_t current)
+    {
+        shape_type index(first, last);
+        if (index.size() != m_shape.size())
+        {
+            return;
+        }
+        for (std::size_t n = 0; n < m_prefetcher->depth(); ++n)
+        {
+            // next chunk in row-major order
+            std::size_t d = index.size();
+            while (d != 0)
+            {
+                --d;
+                if (++index[d] < m_shape[d])
+                {
+                    break;
+                }
+                index[d] = 0;
+                if (d == 0)
+                {
+                    return;
+                }
+            }
+            std::size_t key = detail::chunk_key(index.cbegin(), index.cend());
+            if (find_slot(key, index.cbegin(), index.cend()) != npos)
+            {
+                continue;
+            }
+            std::size_t i = acquire_slot(key, current);
+            if (i == npos)
+            {
+                return;
+            }
+            std::string path;
+            m_index_path.index_to_path(index.cbegin(), index.cend(), path);
+            bool may_exist = chunk_may_exist(index.cbegin(), index.cend());
+            if (m_write_back)
+            {
+                m_chunk_pool[i].flush_async(*m_write_back);
+            }
+            // the worker only accesses the chunk being loaded, until
+            // it is collected by the owning thread
+            EC* chunk = &m_chunk_pool[i];
+            m_prefetcher->load(i, [chunk, path, may_exist, write_back = m_write_back]()
+            {
+                if (write_back)
+                {
+                    write_back->wait(path);
+                }
+                chunk->set_path(path, may_exist);
+            });
+            m_index_pool[i] = index;
+            m_index_map.emplace(key, i);
+            detail::policy_helper<EP, shape_type>::insert(m_policy, i, key, index);
+            ++m_stats.prefetches;
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    template <class I>
+    inline bool xchunk_store_manager<EC, IP, EP>::chunk_may_exist(I first, I last) const
+    {
+        if (!m_chunk_index)
+        {
+            return true;
+        }
+        const auto& exists = m_chunk_index->exists;
+        std::size_t position = detail::grid_position(m_chunk_index->grid_shape, first, last);
+        return position < exists.size() && exists[position];
+    }
+
+    template <class EC, class IP, class EP>
+    template <class I>
+    inline void xchunk_store_manager<EC, IP, EP>::update_chunk_index(I first, I last, bool exists)
+    {
+        if (m_chunk_index)
+        {
+            auto& chunk_index = *m_chunk_index;
+            std::size_t position = detail::grid_position(chunk_index.grid_shape, first, last);
+            if (position < chunk_index.exists.size() && chunk_index.exists[position] != exists)
+            {
+                chunk_index.exists[position] = exists;
+                chunk_index.modified = true;
+            }
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::build_chunk_index()
+    {
+        namespace fs = std::filesystem;
+        if (m_prefetcher)
+        {
+            m_prefetcher->wait_all();
+        }
+        // a single listing of the store instead of a lookup per chunk
+        std::unordered_set<std::string> files;
+        std::error_code ec;
+        for (fs::recursive_directory_iterator it(m_index_path.get_directory(), ec), end; !ec && it != end; it.increment(ec))
+        {
+            if (it->is_regular_file(ec))
+            {
+                files.insert(it->path().string());
+            }
+        }
+        auto& chunk_index = *m_chunk_index;
+        chunk_index.grid_shape = m_shape;
+        chunk_index.exists.assign(compute_size(m_shape), false);
+        shape_type index;
+        std::string path;
+        for (std::size_t k = 0; k < chunk_index.exists.size(); ++k)
+        {
+            detail::grid_index(m_shape, k, index);
+            m_index_path.index_to_path(index.cbegin(), index.cend(), path);
+            chunk_index.exists[k] = files.count(path) != 0;
+        }
+        for (std::size_t i = 0; i < m_chunk_pool.size(); ++i)
+        {
+            const auto& chunk_position = m_index_pool[i];
+            if (!chunk_position.empty() && m_chunk_pool[i].file_may_exist())
+            {
+                update_chunk_index(chunk_position.cbegin(), chunk_position.cend(), true);
+            }
+        }
+        chunk_index.modified = true;
+    }
+
+    template <class EC, class IP, class EP>
+    inline void xchunk_store_manager<EC, IP, EP>::save_manifest()
+    {
+        if (m_chunk_index && m_chunk_index->modified)
+        {
+            std::string directory = m_index_path.get_directory();
+            std::filesystem::create_directories(directory);
+            xstore_manifest manifest = m_manifest;
+            manifest["grid_shape"] = m_chunk_index->grid_shape;
+            manifest["chunks"] = detail::encode_bitmap(m_chunk_index->exists);
+            manifest.save(detail::manifest_path(directory));
+            m_chunk_index->modified = false;
+        }
     }
 
-    template <class EC, class IP>
+    template <class EC, class IP, class EP>
     template <class... Idxs>
     inline std::array<std::size_t, sizeof...(Idxs)>
-    xchunk_store_manager<EC, IP>::get_indexes(Idxs... idxs) const
+    xchunk_store_manager<EC, IP, EP>::get_indexes(Idxs... idxs) const
     {
         std::array<std::size_t, sizeof...(Idxs)> indexes = {{idxs...}};
         return indexes;
@@ -0,0 +1,550 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_CONCURRENT_CHUNK_STORE_HPP
+#define XTENSOR_IO_CONCURRENT_CHUNK_STORE_HPP
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <xtl/xsequence.hpp>
+
+#include "xchunk_handle.hpp"
+#include "xchunk_pool_policy.hpp"
+#include "xchunk_store_manager.hpp"
+
+namespace xt
+{
+    namespace detail
+    {
+        // Part of a concurrent chunk pool, guarded by its own mutex.
+        // A slot can only be reused when its pin count is zero; when
+        // all the slots are pinned, acquire waits for a pin release.
+        // Chunks are loaded, and evicted chunks written, without holding
+        // the mutex: the slot is marked as loading, and the threads
+        // requesting the same chunk wait for the end of the I/O.
+        template <class EC, class EP>
+        class xchunk_shard
+        {
+        public:
+
+            using chunk_type = EC;
+            using handle_type = xchunk_handle<EC, xchunk_shard<EC, EP>>;
+
+            void initialize(std::size_t pool_size, const chunk_type& chunk);
+
+            template <class I, class F>
+            handle_type acquire(std::size_t key, I first, I last, F&& path_of);
+
+            template <class FC, class IOC>
+            void configure(FC& format_config, IOC& io_config);
+
+            void flush();
+            xchunk_pool_stats pool_stats() const;
+
+        private:
+
+            friend handle_type;
+
+            void release_pin(std::size_t slot);
+            void evict(std::size_t slot, std::unique_lock<std::mutex>& lock);
+            void unmap_slot(std::size_t slot);
+            bool is_loading() const;
+
+            static constexpr std::size_t npos = std::size_t(-1);
+
+            mutable std::mutex m_mutex;
+            std::condition_variable m_cond;
+            std::vector<chunk_type> m_chunk_pool;
+            std::vector<std::vector<std::size_t>> m_index_pool;
+            std::unordered_multimap<std::size_t, std::size_t> m_index_map;
+            std::vector<std::size_t> m_pin_count;
+            std::vector<std::size_t> m_free_slots;
+            std::vector<char> m_loading;
+            std::size_t m_last_slot = npos;
+            EP m_policy;
+            xchunk_pool_stats m_stats;
+        };
+    }
+
+    /**
+     * @class xconcurrent_chunk_store
+     * @brief Chunk store that can be shared by several threads.
+     *
+     * Contrary to xchunk_store_manager, which must only be accessed by one
+     * thread, the pool of this store is split into shards, each guarded by
+     * its own mutex, so that threads accessing chunks of different shards
+     * do not contend. Chunks are accessed through handles which pin them in
+     * the pool: a chunk is never unloaded while a handle on it is alive.
+     *
+     * Chunks are loaded and written without holding the lock of their shard,
+     * so that the hits on a shard are not delayed by the I/O of its misses; a
+     * thread accessing a chunk being loaded, or being written before it is
+     * unloaded, waits for the end of the I/O. When
+     * all the chunks of a shard are pinned, accessing another chunk of this
+     * shard blocks until a handle is released, hence a thread should not hold
+     * more handles than the number of chunks per shard. Concurrent writes to
+     * the same chunk must be synchronized by the caller.
+     *
+     * @tparam EC The type of a chunk (e.g. xfile_array)
+     * @tparam IP The type of the index-to-path transformer (default: xindex_path)
+     * @tparam EP The replacement policy of each shard (default: xlru_policy)
+     */
+    template <class EC, class IP = xindex_path, class EP = xlru_policy>
+    class xconcurrent_chunk_store
+    {
+    public:
+
+        using chunk_type = EC;
+        using value_type = typename EC::value_type;
+        using shape_type = std::vector<std::size_t>;
+        using shard_type = detail::xchunk_shard<EC, EP>;
+        using handle_type = typename shard_type::handle_type;
+
+        template <class S>
+        xconcurrent_chunk_store(S&& shape,
+                                S&& chunk_shape,
+                                const std::string& directory,
+                                std::size_t pool_size,
+                                std::size_t nb_shards = 16,
+                                layout_type chunk_memory_layout = XTENSOR_DEFAULT_LAYOUT);
+
+        const shape_type& shape() const noexcept;
+        const shape_type& chunk_shape() const noexcept;
+        const shape_type& grid_shape() const noexcept;
+        const std::string& get_directory() const;
+        std::size_t get_pool_size() const noexcept;
+        std::size_t get_nb_shards() const noexcept;
+
+        template <class I>
+        handle_type get_chunk(I first, I last);
+
+        template <class... Idxs>
+        handle_type chunk(Idxs... idxs);
+
+        template <class... Idxs>
+        value_type operator()(Idxs... idxs);
+
+        template <class FC, class IOC>
+        void configure(FC& format_config, IOC& io_config);
+
+        void flush();
+        xchunk_pool_stats pool_stats() const;
+
+    private:
+
+        void initialize(std::size_t pool_size, std::size_t nb_shards, const chunk_type& chunk);
+
+        shape_type m_shape;
+        shape_type m_chunk_shape;
+        shape_type m_grid_shape;
+        std::string m_directory;
+        IP m_index_path;
+        std::size_t m_pool_size;
+        std::vector<std::unique_ptr<shard_type>> m_shards;
+    };
+
+    /*******************************
+     * xchunk_shard implementation *
+     *******************************/
+
+    namespace detail
+    {
+        template <class EC, class EP>
+        inline void xchunk_shard<EC, EP>::initialize(std::size_t pool_size, const chunk_type& chunk)
+        {
+            m_chunk_pool.resize(pool_size, chunk);
+            m_index_pool.resize(pool_size);
+            m_index_map.reserve(pool_size);
+            m_pin_count.resize(pool_size, 0);
+            m_loading.resize(pool_size, 0);
+            m_free_slots.resize(pool_size);
+            for (std::size_t i = 0; i < pool_size; ++i)
+            {
+                m_free_slots[i] = pool_size - i - 1;
+            }
+            m_policy.reset(pool_size);
+        }
+
+        template <class EC, class EP>
+        template <class I, class F>
+        inline auto xchunk_shard<EC, EP>::acquire(std::size_t key, I first, I last, F&& path_of) -> handle_type
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            std::size_t i = npos;
+            while (i == npos)
+            {
+                std::size_t j = npos;
+                auto range = m_index_map.equal_range(key);
+                for (auto it = range.first; it != range.second && j == npos; ++it)
+                {
+                    const auto& index = m_index_pool[it->second];
+                    if (std::equal(index.cbegin(), index.cend(), first, last))
+                    {
+                        j = it->second;
+                    }
+                }
+                if (j != npos)
+                {
+                    if (m_loading[j])
+                    {
+                        // the chunk may fail to load, it is looked up again
+                        m_cond.wait(lock);
+                        continue;
+                    }
+                    // the policy sees the accesses to chunks, not to elements
+                    if (j != m_last_slot)
+                    {
+                        m_policy.access(j);
+                        ++m_stats.hits;
+                        m_last_slot = j;
+                    }
+                    ++m_pin_count[j];
+                    return handle_type(this, &m_chunk_pool[j], j);
+                }
+                if (!m_free_slots.empty())
+                {
+                    i = m_free_slots.back();
+                    m_free_slots.pop_back();
+                }
+                else
+                {
+                    i = m_policy.victim(key, [this](std::size_t slot) { return m_pin_count[slot] == 0; });
+                    if (i == npos)
+                    {
+                        // the chunk may have been loaded in the meantime
+                        m_cond.wait(lock);
+                    }
+                    else
+                    {
+                        evict(i, lock);
+                        // the slot is free now, but the chunk may have been
+                        // loaded in the meantime
+                        i = npos;
+                    }
+                }
+            }
+            ++m_stats.misses;
+            // the slot is reserved for the chunk while it is loaded
+            m_index_pool[i].assign(first, last);
+            m_index_map.emplace(key, i);
+            m_loading[i] = 1;
+            ++m_pin_count[i];
+            lock.unlock();
+            try
+            {
+                m_chunk_pool[i].set_path(path_of());
+            }
+            catch (...)
+            {
+                lock.lock();
+                unmap_slot(i);
+                m_loading[i] = 0;
+                --m_pin_count[i];
+                m_free_slots.push_back(i);
+                lock.unlock();
+                m_cond.notify_all();
+                throw;
+            }
+            lock.lock();
+            m_loading[i] = 0;
+            detail::policy_helper<EP, std::vector<std::size_t>>::insert(m_policy, i, key, m_index_pool[i]);
+            m_last_slot = i;
+            lock.unlock();
+            m_cond.notify_all();
+            return handle_type(this, &m_chunk_pool[i], i);
+        }
+
+        template <class EC, class EP>
+        template <class FC, class IOC>
+        inline void xchunk_shard<EC, EP>::configure(FC& format_config, IOC& io_config)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return !is_loading(); });
+            for (auto& chunk: m_chunk_pool)
+            {
+                chunk.configure(format_config, io_config);
+            }
+        }
+
+        template <class EC, class EP>
+        inline void xchunk_shard<EC, EP>::flush()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return !is_loading(); });
+            for (auto& chunk: m_chunk_pool)
+            {
+                chunk.flush();
+            }
+        }
+
+        template <class EC, class EP>
+        inline xchunk_pool_stats xchunk_shard<EC, EP>::pool_stats() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_stats;
+        }
+
+        template <class EC, class EP>
+        inline void xchunk_shard<EC, EP>::release_pin(std::size_t slot)
+        {
+            bool released;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                released = --m_pin_count[slot] == 0;
+            }
+            if (released)
+            {
+                m_cond.notify_all();
+            }
+        }
+
+        // Writes the chunk of a slot selected by the policy, and frees the
+        // slot. The chunk stays mapped while it is written, and is marked as
+        // loading, so that a thread accessing it waits for the end of the
+        // write instead of reading its file in the meantime.
+        template <class EC, class EP>
+        inline void xchunk_shard<EC, EP>::evict(std::size_t slot, std::unique_lock<std::mutex>& lock)
+        {
+            ++m_stats.evictions;
+            m_loading[slot] = 1;
+            ++m_pin_count[slot];
+            lock.unlock();
+            try
+            {
+                m_chunk_pool[slot].flush();
+            }
+            catch (...)
+            {
+                lock.lock();
+                const auto& index = m_index_pool[slot];
+                detail::policy_helper<EP, std::vector<std::size_t>>::insert(m_policy, slot, detail::chunk_key(index.cbegin(), index.cend()), index);
+                m_loading[slot] = 0;
+                --m_pin_count[slot];
+                lock.unlock();
+                m_cond.notify_all();
+                throw;
+            }
+            lock.lock();
+            unmap_slot(slot);
+            m_loading[slot] = 0;
+            --m_pin_count[slot];
+            m_free_slots.push_back(slot);
+            m_cond.notify_all();
+        }
+
+        template <class EC, class EP>
+        inline void xchunk_shard<EC, EP>::unmap_slot(std::size_t slot)
+        {
+            const auto& index = m_index_pool[slot];
+            auto range = m_index_map.equal_range(detail::chunk_key(index.cbegin(), index.cend()));
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (it->second == slot)
+                {
+                    m_index_map.erase(it);
+                    break;
+                }
+            }
+            m_index_pool[slot].clear();
+            if (slot == m_last_slot)
+            {
+                m_last_slot = npos;
+            }
+        }
+
+        template <class EC, class EP>
+        inline bool xchunk_shard<EC, EP>::is_loading() const
+        {
+            return std::find(m_loading.cbegin(), m_loading.cend(), 1) != m_loading.cend();
+        }
+    }
+
+    /******************************************
+     * xconcurrent_chunk_store implementation *
+     ******************************************/
+
+    /**
+     * Creates a concurrent chunk store.
+     *
+     * @param shape The shape of the array
+     * @param chunk_shape The shape of a chunk
+     * @param directory The directory of the chunk files
+     * @param pool_size The number of chunks that can be held in memory
+     * @param nb_shards The number of independently locked parts of the pool
+     * @param chunk_memory_layout The layout of the chunks
+     */
+    template <class EC, class IP, class EP>
+    template <class S>
+    inline xconcurrent_chunk_store<EC, IP, EP>::xconcurrent_chunk_store(S&& shape,
+                                                                    S&& chunk_shape,
+                                                                    const std::string& directory,
+                                                                    std::size_t pool_size,
+                                                                    std::size_t nb_shards,
+                                                                    layout_type chunk_memory_layout)
+        : m_shape(xtl::forward_sequence<shape_type, S>(shape))
+        , m_chunk_shape(xtl::forward_sequence<shape_type, S>(chunk_shape))
+    {
+        EC chunk("", xfile_mode::init_on_fail);
+        chunk.resize(m_chunk_shape, chunk_memory_layout);
+        m_index_path.set_directory(directory);
+        m_directory = m_index_path.get_directory();
+        initialize(pool_size, nb_shards, chunk);
+    }
+
+    template <class EC, class IP, class EP>
+    inline void xconcurrent_chunk_store<EC, IP, EP>::initialize(std::size_t pool_size, std::size_t nb_shards, const chunk_type& chunk)
+    {
+        if (m_shape.size() != m_chunk_shape.size())
+        {
+            XTENSOR_THROW(std::runtime_error, "concurrent chunk store: chunk shape does not match the shape");
+        }
+        m_grid_shape.resize(m_shape.size());
+        for (std::size_t d = 0; d < m_shape.size(); ++d)
+        {
+            m_grid_shape[d] = (m_shape[d] + m_chunk_shape[d] - 1) / m_chunk_shape[d];
+        }
+        m_pool_size = std::max<std::size_t>(pool_size, 1);
+        // each shard holds at least one chunk
+        nb_shards = std::min(std::max<std::size_t>(nb_shards, 1), m_pool_size);
+        m_shards.reserve(nb_shards);
+        for (std::size_t i = 0; i < nb_shards; ++i)
+        {
+            m_shards.push_back(std::make_unique<shard_type>());
+            std::size_t shard_size = m_pool_size / nb_shards + (i < m_pool_size % nb_shards ? 1 : 0);
+            m_shards.back()->initialize(shard_size, chunk);
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    inline auto xconcurrent_chunk_store<EC, IP, EP>::shape() const noexcept -> const shape_type&
+    {
+        return m_shape;
+    }
+
+    template <class EC, class IP, class EP>
+    inline auto xconcurrent_chunk_store<EC, IP, EP>::chunk_shape() const noexcept -> const shape_type&
+    {
+        return m_chunk_shape;
+    }
+
+    template <class EC, class IP, class EP>
+    inline auto xconcurrent_chunk_store<EC, IP, EP>::grid_shape() const noexcept -> const shape_type&
+    {
+        return m_grid_shape;
+    }
+
+    template <class EC, class IP, class EP>
+    inline const std::string& xconcurrent_chunk_store<EC, IP, EP>::get_directory() const
+    {
+        return m_directory;
+    }
+
+    template <class EC, class IP, class EP>
+    inline std::size_t xconcurrent_chunk_store<EC, IP, EP>::get_pool_size() const noexcept
+    {
+        return m_pool_size;
+    }
+
+    template <class EC, class IP, class EP>
+    inline std::size_t xconcurrent_chunk_store<EC, IP, EP>::get_nb_shards() const noexcept
+    {
+        return m_shards.size();
+    }
+
+    /**
+     * Returns a handle on the chunk at the given position in the chunk grid,
+     * loading it if it is not in the pool.
+     *
+     * @param first An iterator to the first coordinate of the chunk
+     * @param last An iterator past the last coordinate of the chunk
+     */
+    template <class EC, class IP, class EP>
+    template <class I>
+    inline auto xconcurrent_chunk_store<EC, IP, EP>::get_chunk(I first, I last) -> handle_type
+    {
+        std::size_t key = detail::chunk_key(first, last);
+        auto& shard = *m_shards[key % m_shards.size()];
+        return shard.acquire(key, first, last, [this, first, last]()
+        {
+            std::string path;
+            m_index_path.index_to_path(first, last, path);
+            return path;
+        });
+    }
+
+    template <class EC, class IP, class EP>
+    template <class... Idxs>
+    inline auto xconcurrent_chunk_store<EC, IP, EP>::chunk(Idxs... idxs) -> handle_type
+    {
+        std::array<std::size_t, sizeof...(Idxs)> index = {static_cast<std::size_t>(idxs)...};
+        return get_chunk(index.cbegin(), index.cend());
+    }
+
+    /**
+     * Returns the element at the given position in the array.
+     */
+    template <class EC, class IP, class EP>
+    template <class... Idxs>
+    inline auto xconcurrent_chunk_store<EC, IP, EP>::operator()(Idxs... idxs) -> value_type
+    {
+        std::array<std::size_t, sizeof...(Idxs)> index = {static_cast<std::size_t>(idxs)...};
+        std::array<std::size_t, sizeof...(Idxs)> chunk_index;
+        for (std::size_t d = 0; d < index.size(); ++d)
+        {
+            chunk_index[d] = index[d] / m_chunk_shape[d];
+            index[d] %= m_chunk_shape[d];
+        }
+        handle_type handle = get_chunk(chunk_index.cbegin(), chunk_index.cend());
+        const chunk_type& chunk = *handle;
+        return chunk.element(index.cbegin(), index.cend());
+    }
+
+    template <class EC, class IP, class EP>
+    template <class FC, class IOC>
+    inline void xconcurrent_chunk_store<EC, IP, EP>::configure(FC& format_config, IOC& io_config)
+    {
+        for (auto& shard: m_shards)
+        {
+            shard->configure(format_config, io_config);
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    inline void xconcurrent_chunk_store<EC, IP, EP>::flush()
+    {
+        for (auto& shard: m_shards)
+        {
+            shard->flush();
+        }
+    }
+
+    template <class EC, class IP, class EP>
+    inline xchunk_pool_stats xconcurrent_chunk_store<EC, IP, EP>::pool_stats() const
+    {
+        xchunk_pool_stats stats;
+        for (const auto& shard: m_shards)
+        {
+            xchunk_pool_stats s = shard->pool_stats();
+            stats.hits += s.hits;
+            stats.misses += s.misses;
+            stats.evictions += s.evictions;
+            stats.prefetches += s.prefetches;
+        }
+        return stats;
+    }
+}
+
+#endif
@@ -1,9 +1,12 @@
 #ifndef XTENSOR_IO_FILE_ARRAY_HPP
 #define XTENSOR_IO_FILE_ARRAY_HPP
 
+#include <algorithm>
 #include <istream>
 #include <fstream>
 #include <iostream>
+#include <type_traits>
+#include <vector>
 
 #include <xtl/xtype_traits.hpp>
 
@@ -18,8 +21,14 @@ namespace xt
     {
         bool data_dirty;
         bool shape_dirty;
+        // Number of elements of the blocks in which the data is tracked,
+        // 0 if the data is tracked as a whole.
+        std::size_t block_size;
+        // Dirty blocks, if only some of the data is dirty.
+        std::vector<bool> blocks;
 
         xfile_dirty(bool is_dirty=false)
+            : block_size(0)
         {
             data_dirty = is_dirty;
             shape_dirty = is_dirty;
@@ -29,6 +38,40 @@ namespace xt
         {
             return data_dirty || shape_dirty;
         }
+
+        // Marks the block of the element i dirty.
+        void mark(std::size_t i)
+        {
+            if (block_size != 0 && (!data_dirty || !blocks.empty()))
+            {
+                std::size_t block = i / block_size;
+                if (block >= blocks.size())
+                {
+                    blocks.resize(block + 1, false);
+                }
+                blocks[block] = true;
+            }
+            data_dirty = true;
+        }
+
+        // Marks all the data dirty.
+        void mark()
+        {
+            data_dirty = true;
+            blocks.clear();
+        }
+
+        bool is_partial() const
+        {
+            return data_dirty && !blocks.empty();
+        }
+
+        void clear()
+        {
+            data_dirty = false;
+            shape_dirty = false;
+            blocks.clear();
+        }
     };
 
     template <class T>
@@ -39,7 +82,7 @@ namespace xt
         using self_type = xfile_value_reference<T>;
         using const_reference = const T&;
 
-        xfile_value_reference(T& value, xfile_dirty& dirty, bool& invalidate);
+        xfile_value_reference(T& value, xfile_dirty& dirty, bool& invalidate, std::size_t index);
         ~xfile_value_reference() = default;
 
         xfile_value_reference(const xfile_value_reference&) = default;
@@ -70,6 +113,7 @@ namespace xt
         T& m_value;
         xfile_dirty& m_dirty;
         bool& m_invalidate;
+        std::size_t m_index;
     };
 }
 
@@ -170,6 +214,15 @@ namespace xt
         template <class OE>
         self_type& operator=(const xexpression<OE>& e);
 
+        template <class OE>
+        self_type& assign_xexpression(const xexpression<OE>& e);
+
+        template <class OE>
+        self_type& computed_assign(const xexpression<OE>& e);
+
+        template <class OE, class F>
+        self_type& scalar_computed_assign(const OE& e, F&& f);
+
         size_type size() const noexcept;
         const shape_type& shape() const noexcept;
         layout_type layout() const noexcept;
@@ -233,7 +286,8 @@ namespace xt
         load_simd(size_type i) const;
 
         const std::string& path() const noexcept;
-        void set_path(const std::string& path);
+        void set_path(const std::string& path, bool may_exist = true);
+        bool file_may_exist() const noexcept;
 
         template <class FC, class IOC>
         void configure(FC& format_config, IOC& io_config);
@@ -243,8 +297,17 @@ namespace xt
 
         void flush();
 
+        template <class Q>
+        void flush_async(Q& queue);
+
     private:
 
+        template <class F>
+        self_type& assign_storage(F&& assign);
+
+        void set_synced(bool synced);
+        bool holds_init_value();
+
         E m_storage;
         xfile_dirty m_dirty;
         bool m_invalidate;
@@ -253,6 +316,11 @@ namespace xt
         xfile_mode m_file_mode;
         value_type m_init_value;
         bool m_init;
+        std::size_t m_dirty_block_size;
+        bool m_synced;
+        // The storage holds only the init value, valid while the data
+        // is not dirty.
+        bool m_fill_only;
     };
 
     template <class T,
@@ -267,10 +335,11 @@ namespace xt
      ****************************************/
 
     template <class T>
-    inline xfile_value_reference<T>::xfile_value_reference(T& value, xfile_dirty& dirty, bool& invalidate)
+    inline xfile_value_reference<T>::xfile_value_reference(T& value, xfile_dirty& dirty, bool& invalidate, std::size_t index)
         : m_value(value)
         , m_dirty(dirty)
         , m_invalidate(invalidate)
+        , m_index(index)
     {
     }
 
@@ -281,7 +350,7 @@ namespace xt
         if (v != m_value || m_invalidate)
         {
             m_value = v;
-            m_dirty.data_dirty = true;
+            m_dirty.mark(m_index);
             m_invalidate = false;
         }
         return *this;
@@ -294,7 +363,7 @@ namespace xt
         if (v != T(0) || m_invalidate)
         {
             m_value += v;
-            m_dirty.data_dirty = true;
+            m_dirty.mark(m_index);
             m_invalidate = false;
         }
         return *this;
@@ -307,7 +376,7 @@ namespace xt
         if (v != T(0) || m_invalidate)
         {
             m_value -= v;
-            m_dirty.data_dirty = true;
+            m_dirty.mark(m_index);
             m_invalidate = false;
         }
         return *this;
@@ -320,7 +389,7 @@ namespace xt
         if (v != T(1) || m_invalidate)
         {
             m_value *= v;
-            m_dirty.data_dirty = true;
+            m_dirty.mark(m_index);
             m_invalidate = false;
         }
         return *this;
@@ -333,7 +402,7 @@ namespace xt
         if (v != T(1) || m_invalidate)
         {
             m_value /= v;
-            m_dirty.data_dirty = true;
+            m_dirty.mark(m_index);
             m_invalidate = false;
         }
         return *this;
@@ -379,6 +448,77 @@ namespace xt
 
         template <class E>
         using file_helper = file_helper_impl<E, try_path>;
+
+        template <class IOH, class ET>
+        using try_handler_read = decltype(std::declval<IOH&>().try_read(std::declval<ET&>(), std::declval<const std::string&>()));
+
+        // Reads a file which may not exist. The handlers providing try_read
+        // report a missing file without throwing, the others throw.
+        template <class IOH, class ET, class = void>
+        struct read_helper
+        {
+            static bool try_read(IOH& handler, ET& array, const std::string& path)
+            {
+                handler.read(array, path);
+                return true;
+            }
+        };
+
+        template <class IOH, class ET>
+        struct read_helper<IOH, ET, void_t<try_handler_read<IOH, ET>>>
+        {
+            static bool try_read(IOH& handler, ET& array, const std::string& path)
+            {
+                return handler.try_read(array, path);
+            }
+        };
+
+        template <class IOH>
+        using try_handler_remove = decltype(std::declval<IOH&>().remove(std::declval<const std::string&>()));
+
+        // Removes the file of a chunk holding only the fill value. The
+        // handlers which cannot remove a file write it instead.
+        template <class IOH, class = void>
+        struct remove_helper : std::false_type
+        {
+            static bool remove(IOH&, const std::string&)
+            {
+                return false;
+            }
+        };
+
+        template <class IOH>
+        struct remove_helper<IOH, void_t<try_handler_remove<IOH>>> : std::true_type
+        {
+            static bool remove(IOH& handler, const std::string& path)
+            {
+                handler.remove(path);
+                return true;
+            }
+        };
+
+        template <class FC>
+        using try_dirty_block_size = decltype(std::declval<FC>().dirty_block_size);
+
+        // Size in bytes of the blocks in which the format can write the
+        // dirty data, 0 if it always writes the whole data.
+        template <class FC, class = void>
+        struct dirty_block_helper
+        {
+            static std::size_t block_size(const FC&)
+            {
+                return 0;
+            }
+        };
+
+        template <class FC>
+        struct dirty_block_helper<FC, void_t<try_dirty_block_size<FC>>>
+        {
+            static std::size_t block_size(const FC& format_config)
+            {
+                return format_config.dirty_block_size;
+            }
+        };
     }
 
     template<class E>
@@ -396,6 +536,9 @@ namespace xt
         , m_io_handler()
         , m_file_mode(file_mode)
         , m_init(false)
+        , m_dirty_block_size(0)
+        , m_synced(false)
+        , m_fill_only(false)
     {
         set_path(path);
     }
@@ -409,6 +552,9 @@ namespace xt
         , m_io_handler()
         , m_file_mode(file_mode)
         , m_init(false)
+        , m_dirty_block_size(0)
+        , m_synced(false)
+        , m_fill_only(false)
     {
         m_io_handler.configure_io(io_config);
         set_path(path);
@@ -423,6 +569,9 @@ namespace xt
         , m_file_mode(file_mode)
         , m_init_value(init_value)
         , m_init(true)
+        , m_dirty_block_size(0)
+        , m_synced(false)
+        , m_fill_only(false)
     {
         set_path(path);
     }
@@ -443,6 +592,9 @@ namespace xt
         , m_path(detail::file_helper<E>::path(e))
         , m_file_mode(xfile_mode::init)
         , m_init(false)
+        , m_dirty_block_size(0)
+        , m_synced(false)
+        , m_fill_only(false)
     {
     }
 
@@ -456,14 +608,59 @@ namespace xt
         , m_path(path)
         , m_file_mode(xfile_mode::init)
         , m_init(false)
+        , m_dirty_block_size(0)
+        , m_synced(false)
+        , m_fill_only(false)
     {
     }
 
+    /**
+     * The assignments of expressions are performed on the underlying
+     * storage, so that they use the linear and SIMD assignment of the
+     * storage type, and mark the array dirty once instead of for each
+     * element.
+     */
     template <class E, class IOH>
     template <class OE>
     inline auto xfile_array_container<E, IOH>::operator=(const xexpression<OE>& e) -> self_type&
     {
-        return semantic_base::operator=(e);
+        return assign_storage([this, &e]() { m_storage = e; });
+    }
+
+    template <class E, class IOH>
+    template <class OE>
+    inline auto xfile_array_container<E, IOH>::assign_xexpression(const xexpression<OE>& e) -> self_type&
+    {
+        return assign_storage([this, &e]() { xt::assign_xexpression(m_storage, e); });
+    }
+
+    template <class E, class IOH>
+    template <class OE>
+    inline auto xfile_array_container<E, IOH>::computed_assign(const xexpression<OE>& e) -> self_type&
+    {
+        return assign_storage([this, &e]() { xt::computed_assign(m_storage, e); });
+    }
+
+    template <class E, class IOH>
+    template <class OE, class F>
+    inline auto xfile_array_container<E, IOH>::scalar_computed_assign(const OE& e, F&& f) -> self_type&
+    {
+        return assign_storage([this, &e, &f]() { xt::scalar_computed_assign(m_storage, e, std::forward<F>(f)); });
+    }
+
+    template <class E, class IOH>
+    template <class F>
+    inline auto xfile_array_container<E, IOH>::assign_storage(F&& assign) -> self_type&
+    {
+        shape_type shape = m_storage.shape();
+        assign();
+        if (!std::equal(shape.cbegin(), shape.cend(), m_storage.shape().cbegin(), m_storage.shape().cend()))
+        {
+            m_dirty.shape_dirty = true;
+        }
+        m_dirty.mark();
+        m_invalidate = false;
+        return *this;
     }
 
     template <class E, class IOH>
@@ -496,6 +693,7 @@ namespace xt
     {
         m_storage.resize(std::forward<S>(shape), force);
         m_dirty.shape_dirty = true;
+        m_fill_only = false;
     }
 
     template <class E, class IOH>
@@ -504,6 +702,7 @@ namespace xt
     {
         m_storage.resize(std::forward<S>(shape), l);
         m_dirty.shape_dirty = true;
+        m_fill_only = false;
     }
 
     template <class E, class IOH>
@@ -512,6 +711,7 @@ namespace xt
     {
         m_storage.resize(std::forward<S>(shape), strides);
         m_dirty.shape_dirty = true;
+        m_fill_only = false;
     }
 
     template <class E, class IOH>
@@ -536,7 +736,8 @@ namespace xt
     template <class... Idxs>
     inline auto xfile_array_container<E, IOH>::operator()(Idxs... idxs) -> reference
     {
-        return reference(m_storage(idxs...), m_dirty, m_invalidate);
+        value_type& value = m_storage(idxs...);
+        return reference(value, m_dirty, m_invalidate, static_cast<size_type>(&value - m_storage.data()));
     }
 
     template <class E, class IOH>
@@ -550,7 +751,8 @@ namespace xt
     template <class It>
     inline auto xfile_array_container<E, IOH>::element(It first, It last) -> reference
     {
-        return reference(m_storage.element(first, last), m_dirty, m_invalidate);
+        value_type& value = m_storage.element(first, last);
+        return reference(value, m_dirty, m_invalidate, static_cast<size_type>(&value - m_storage.data()));
     }
 
     template <class E, class IOH>
@@ -563,6 +765,8 @@ namespace xt
     template <class E, class IOH>
     inline auto xfile_array_container<E, IOH>::storage() noexcept -> storage_type&
     {
+        // the storage may be modified without being marked dirty
+        m_fill_only = false;
         return m_storage;
     }
 
@@ -621,7 +825,7 @@ namespace xt
     template <class E, class IOH>
     inline auto xfile_array_container<E, IOH>::data_element(size_type i) -> reference
     {
-        return reference(m_storage.data_element(i), m_dirty, m_invalidate);
+        return reference(m_storage.data_element(i), m_dirty, m_invalidate, i);
     }
 
     template <class E, class IOH>
@@ -634,8 +838,9 @@ namespace xt
     template <class align, class simd>
     inline void xfile_array_container<E, IOH>::store_simd(size_type i, const simd& e)
     {
-        m_storage.store_simd(i, e);
-        m_dirty = true;
+        m_storage.template store_simd<align>(i, e);
+        m_dirty.mark();
+        m_invalidate = false;
     }
 
     template <class E, class IOH>
@@ -643,7 +848,7 @@ namespace xt
     inline auto xfile_array_container<E, IOH>::load_simd(size_type i) const
         -> container_simd_return_type_t<storage_type, value_type, requested_type>
     {
-        return m_storage.load_simd(i);
+        return m_storage.template load_simd<align, requested_type, N>(i);
     }
 
     template <class E, class IOH>
@@ -657,6 +862,9 @@ namespace xt
     inline void xfile_array_container<E, IOH>::configure(FC& format_config, IOC& io_config)
     {
         m_io_handler.configure(format_config, io_config);
+        std::size_t block_bytes = detail::dirty_block_helper<FC>::block_size(format_config);
+        m_dirty_block_size = block_bytes == 0 ? 0 : std::max<std::size_t>(block_bytes / sizeof(value_type), 1);
+        set_synced(m_synced);
     }
 
     template <class E, class IOH>
@@ -666,31 +874,61 @@ namespace xt
         m_io_handler.configure_io(io_config);
     }
 
+    /**
+     * Sets the path of the file of the array, after writing the array to its
+     * previous file if it is dirty.
+     *
+     * @param path The path of the file
+     * @param may_exist false if the file is known not to exist, e.g. from the
+     *        index of a chunk store, so that it is not accessed in the
+     *        ``init_on_fail`` mode
+     */
     template <class E, class IOH>
-    inline void xfile_array_container<E, IOH>::set_path(const std::string& path)
+    inline void xfile_array_container<E, IOH>::set_path(const std::string& path, bool may_exist)
     {
         if (path != m_path)
         {
             // maybe write to old file
             flush();
             m_path = path;
-            if (m_file_mode != xfile_mode::init)
+            set_synced(false);
+            if (m_file_mode == xfile_mode::load)
             {
                 // read new file
+                m_fill_only = false;
+                m_io_handler.read(m_storage, path);
+                set_synced(true);
+            }
+            else if (m_file_mode == xfile_mode::init_on_fail)
+            {
+                // a missing file is expected, and not reported by an
+                // exception if the handler can avoid it
+                bool found = false;
+                bool failed = false;
                 try
                 {
-                    m_io_handler.read(m_storage, path);
+                    found = may_exist && detail::read_helper<IOH, E>::try_read(m_io_handler, m_storage, path);
                 }
-                catch (const std::runtime_error& e)
+                catch (const std::runtime_error&)
+                {
+                    failed = true;
+                }
+                if (found)
+                {
+                    m_fill_only = false;
+                    set_synced(true);
+                }
+                else
                 {
-                    if (m_file_mode == xfile_mode::load)
-                    {
-                        throw e;
-                    }
-                    // m_file_mode == xfile_mode::init_on_fail
                     if (m_init)
                     {
-                        std::fill(m_storage.begin(), m_storage.end(), m_init_value);
+                        // a chunk following another missing one keeps
+                        // its content, unless the reading has altered it
+                        if (!m_fill_only || failed)
+                        {
+                            std::fill(m_storage.begin(), m_storage.end(), m_init_value);
+                            m_fill_only = true;
+                        }
                     }
                     else
                     {
@@ -701,13 +939,112 @@ namespace xt
         }
     }
 
+    /**
+     * Returns false if the file of the array is known not to exist: it was
+     * missing when the path was set, or removed by the last flush, and the
+     * data has not been modified since.
+     */
+    template <class E, class IOH>
+    inline bool xfile_array_container<E, IOH>::file_may_exist() const noexcept
+    {
+        return m_synced || m_dirty.data_dirty || m_file_mode != xfile_mode::init_on_fail;
+    }
+
+    /**
+     * Writes the array to its file if it is dirty. When the array has an init
+     * value and holds only this value, its file is removed instead, if the IO
+     * handler supports it, so that it is initialized again on the next read.
+     */
     template <class E, class IOH>
     inline void xfile_array_container<E, IOH>::flush()
     {
         if (m_dirty)
         {
+            if (holds_init_value() && detail::remove_helper<IOH>::remove(m_io_handler, m_path))
+            {
+                m_dirty.clear();
+                set_synced(false);
+                return;
+            }
             m_io_handler.write(m_storage, m_path, m_dirty);
-            m_dirty = false;
+            bool data_written = m_dirty.data_dirty;
+            m_dirty.clear();
+            set_synced(m_synced || data_written);
+        }
+    }
+
+    template <class E, class IOH>
+    inline bool xfile_array_container<E, IOH>::holds_init_value()
+    {
+        if (!m_init)
+        {
+            return false;
+        }
+        if (m_dirty.data_dirty)
+        {
+            // a NaN init value matches NaN elements
+            bool nan_init = m_init_value != m_init_value;
+            auto is_init = [this, nan_init](const value_type& v)
+            {
+                return v == m_init_value || (nan_init && v != v);
+            };
+            m_fill_only = std::all_of(m_storage.linear_cbegin(), m_storage.linear_cend(), is_init);
+        }
+        return m_fill_only;
+    }
+
+    /**
+     * The dirty data is tracked in blocks only while the storage holds the
+     * content of the file, so that the blocks which are not dirty need not
+     * be written.
+     */
+    template <class E, class IOH>
+    inline void xfile_array_container<E, IOH>::set_synced(bool synced)
+    {
+        m_synced = synced;
+        std::size_t block_size = synced ? m_dirty_block_size : 0;
+        if (block_size != m_dirty.block_size)
+        {
+            if (m_dirty.data_dirty)
+            {
+                // the blocks already marked do not apply anymore
+                m_dirty.mark();
+            }
+            m_dirty.block_size = block_size;
+        }
+    }
+
+    /**
+     * Hands the pending write over to a write-back queue.
+     * The queued task owns a copy of the data, so that the array can be
+     * reused as soon as this function returns. The queue may block in
+     * ``push`` until it has room for the task.
+     *
+     * @param queue An object providing ``push(path, task)``
+     */
+    template <class E, class IOH>
+    template <class Q>
+    inline void xfile_array_container<E, IOH>::flush_async(Q& queue)
+    {
+        if (m_dirty)
+        {
+            if (holds_init_value() && detail::remove_helper<IOH>::value)
+            {
+                queue.push(m_path, [io_handler = m_io_handler, path = m_path]() mutable
+                {
+                    detail::remove_helper<IOH>::remove(io_handler, path);
+                });
+                m_dirty.clear();
+                set_synced(false);
+                return;
+            }
+            queue.push(m_path, [storage = m_storage, io_handler = m_io_handler, path = m_path, dirty = m_dirty]() mutable
+            {
+                io_handler.write(storage, path, dirty);
+            });
+            bool data_written = m_dirty.data_dirty;
+            m_dirty.clear();
+            set_synced(m_synced || data_written);
         }
     }
 }
@@ -22,25 +22,29 @@ namespace xt
     class xio_aws_handler
     {
     public:
+        using format_config = C;
         using io_config = xio_aws_config;
 
         xio_aws_handler();
 
         template <class E>
-        void write(const xexpression<E>& expression, const std::string& path, xfile_dirty dirty);
+        void write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty);
 
         template <class ET>
         void read(ET& array, const std::string& path);
 
+        template <class ET>
+        bool try_read(ET& array, const std::string& path);
+
         void configure(const C& format_config, const xio_aws_config& io_config);
         void configure_io(const xio_aws_config& io_config);
 
     private:
         template <class E>
-        void write(const xexpression<E>& expression, const char* path, xfile_dirty dirty);
+        void write(const xexpression<E>& expression, const char* path, const xfile_dirty& dirty);
 
         template <class ET>
-        void read(ET& array, const char* path);
+        bool try_read(ET& array, const char* path);
 
         C m_format_config;
         Aws::S3::S3Client m_client;
@@ -54,14 +58,14 @@ namespace xt
 
     template <class C>
     template <class E>
-    inline void xio_aws_handler<C>::write(const xexpression<E>& expression, const std::string& path, xfile_dirty dirty)
+    inline void xio_aws_handler<C>::write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty)
     {
         write(expression, path.c_str(), dirty);
     }
 
     template <class C>
     template <class E>
-    inline void xio_aws_handler<C>::write(const xexpression<E>& expression, const char* path, xfile_dirty dirty)
+    inline void xio_aws_handler<C>::write(const xexpression<E>& expression, const char* path, const xfile_dirty& dirty)
     {
         if (m_format_config.will_dump(dirty))
         {
@@ -90,12 +94,22 @@ namespace xt
     template <class ET>
     inline void xio_aws_handler<C>::read(ET& array, const std::string& path)
     {
-        read(array, path.c_str());
+        if (!try_read(array, path.c_str()))
+        {
+            XTENSOR_THROW(std::runtime_error, "Error: GetObject: no such key " + path);
+        }
     }
 
     template <class C>
     template <class ET>
-    inline void xio_aws_handler<C>::read(ET& array, const char* path)
+    inline bool xio_aws_handler<C>::try_read(ET& array, const std::string& path)
+    {
+        return try_read(array, path.c_str());
+    }
+
+    template <class C>
+    template <class ET>
+    inline bool xio_aws_handler<C>::try_read(ET& array, const char* path)
     {
         Aws::String path2 = path;
         Aws::S3::Model::GetObjectRequest request;
@@ -107,12 +121,17 @@ namespace xt
         if (!outcome.IsSuccess())
         {
             auto err = outcome.GetError();
+            if (err.GetErrorType() == Aws::S3::S3Errors::NO_SUCH_KEY || err.GetErrorType() == Aws::S3::S3Errors::RESOURCE_NOT_FOUND)
+            {
+                return false;
+            }
             XTENSOR_THROW(std::runtime_error, std::string("Error: GetObject: ") + err.GetExceptionName().c_str() + ": " + err.GetMessage().c_str());
         }
 
         auto& reader = outcome.GetResultWithOwnership().GetBody();
         auto s = xistream_wrapper(reader);
         load_file<ET>(s, array, m_format_config);
+        return true;
     }
 
     template <class C>
@@ -10,11 +10,15 @@
 #ifndef XTENSOR_IO_BINARY_HPP
 #define XTENSOR_IO_BINARY_HPP
 
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <system_error>
 
 #include "xtensor/containers/xadapt.hpp"
 #include "xtensor-io.hpp"
 #include "xfile_array.hpp"
+#include "xio_scratch_arena.hpp"
 #include "xio_stream_wrapper.hpp"
 
 namespace xt
@@ -24,7 +28,8 @@ namespace xt
         template <typename T, class I>
         inline xt::svector<T> load_bin(I& stream, bool as_big_endian)
         {
-            std::string buffer;
+            auto scratch = scratch_arena().acquire();
+            std::string& buffer = scratch.str();
             stream.read_all(buffer);
             std::size_t uncompressed_size = buffer.size() / sizeof(T);
             xt::svector<T> uncompressed_buffer(uncompressed_size);
@@ -36,29 +41,98 @@ namespace xt
             return uncompressed_buffer;
         }
 
+        template <typename T, class I>
+        inline void load_bin_into(I& stream, T* data, std::size_t size, bool as_big_endian)
+        {
+            std::streamsize expected_size = static_cast<std::streamsize>(size * sizeof(T));
+            stream.read(reinterpret_cast<char*>(data), expected_size);
+            bool size_mismatch = stream.gcount() != expected_size;
+            if (!size_mismatch)
+            {
+                // the file must not hold more data
+                char extra;
+                size_mismatch = stream.read(&extra, 1).gcount() != 0;
+            }
+            if (size_mismatch)
+            {
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            }
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+            {
+                swap_endianness(data, size);
+            }
+        }
+
+        // Fills e, in row-major order, with the elements read block by
+        // block from the stream, for the expressions without contiguous
+        // storage.
+        template <class I, class E>
+        inline void load_bin_into(I& stream, E& e, bool as_big_endian)
+        {
+            using value_type = typename E::value_type;
+            std::size_t size = e.size();
+            std::size_t block_size = std::max<std::size_t>(XTENSOR_IO_SWAP_BLOCK_SIZE / sizeof(value_type), 1);
+            xscratch_arena::buffer block = scratch_arena().acquire(std::min(block_size, size) * sizeof(value_type));
+            value_type* buffer = reinterpret_cast<value_type*>(block.data());
+            auto it = e.template begin<XTENSOR_DEFAULT_LAYOUT>();
+            for (std::size_t i = 0; i < size; i += block_size)
+            {
+                std::size_t n = std::min(block_size, size - i);
+                std::streamsize expected_size = static_cast<std::streamsize>(n * sizeof(value_type));
+                if (stream.read(block.data(), expected_size).gcount() != expected_size)
+                {
+                    XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+                }
+                if ((sizeof(value_type) > 1) && (as_big_endian != is_big_endian()))
+                {
+                    swap_endianness(buffer, n);
+                }
+                it = std::copy(buffer, buffer + n, it);
+            }
+            char extra;
+            if (stream.read(&extra, 1).gcount() != 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            }
+        }
+
         template <class O, class E>
         inline void dump_bin(O& stream, const xexpression<E>& e, bool as_big_endian)
         {
             using value_type = typename E::value_type;
             const E& ex = e.derived_cast();
-            auto&& eval_ex = eval(ex);
-            auto shape = eval_ex.shape();
-            std::size_t size = compute_size(shape);
-            std::size_t uncompressed_size = size * sizeof(value_type);
-            const char* uncompressed_buffer;
-            xt::svector<value_type> swapped_buffer;
-            if ((sizeof(value_type) > 1) && (as_big_endian != is_big_endian()))
+            std::size_t size = compute_size(ex.shape());
+            bool swap = (sizeof(value_type) > 1) && (as_big_endian != is_big_endian());
+            auto write_block = [&stream](const char* buffer, std::size_t nbytes, bool)
             {
-                swapped_buffer.resize(size);
-                std::copy(eval_ex.data(), eval_ex.data() + size, swapped_buffer.begin());
-                swap_endianness(swapped_buffer);
-                uncompressed_buffer = reinterpret_cast<const char*>(swapped_buffer.data());
+                stream.write(buffer, static_cast<std::streamsize>(nbytes));
+            };
+            if (const value_type* data = dump_source(ex))
+            {
+                for_each_swapped_block(data, size, swap, write_block);
             }
             else
             {
-                uncompressed_buffer = reinterpret_cast<const char*>(eval_ex.data());
+                // views and lazy expressions are computed block by block
+                // rather than evaluated as a whole
+                std::size_t block_size = std::max<std::size_t>(XTENSOR_IO_SWAP_BLOCK_SIZE / sizeof(value_type), 1);
+                xscratch_arena::buffer block = scratch_arena().acquire(std::min(block_size, size) * sizeof(value_type));
+                value_type* buffer = reinterpret_cast<value_type*>(block.data());
+                auto it = ex.template begin<XTENSOR_DEFAULT_LAYOUT>();
+                for (std::size_t i = 0; i < size; i += block_size)
+                {
+                    std::size_t n = std::min(block_size, size - i);
+                    for (std::size_t j = 0; j < n; ++j, ++it)
+                    {
+                        buffer[j] = *it;
+                    }
+                    if (swap)
+                    {
+                        swap_endianness(buffer, n);
+                    }
+                    write_block(block.data(), n * sizeof(value_type), i + n == size);
+                }
             }
-            stream.write(uncompressed_buffer, uncompressed_size);
             stream.flush();
         }
     }  // namespace detail
@@ -165,16 +239,60 @@ namespace xt
         return load_bin<T, L>(filename.c_str(), as_big_endian);
     }
 
+    /**
+     * Loads a binary file into an existing expression
+     *
+     * The elements are read block by block and assigned in row-major
+     * order, so that a view, e.g. of an xfile_array, is filled without
+     * a temporary array.
+     *
+     * @param stream An input stream from which to load the file
+     * @param e the destination xexpression, whose size must match the file
+     */
+    template <class E, class I>
+    inline void load_bin(I& stream, xexpression<E>& e, bool as_big_endian=is_big_endian())
+    {
+        detail::load_bin_into(stream, e.derived_cast(), as_big_endian);
+    }
+
+    /**
+     * Loads a binary file into an existing expression
+     *
+     * @param filename The filename or path to the file
+     * @param e the destination xexpression, whose size must match the file
+     */
+    template <class E>
+    inline void load_bin(const char* filename, xexpression<E>& e, bool as_big_endian=is_big_endian())
+    {
+        std::ifstream stream(filename, std::ifstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("load_bin: failed to open file ") + filename);
+        }
+        auto s = xistream_wrapper(stream);
+        detail::load_bin_into(s, e.derived_cast(), as_big_endian);
+    }
+
+    template <class E>
+    inline void load_bin(const std::string& filename, xexpression<E>& e, bool as_big_endian=is_big_endian())
+    {
+        load_bin(filename.c_str(), e, as_big_endian);
+    }
+
     struct xio_binary_config
     {
         std::string name;
         std::string version;
         bool big_endian;
+        // Size in bytes of the blocks in which the dirty data of a file
+        // array is tracked and rewritten, 0 to always rewrite the file.
+        std::size_t dirty_block_size;
 
         xio_binary_config()
             : name("binary")
             , version("1.0")
             , big_endian(is_big_endian())
+            , dirty_block_size(0)
         {
         }
 
@@ -188,7 +306,7 @@ namespace xt
         {
         }
 
-        bool will_dump(xfile_dirty dirty)
+        bool will_dump(const xfile_dirty& dirty)
         {
             return dirty.data_dirty;
         }
@@ -199,6 +317,19 @@ namespace xt
     {
         E& ex = e.derived_cast();
         auto shape = ex.shape();
+        auto* data = detail::decode_destination(ex);
+        if (!shape.empty() && data != nullptr)
+        {
+            // the array already has the expected size
+            detail::load_bin_into(stream, data, ex.size(), config.big_endian);
+            return;
+        }
+        if constexpr (!detail::is_resizable<E>::value)
+        {
+            // a view is filled in place
+            detail::load_bin_into(stream, ex, config.big_endian);
+            return;
+        }
         ex = load_bin<typename E::value_type>(stream, config.big_endian);
         if (!shape.empty())
         {
@@ -215,6 +346,66 @@ namespace xt
     {
         dump_bin(stream, e, config.big_endian);
     }
+
+    /**
+     * Rewrites the dirty blocks of an existing binary file in place
+     *
+     * @param path The path of the file
+     * @param e the xexpression holding the data of the whole file
+     * @param dirty the dirty blocks of the data
+     * @return false if the file must be rewritten as a whole, i.e. if it
+     *         does not have the size of the data or if the data is not
+     *         contiguous
+     */
+    template <class E>
+    bool dump_file_blocks(const std::string& path, const xexpression<E>& e, const xfile_dirty& dirty, const xio_binary_config& config)
+    {
+        using value_type = typename E::value_type;
+        const E& ex = e.derived_cast();
+        const value_type* data = detail::dump_source(ex);
+        std::size_t size = compute_size(ex.shape());
+        std::error_code ec;
+        if (!dirty.is_partial() || data == nullptr || std::filesystem::file_size(path, ec) != size * sizeof(value_type) || ec)
+        {
+            return false;
+        }
+        std::fstream file(path, std::fstream::in | std::fstream::out | std::fstream::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        bool swap = (sizeof(value_type) > 1) && (config.big_endian != is_big_endian());
+        std::size_t nb_blocks = dirty.blocks.size();
+        std::size_t block = 0;
+        while (block < nb_blocks)
+        {
+            if (!dirty.blocks[block])
+            {
+                ++block;
+                continue;
+            }
+            // consecutive dirty blocks are written at once
+            std::size_t last = block;
+            while (last < nb_blocks && dirty.blocks[last])
+            {
+                ++last;
+            }
+            std::size_t first_element = std::min(block * dirty.block_size, size);
+            std::size_t last_element = std::min(last * dirty.block_size, size);
+            file.seekp(static_cast<std::streamoff>(first_element * sizeof(value_type)));
+            detail::for_each_swapped_block(data + first_element, last_element - first_element, swap, [&file](const char* buffer, std::size_t nbytes, bool)
+            {
+                file.write(buffer, static_cast<std::streamsize>(nbytes));
+            });
+            block = last;
+        }
+        file.flush();
+        if (!file)
+        {
+            XTENSOR_THROW(std::runtime_error, "write: failed to write file " + path);
+        }
+        return true;
+    }
 }  // namespace xt
 
 #endif
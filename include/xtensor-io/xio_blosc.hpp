@@ -10,12 +10,15 @@
 #ifndef XTENSOR_IO_BLOSC_HPP
 #define XTENSOR_IO_BLOSC_HPP
 
+#include <cstring>
 #include <fstream>
+#include <mutex>
 
 #include "xtensor/containers/xadapt.hpp"
 #include "xtensor-io.hpp"
 #include "xfile_array.hpp"
 #include "blosc.h"
+#include "xio_scratch_arena.hpp"
 #include "xio_stream_wrapper.hpp"
 
 namespace xt
@@ -24,19 +27,16 @@ namespace xt
     {
         inline void init_blosc()
         {
-            static bool initialized = false;
-            if (!initialized)
-            {
-                blosc_init();
-                initialized = true;
-            }
+            static std::once_flag initialized;
+            std::call_once(initialized, blosc_init);
         }
 
         template <typename T, class I>
-        inline xt::svector<T> load_blosc(I& stream, bool as_big_endian)
+        inline xt::svector<T> load_blosc(I& stream, bool as_big_endian, int nthreads = 1)
         {
             init_blosc();
-            std::string compressed_buffer;
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
             stream.read_all(compressed_buffer);
             auto compressed_size = compressed_buffer.size();
             std::size_t uncompressed_size = 0;
@@ -49,7 +49,7 @@ namespace xt
             if (uncompressed_size % sizeof(T) != size_t(0))
                 ubuf_size += size_t(1);
             xt::svector<T> uncompressed_buffer(ubuf_size);
-            res = blosc_decompress(compressed_buffer.data(), uncompressed_buffer.data(), uncompressed_size);
+            res = blosc_decompress_ctx(compressed_buffer.data(), uncompressed_buffer.data(), uncompressed_size, nthreads);
             if (res <= 0)
             {
                 XTENSOR_THROW(std::runtime_error, "Blosc: unsupported file format version");
@@ -61,8 +61,37 @@ namespace xt
             return uncompressed_buffer;
         }
 
+        template <typename T, class I>
+        inline void load_blosc_into(I& stream, T* data, std::size_t size, bool as_big_endian, int nthreads = 1)
+        {
+            init_blosc();
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            auto compressed_size = compressed_buffer.size();
+            std::size_t uncompressed_size = 0;
+            int res = blosc_cbuffer_validate(compressed_buffer.data(), compressed_size, &uncompressed_size);
+            if (res == -1)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc: unsupported file format version");
+            }
+            if (uncompressed_size != size * sizeof(T))
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc: expected size (" + std::to_string(size) + ") and actual size (" + std::to_string(uncompressed_size / sizeof(T)) + ") mismatch");
+            }
+            res = blosc_decompress_ctx(compressed_buffer.data(), data, uncompressed_size, nthreads);
+            if (res <= 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc: unsupported file format version");
+            }
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+            {
+                swap_endianness(data, size);
+            }
+        }
+
         template <class O, class E>
-        inline void dump_blosc(O& stream, const xexpression<E>& e, bool as_big_endian, int clevel, int shuffle, const char* cname, std::size_t blocksize)
+        inline void dump_blosc(O& stream, const xexpression<E>& e, bool as_big_endian, int clevel, int shuffle, const char* cname, std::size_t blocksize, int nthreads = 1)
         {
             init_blosc();
             using value_type = typename E::value_type;
@@ -72,27 +101,27 @@ namespace xt
             std::size_t size = compute_size(shape);
             std::size_t uncompressed_size = size * sizeof(value_type);
             const char* uncompressed_buffer;
-            xt::svector<value_type> swapped_buffer;
+            xscratch_arena::buffer swapped_buffer;
             if ((sizeof(value_type) > 1) && (as_big_endian != is_big_endian()))
             {
-                swapped_buffer.resize(size);
-                std::copy(eval_ex.data(), eval_ex.data() + size, swapped_buffer.begin());
-                swap_endianness(swapped_buffer);
-                uncompressed_buffer = reinterpret_cast<const char*>(swapped_buffer.data());
+                swapped_buffer = scratch_arena().acquire(uncompressed_size);
+                copy_swap_endianness(eval_ex.data(), size, reinterpret_cast<value_type*>(swapped_buffer.data()));
+                uncompressed_buffer = swapped_buffer.data();
             }
             else
             {
                 uncompressed_buffer = reinterpret_cast<const char*>(eval_ex.data());
             }
-            std::size_t max_compressed_size = uncompressed_size + BLOSC_MAX_OVERHEAD;
-            std::allocator<char> char_allocator;
-            char* compressed_buffer = char_allocator.allocate(max_compressed_size);
-            blosc_set_blocksize(blocksize);
-            if (blosc_set_compressor(cname) == -1)
+            if (blosc_compname_to_compcode(cname) == -1)
             {
                 XTENSOR_THROW(std::runtime_error, "Blosc: compressor not supported (" + std::string(cname) + ")");
             }
-            int true_compressed_size = blosc_compress(clevel, shuffle, sizeof(value_type), uncompressed_size, uncompressed_buffer, compressed_buffer, max_compressed_size);
+            std::size_t max_compressed_size = uncompressed_size + BLOSC_MAX_OVERHEAD;
+            auto compressed_scratch = scratch_arena().acquire(max_compressed_size);
+            char* compressed_buffer = compressed_scratch.data();
+            // the _ctx functions don't touch the global state of blosc and can
+            // be called concurrently
+            int true_compressed_size = blosc_compress_ctx(clevel, shuffle, sizeof(value_type), uncompressed_size, uncompressed_buffer, compressed_buffer, max_compressed_size, cname, blocksize, nthreads);
             if (true_compressed_size == 0)
             {
                 XTENSOR_THROW(std::runtime_error, "Blosc: buffer is uncompressible");
@@ -103,7 +132,6 @@ namespace xt
             }
             stream.write(compressed_buffer, std::streamsize(true_compressed_size));
             stream.flush();
-            char_allocator.deallocate(compressed_buffer, max_compressed_size);
         }
     }  // namespace detail
 
@@ -114,16 +142,16 @@ namespace xt
      * @param e the xexpression
      */
     template <typename E, class O>
-    inline void dump_blosc(O& stream, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0)
+    inline void dump_blosc(O& stream, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0, int nthreads=1)
     {
-        detail::dump_blosc(stream, e, as_big_endian, clevel, shuffle, cname, blocksize);
+        detail::dump_blosc(stream, e, as_big_endian, clevel, shuffle, cname, blocksize, nthreads);
     }
 
     template <typename E>
-    inline void dump_blosc(std::ostream& stream, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0)
+    inline void dump_blosc(std::ostream& stream, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0, int nthreads=1)
     {
         auto s = xostream_wrapper(stream);
-        detail::dump_blosc(s, e, as_big_endian, clevel, shuffle, cname, blocksize);
+        detail::dump_blosc(s, e, as_big_endian, clevel, shuffle, cname, blocksize, nthreads);
     }
 
     /**
@@ -133,7 +161,7 @@ namespace xt
      * @param e the xexpression
      */
     template <typename E>
-    inline void dump_blosc(const char* filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0)
+    inline void dump_blosc(const char* filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0, int nthreads=1)
     {
         std::ofstream stream(filename, std::ofstream::binary);
         if (!stream.is_open())
@@ -141,13 +169,13 @@ namespace xt
             XTENSOR_THROW(std::runtime_error, std::string("Blosc: failed to open file ") + filename);
         }
         auto s = xostream_wrapper(stream);
-        detail::dump_blosc(s, e, as_big_endian, clevel, shuffle, cname, blocksize);
+        detail::dump_blosc(s, e, as_big_endian, clevel, shuffle, cname, blocksize, nthreads);
     }
 
     template <typename E>
-    inline void dump_blosc(const std::string& filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0)
+    inline void dump_blosc(const std::string& filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0, int nthreads=1)
     {
-        dump_blosc<E>(filename.c_str(), e, as_big_endian, clevel, shuffle, cname, blocksize);
+        dump_blosc<E>(filename.c_str(), e, as_big_endian, clevel, shuffle, cname, blocksize, nthreads);
     }
 
     /**
@@ -156,11 +184,11 @@ namespace xt
      * @param e the xexpression
      */
     template <typename E>
-    inline std::string dump_blosc(const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0)
+    inline std::string dump_blosc(const xexpression<E>& e, bool as_big_endian=is_big_endian(), int clevel=5, int shuffle=1, const char* cname="blosclz", std::size_t blocksize=0, int nthreads=1)
     {
         std::stringstream stream;
         auto s = xostream_wrapper(stream);
-        detail::dump_blosc(s, e, as_big_endian, clevel, shuffle, cname, blocksize);
+        detail::dump_blosc(s, e, as_big_endian, clevel, shuffle, cname, blocksize, nthreads);
         return stream.str();
     }
 
@@ -174,9 +202,9 @@ namespace xt
      * @return xarray with contents from blosc file
      */
     template <typename T, layout_type L = layout_type::dynamic, class I>
-    inline auto load_blosc(I& stream, bool as_big_endian=is_big_endian())
+    inline auto load_blosc(I& stream, bool as_big_endian=is_big_endian(), int nthreads=1)
     {
-        xt::svector<T> uncompressed_buffer = detail::load_blosc<T>(stream, as_big_endian);
+        xt::svector<T> uncompressed_buffer = detail::load_blosc<T>(stream, as_big_endian, nthreads);
         std::vector<std::size_t> shape = {uncompressed_buffer.size()};
         auto array = adapt(std::move(uncompressed_buffer), shape);
         return array;
@@ -192,7 +220,7 @@ namespace xt
      * @return xarray with contents from blosc file
      */
     template <typename T, layout_type L = layout_type::dynamic>
-    inline auto load_blosc(const char* filename, bool as_big_endian=is_big_endian())
+    inline auto load_blosc(const char* filename, bool as_big_endian=is_big_endian(), int nthreads=1)
     {
         std::ifstream stream(filename, std::ifstream::binary);
         if (!stream.is_open())
@@ -200,13 +228,13 @@ namespace xt
             XTENSOR_THROW(std::runtime_error, std::string("Blosc: failed to open file ") + filename);
         }
         auto s = xistream_wrapper(stream);;
-        return load_blosc<T, L>(s, as_big_endian);
+        return load_blosc<T, L>(s, as_big_endian, nthreads);
     }
 
     template <typename T, layout_type L = layout_type::dynamic>
-    inline auto load_blosc(const std::string& filename, bool as_big_endian=is_big_endian())
+    inline auto load_blosc(const std::string& filename, bool as_big_endian=is_big_endian(), int nthreads=1)
     {
-        return load_blosc<T, L>(filename.c_str(), as_big_endian);
+        return load_blosc<T, L>(filename.c_str(), as_big_endian, nthreads);
     }
 
     struct xio_blosc_config
@@ -218,6 +246,8 @@ namespace xt
         int shuffle;
         std::string cname;
         std::size_t blocksize;
+        // number of threads used by blosc, not saved with the data
+        int nthreads;
 
         xio_blosc_config()
             : name("blosc")
@@ -227,6 +257,7 @@ namespace xt
             , shuffle(1)
             , cname("blosclz")
             , blocksize(0)
+            , nthreads(1)
         {
         }
 
@@ -248,7 +279,7 @@ namespace xt
             blocksize = j["blocksize"];
         }
 
-        bool will_dump(xfile_dirty dirty)
+        bool will_dump(const xfile_dirty& dirty)
         {
             return dirty.data_dirty;
         }
@@ -259,7 +290,14 @@ namespace xt
     {
         E& ex = e.derived_cast();
         auto shape = ex.shape();
-        ex = load_blosc<typename E::value_type>(stream, config.big_endian);
+        auto* data = detail::decode_destination(ex);
+        if (!shape.empty() && data != nullptr)
+        {
+            // the array already has the expected size
+            detail::load_blosc_into(stream, data, ex.size(), config.big_endian, config.nthreads);
+            return;
+        }
+        ex = load_blosc<typename E::value_type>(stream, config.big_endian, config.nthreads);
         if (!shape.empty())
         {
             if (compute_size(shape) != ex.size())
@@ -273,7 +311,7 @@ namespace xt
     template <class E, class O>
     void dump_file(O& stream, const xexpression<E> &e, const xio_blosc_config& config)
     {
-        dump_blosc(stream, e, config.big_endian, config.clevel, config.shuffle, config.cname.c_str(), config.blocksize);
+        dump_blosc(stream, e, config.big_endian, config.clevel, config.shuffle, config.cname.c_str(), config.blocksize, config.nthreads);
     }
 }  // namespace xt
 
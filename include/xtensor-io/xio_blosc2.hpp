@@ -0,0 +1,459 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_BLOSC2_HPP
+#define XTENSOR_IO_BLOSC2_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#include "xtensor/containers/xadapt.hpp"
+#include "xtensor-io.hpp"
+#include "xfile_array.hpp"
+#include "blosc2.h"
+#include "xio_scratch_arena.hpp"
+#include "xio_stream_wrapper.hpp"
+
+namespace xt
+{
+    /**
+     * @struct xio_blosc2_config
+     * @brief Configuration of the Blosc2 file format.
+     *
+     * Each file holds a single Blosc2 chunk. Since blosc.h and blosc2.h
+     * define the same macros, this header cannot be included in the same
+     * translation unit as xio_blosc.hpp. The filter pipeline applies,
+     * in order, the truncation of the precision (if trunc_prec is not 0),
+     * the delta filter (if delta is true) and the shuffle filter
+     * (BLOSC_NOSHUFFLE, BLOSC_SHUFFLE or BLOSC_BITSHUFFLE).
+     */
+    struct xio_blosc2_config
+    {
+        std::string name;
+        std::string version;
+        bool big_endian;
+        int clevel;
+        std::string cname;
+        int shuffle;
+        bool delta;
+        // number of bits of precision to keep, 0 to keep the full precision
+        int trunc_prec;
+        // builds a dictionary for each chunk (zstd only)
+        bool use_dict;
+        std::size_t blocksize;
+        // number of threads used by blosc2, not saved with the data
+        int nthreads;
+
+        xio_blosc2_config()
+            : name("blosc2")
+            , version(BLOSC2_VERSION_STRING)
+            , big_endian(is_big_endian())
+            , clevel(5)
+            , cname("blosclz")
+            , shuffle(BLOSC_SHUFFLE)
+            , delta(false)
+            , trunc_prec(0)
+            , use_dict(false)
+            , blocksize(0)
+            , nthreads(1)
+        {
+        }
+
+        template <class T>
+        void write_to(T& j) const
+        {
+            j["clevel"] = clevel;
+            j["cname"] = cname;
+            j["shuffle"] = shuffle;
+            j["delta"] = delta;
+            j["trunc_prec"] = trunc_prec;
+            j["use_dict"] = use_dict;
+            j["blocksize"] = blocksize;
+        }
+
+        template <class T>
+        void read_from(T& j)
+        {
+            clevel = j["clevel"];
+            cname = std::string(j["cname"]);
+            shuffle = j["shuffle"];
+            delta = j["delta"];
+            trunc_prec = j["trunc_prec"];
+            use_dict = j["use_dict"];
+            blocksize = j["blocksize"];
+        }
+
+        bool will_dump(const xfile_dirty& dirty)
+        {
+            return dirty.data_dirty;
+        }
+    };
+
+    namespace detail
+    {
+        inline void init_blosc2()
+        {
+            static std::once_flag initialized;
+            std::call_once(initialized, blosc2_init);
+        }
+
+        using blosc2_context_ptr = std::unique_ptr<blosc2_context, void(*)(blosc2_context*)>;
+
+        inline blosc2_context_ptr make_blosc2_dctx(int nthreads)
+        {
+            blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+            dparams.nthreads = static_cast<int16_t>(nthreads);
+            blosc2_context_ptr dctx(blosc2_create_dctx(dparams), blosc2_free_ctx);
+            if (dctx == nullptr)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: cannot create decompression context");
+            }
+            return dctx;
+        }
+
+        // Returns the uncompressed size of a Blosc2 chunk, in bytes.
+        inline std::size_t blosc2_nbytes(const std::string& compressed_buffer)
+        {
+            int32_t nbytes = 0;
+            int32_t cbytes = 0;
+            int32_t blocksize = 0;
+            if (compressed_buffer.size() < BLOSC_MIN_HEADER_LENGTH
+                || blosc2_cbuffer_sizes(compressed_buffer.data(), &nbytes, &cbytes, &blocksize) < 0
+                || std::size_t(cbytes) > compressed_buffer.size())
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: invalid chunk");
+            }
+            return std::size_t(nbytes);
+        }
+
+        template <typename T>
+        inline void blosc2_decompress_into(const std::string& compressed_buffer, T* data, std::size_t nbytes, int nthreads)
+        {
+            auto dctx = make_blosc2_dctx(nthreads);
+            int res = blosc2_decompress_ctx(dctx.get(), compressed_buffer.data(), static_cast<int32_t>(compressed_buffer.size()),
+                                            data, static_cast<int32_t>(nbytes));
+            if (res < 0 || std::size_t(res) != nbytes)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: decompression error (" + std::to_string(res) + ")");
+            }
+        }
+
+        template <typename T, class I>
+        inline xt::svector<T> load_blosc2(I& stream, bool as_big_endian, int nthreads = 1)
+        {
+            init_blosc2();
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            std::size_t nbytes = blosc2_nbytes(compressed_buffer);
+            if (nbytes % sizeof(T) != 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: size is not a multiple of the element size");
+            }
+            xt::svector<T> uncompressed_buffer(nbytes / sizeof(T));
+            blosc2_decompress_into(compressed_buffer, uncompressed_buffer.data(), nbytes, nthreads);
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+            {
+                swap_endianness(uncompressed_buffer);
+            }
+            return uncompressed_buffer;
+        }
+
+        template <typename T, class I>
+        inline void load_blosc2_into(I& stream, T* data, std::size_t size, bool as_big_endian, int nthreads = 1)
+        {
+            init_blosc2();
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            std::size_t nbytes = blosc2_nbytes(compressed_buffer);
+            if (nbytes != size * sizeof(T))
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: expected size (" + std::to_string(size) + ") and actual size (" + std::to_string(nbytes / sizeof(T)) + ") mismatch");
+            }
+            blosc2_decompress_into(compressed_buffer, data, nbytes, nthreads);
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+            {
+                swap_endianness(data, size);
+            }
+        }
+
+        template <typename T, class I>
+        inline xt::svector<T> load_blosc2_range(I& stream, std::size_t start, std::size_t count, bool as_big_endian, int nthreads = 1)
+        {
+            init_blosc2();
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            std::size_t nbytes = blosc2_nbytes(compressed_buffer);
+            if ((start + count) * sizeof(T) > nbytes)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: range [" + std::to_string(start) + ", " + std::to_string(start + count) + ") out of bounds (" + std::to_string(nbytes / sizeof(T)) + ")");
+            }
+            xt::svector<T> uncompressed_buffer(count);
+            if (count != 0)
+            {
+                // only the blocks overlapping the range are decompressed
+                auto dctx = make_blosc2_dctx(nthreads);
+                int res = blosc2_getitem_ctx(dctx.get(), compressed_buffer.data(), static_cast<int32_t>(compressed_buffer.size()),
+                                             static_cast<int>(start), static_cast<int>(count),
+                                             uncompressed_buffer.data(), static_cast<int32_t>(count * sizeof(T)));
+                if (res < 0 || std::size_t(res) != count * sizeof(T))
+                {
+                    XTENSOR_THROW(std::runtime_error, "Blosc2: decompression error (" + std::to_string(res) + ")");
+                }
+            }
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+            {
+                swap_endianness(uncompressed_buffer);
+            }
+            return uncompressed_buffer;
+        }
+
+        template <class O, class E>
+        inline void dump_blosc2(O& stream, const xexpression<E>& e, const xio_blosc2_config& config)
+        {
+            init_blosc2();
+            using value_type = typename E::value_type;
+            const E& ex = e.derived_cast();
+            auto&& eval_ex = eval(ex);
+            auto shape = eval_ex.shape();
+            std::size_t size = compute_size(shape);
+            std::size_t uncompressed_size = size * sizeof(value_type);
+            if (uncompressed_size > std::size_t(BLOSC2_MAX_BUFFERSIZE))
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: buffer is too large (" + std::to_string(uncompressed_size) + " bytes)");
+            }
+            const char* uncompressed_buffer;
+            xscratch_arena::buffer swapped_buffer;
+            if ((sizeof(value_type) > 1) && (config.big_endian != is_big_endian()))
+            {
+                swapped_buffer = scratch_arena().acquire(uncompressed_size);
+                copy_swap_endianness(eval_ex.data(), size, reinterpret_cast<value_type*>(swapped_buffer.data()));
+                uncompressed_buffer = swapped_buffer.data();
+            }
+            else
+            {
+                uncompressed_buffer = reinterpret_cast<const char*>(eval_ex.data());
+            }
+
+            int compcode = blosc2_compname_to_compcode(config.cname.c_str());
+            if (compcode < 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: compressor not supported (" + config.cname + ")");
+            }
+            blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+            cparams.compcode = static_cast<uint8_t>(compcode);
+            cparams.clevel = static_cast<uint8_t>(config.clevel);
+            cparams.typesize = static_cast<int32_t>(sizeof(value_type));
+            cparams.nthreads = static_cast<int16_t>(config.nthreads);
+            cparams.blocksize = static_cast<int32_t>(config.blocksize);
+            cparams.use_dict = config.use_dict ? 1 : 0;
+            for (std::size_t i = 0; i < std::size_t(BLOSC2_MAX_FILTERS); ++i)
+            {
+                cparams.filters[i] = BLOSC_NOFILTER;
+                cparams.filters_meta[i] = 0;
+            }
+            std::size_t last = std::size_t(BLOSC2_MAX_FILTERS) - 1;
+            cparams.filters[last] = static_cast<uint8_t>(config.shuffle);
+            if (config.delta)
+            {
+                cparams.filters[--last] = BLOSC_DELTA;
+            }
+            if (config.trunc_prec != 0)
+            {
+                --last;
+                cparams.filters[last] = BLOSC_TRUNC_PREC;
+                cparams.filters_meta[last] = static_cast<uint8_t>(config.trunc_prec);
+            }
+            blosc2_context_ptr cctx(blosc2_create_cctx(cparams), blosc2_free_ctx);
+            if (cctx == nullptr)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: cannot create compression context");
+            }
+
+            std::size_t max_compressed_size = uncompressed_size + BLOSC2_MAX_OVERHEAD;
+            auto compressed_scratch = scratch_arena().acquire(max_compressed_size);
+            int true_compressed_size = blosc2_compress_ctx(cctx.get(), uncompressed_buffer, static_cast<int32_t>(uncompressed_size),
+                                                           compressed_scratch.data(), static_cast<int32_t>(max_compressed_size));
+            if (true_compressed_size == 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: buffer is uncompressible");
+            }
+            else if (true_compressed_size < 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: compression error (" + std::to_string(true_compressed_size) + ")");
+            }
+            stream.write(compressed_scratch.data(), std::streamsize(true_compressed_size));
+            stream.flush();
+        }
+    }  // namespace detail
+
+    /**
+     * Save xexpression to Blosc2 format
+     *
+     * @param stream An output stream to which to dump the data
+     * @param e the xexpression
+     * @param config the compression settings
+     */
+    template <typename E, class O>
+    inline void dump_blosc2(O& stream, const xexpression<E>& e, const xio_blosc2_config& config = xio_blosc2_config())
+    {
+        detail::dump_blosc2(stream, e, config);
+    }
+
+    template <typename E>
+    inline void dump_blosc2(std::ostream& stream, const xexpression<E>& e, const xio_blosc2_config& config = xio_blosc2_config())
+    {
+        auto s = xostream_wrapper(stream);
+        detail::dump_blosc2(s, e, config);
+    }
+
+    /**
+     * Save xexpression to Blosc2 format
+     *
+     * @param filename The filename or path to dump the data
+     * @param e the xexpression
+     * @param config the compression settings
+     */
+    template <typename E>
+    inline void dump_blosc2(const char* filename, const xexpression<E>& e, const xio_blosc2_config& config = xio_blosc2_config())
+    {
+        std::ofstream stream(filename, std::ofstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("Blosc2: failed to open file ") + filename);
+        }
+        auto s = xostream_wrapper(stream);
+        detail::dump_blosc2(s, e, config);
+    }
+
+    template <typename E>
+    inline void dump_blosc2(const std::string& filename, const xexpression<E>& e, const xio_blosc2_config& config = xio_blosc2_config())
+    {
+        dump_blosc2<E>(filename.c_str(), e, config);
+    }
+
+    /**
+     * Loads a Blosc2 file
+     *
+     * @param stream An input stream from which to load the file
+     * @tparam T select the type of the Blosc2 file
+     * @tparam L select layout_type::column_major if you stored data in
+     *           Fortran format
+     * @return xarray with contents from Blosc2 file
+     */
+    template <typename T, layout_type L = layout_type::dynamic, class I>
+    inline auto load_blosc2(I& stream, bool as_big_endian=is_big_endian(), int nthreads=1)
+    {
+        xt::svector<T> uncompressed_buffer = detail::load_blosc2<T>(stream, as_big_endian, nthreads);
+        std::vector<std::size_t> shape = {uncompressed_buffer.size()};
+        auto array = adapt(std::move(uncompressed_buffer), shape);
+        return array;
+    }
+
+    /**
+     * Loads a Blosc2 file
+     *
+     * @param filename The filename or path to the file
+     * @tparam T select the type of the Blosc2 file
+     * @tparam L select layout_type::column_major if you stored data in
+     *           Fortran format
+     * @return xarray with contents from Blosc2 file
+     */
+    template <typename T, layout_type L = layout_type::dynamic>
+    inline auto load_blosc2(const char* filename, bool as_big_endian=is_big_endian(), int nthreads=1)
+    {
+        std::ifstream stream(filename, std::ifstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("Blosc2: failed to open file ") + filename);
+        }
+        auto s = xistream_wrapper(stream);
+        return load_blosc2<T, L>(s, as_big_endian, nthreads);
+    }
+
+    template <typename T, layout_type L = layout_type::dynamic>
+    inline auto load_blosc2(const std::string& filename, bool as_big_endian=is_big_endian(), int nthreads=1)
+    {
+        return load_blosc2<T, L>(filename.c_str(), as_big_endian, nthreads);
+    }
+
+    /**
+     * Loads a range of elements of a Blosc2 file. Only the blocks of the
+     * file overlapping the range are decompressed.
+     *
+     * @param stream An input stream from which to load the file
+     * @param start the index of the first element to load, in the flat
+     *        data of the file
+     * @param count the number of elements to load
+     * @tparam T select the type of the Blosc2 file
+     * @return 1-D xarray with the loaded elements
+     */
+    template <typename T, class I>
+    inline auto load_blosc2_range(I& stream, std::size_t start, std::size_t count, bool as_big_endian=is_big_endian(), int nthreads=1)
+    {
+        xt::svector<T> uncompressed_buffer = detail::load_blosc2_range<T>(stream, start, count, as_big_endian, nthreads);
+        std::vector<std::size_t> shape = {uncompressed_buffer.size()};
+        auto array = adapt(std::move(uncompressed_buffer), shape);
+        return array;
+    }
+
+    template <typename T>
+    inline auto load_blosc2_range(const char* filename, std::size_t start, std::size_t count, bool as_big_endian=is_big_endian(), int nthreads=1)
+    {
+        std::ifstream stream(filename, std::ifstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("Blosc2: failed to open file ") + filename);
+        }
+        auto s = xistream_wrapper(stream);
+        return load_blosc2_range<T>(s, start, count, as_big_endian, nthreads);
+    }
+
+    template <typename T>
+    inline auto load_blosc2_range(const std::string& filename, std::size_t start, std::size_t count, bool as_big_endian=is_big_endian(), int nthreads=1)
+    {
+        return load_blosc2_range<T>(filename.c_str(), start, count, as_big_endian, nthreads);
+    }
+
+    template <class E, class I>
+    void load_file(I& stream, xexpression<E>& e, const xio_blosc2_config& config)
+    {
+        E& ex = e.derived_cast();
+        auto shape = ex.shape();
+        auto* data = detail::decode_destination(ex);
+        if (!shape.empty() && data != nullptr)
+        {
+            // the array already has the expected size
+            detail::load_blosc2_into(stream, data, ex.size(), config.big_endian, config.nthreads);
+            return;
+        }
+        ex = load_blosc2<typename E::value_type>(stream, config.big_endian, config.nthreads);
+        if (!shape.empty())
+        {
+            if (compute_size(shape) != ex.size())
+            {
+                XTENSOR_THROW(std::runtime_error, "Blosc2: expected size (" + std::to_string(compute_size(shape)) + ") and actual size (" + std::to_string(ex.size()) + ") mismatch");
+            }
+            ex.reshape(shape);
+        }
+    }
+
+    template <class E, class O>
+    void dump_file(O& stream, const xexpression<E> &e, const xio_blosc2_config& config)
+    {
+        dump_blosc2(stream, e, config);
+    }
+}  // namespace xt
+
+#endif
@@ -20,16 +20,22 @@ namespace xt
     class xio_disk_handler
     {
     public:
+        using format_config = C;
         using io_config = xio_disk_config;
 
         xio_disk_handler();
 
         template <class E>
-        void write(const xexpression<E>& expression, const std::string& path, xfile_dirty dirty);
+        void write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty);
 
         template <class ET>
         void read(ET& array, const std::string& path);
 
+        template <class ET>
+        bool try_read(ET& array, const std::string& path);
+
+        void remove(const std::string& path);
+
         void configure(const C& format_config, const xio_disk_config& io_config);
         void configure_io(const xio_disk_config& io_config);
 
@@ -39,6 +45,17 @@ namespace xt
         bool m_create_directories;
     };
 
+    /**
+     * Rewrites only the dirty blocks of an existing file. The formats which
+     * support it overload this function, the others always rewrite the
+     * whole file.
+     */
+    template <class E, class C>
+    inline bool dump_file_blocks(const std::string&, const xexpression<E>&, const xfile_dirty&, const C&)
+    {
+        return false;
+    }
+
     template <class C>
     xio_disk_handler<C>::xio_disk_handler()
         : m_create_directories(true)
@@ -47,10 +64,14 @@ namespace xt
 
     template <class C>
     template <class E>
-    inline void xio_disk_handler<C>::write(const xexpression<E>& expression, const std::string& path, xfile_dirty dirty)
+    inline void xio_disk_handler<C>::write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty)
     {
         if (m_format_config.will_dump(dirty))
         {
+            if (dirty.is_partial() && dump_file_blocks(path, expression, dirty, m_format_config))
+            {
+                return;
+            }
             if (m_create_directories)
             {
                 // maybe create directories
@@ -87,16 +108,43 @@ namespace xt
     template <class C>
     template <class ET>
     inline void xio_disk_handler<C>::read(ET& array, const std::string& path)
+    {
+        if (!try_read(array, path))
+        {
+            XTENSOR_THROW(std::runtime_error, "read: failed to open file " + path);
+        }
+    }
+
+    /**
+     * Reads the file like read, but returns false instead of throwing if
+     * the file cannot be opened, e.g. because it does not exist.
+     * Errors in the content of the file still throw.
+     */
+    template <class C>
+    template <class ET>
+    inline bool xio_disk_handler<C>::try_read(ET& array, const std::string& path)
     {
         std::ifstream in_file(path, std::ifstream::binary);
-        if (in_file.is_open())
+        if (!in_file.is_open())
         {
-            auto s = xistream_wrapper(in_file);
-            load_file<ET>(s, array, m_format_config);
+            return false;
         }
-        else
+        auto s = xistream_wrapper(in_file);
+        load_file<ET>(s, array, m_format_config);
+        return true;
+    }
+
+    /**
+     * Removes the file, if it exists.
+     */
+    template <class C>
+    inline void xio_disk_handler<C>::remove(const std::string& path)
+    {
+        std::error_code ec;
+        fs::remove(path, ec);
+        if (ec)
         {
-            XTENSOR_THROW(std::runtime_error, "read: failed to open file " + path);
+            XTENSOR_THROW(std::runtime_error, "remove: failed to remove file " + path + ": " + ec.message());
         }
     }
 
@@ -22,16 +22,20 @@ namespace xt
     class xio_gcs_handler
     {
     public:
+        using format_config = C;
         using io_config = xio_gcs_config;
 
         xio_gcs_handler();
 
         template <class E>
-        void write(const xexpression<E>& expression, const std::string& path, xfile_dirty dirty);
+        void write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty);
 
         template <class ET>
         void read(ET& array, const std::string& path);
 
+        template <class ET>
+        bool try_read(ET& array, const std::string& path);
+
         void configure(const C& format_config, const xio_gcs_config& io_config);
         void configure_io(const xio_gcs_config& io_config);
 
@@ -50,7 +54,7 @@ namespace xt
 
     template <class C>
     template <class E>
-    inline void xio_gcs_handler<C>::write(const xexpression<E>& expression, const std::string& path, xfile_dirty dirty)
+    inline void xio_gcs_handler<C>::write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty)
     {
         if (m_format_config.will_dump(dirty))
         {
@@ -63,10 +67,29 @@ namespace xt
     template <class C>
     template <class ET>
     inline void xio_gcs_handler<C>::read(ET& array, const std::string& path)
+    {
+        if (!try_read(array, path))
+        {
+            XTENSOR_THROW(std::runtime_error, "read: object not found " + path);
+        }
+    }
+
+    template <class C>
+    template <class ET>
+    inline bool xio_gcs_handler<C>::try_read(ET& array, const std::string& path)
     {
         auto reader = m_client.ReadObject(m_bucket, path);
+        if (!reader.status().ok())
+        {
+            if (reader.status().code() == google::cloud::StatusCode::kNotFound)
+            {
+                return false;
+            }
+            XTENSOR_THROW(std::runtime_error, "read: failed to read object " + path + ": " + reader.status().message());
+        }
         auto s = xt::xistream_wrapper(reader);
         load_file<ET>(s, array, m_format_config);
+        return true;
     }
 
     template <class C>
@@ -18,14 +18,18 @@ namespace xt
     class xio_gdal_handler
     {
     public:
+        using format_config = C;
         using io_config = xio_gdal_config;
 
         template <class E>
-        void write(const xexpression<E>& expression, const std::string& path, xfile_dirty dirty);
+        void write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty);
 
         template <class ET>
         void read(ET& array, const std::string& path);
 
+        template <class ET>
+        bool try_read(ET& array, const std::string& path);
+
         void configure(const C& format_config, const xio_gdal_config& io_config);
         void configure_io(const xio_gdal_config& io_config);
 
@@ -36,7 +40,7 @@ namespace xt
 
     template <class C>
     template <class E>
-    inline void xio_gdal_handler<C>::write(const xexpression<E>& expression, const std::string& path, xfile_dirty dirty)
+    inline void xio_gdal_handler<C>::write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty)
     {
         if (m_format_config.will_dump(dirty))
         {
@@ -57,16 +61,24 @@ namespace xt
     template <class ET>
     inline void xio_gdal_handler<C>::read(ET& array, const std::string& path)
     {
-        VSILFILE* in_file = VSIFOpenL(path.c_str(), "rb");
-        if (in_file != NULL)
+        if (!try_read(array, path))
         {
-            auto f = xvsilfile_wrapper(in_file);
-            load_file<ET>(f, array, m_format_config);
+            XTENSOR_THROW(std::runtime_error, "read: failed to open file " + path);
         }
-        else
+    }
+
+    template <class C>
+    template <class ET>
+    inline bool xio_gdal_handler<C>::try_read(ET& array, const std::string& path)
+    {
+        VSILFILE* in_file = VSIFOpenL(path.c_str(), "rb");
+        if (in_file == NULL)
         {
-            XTENSOR_THROW(std::runtime_error, "read: failed to open file " + path);
+            return false;
         }
+        auto f = xvsilfile_wrapper(in_file);
+        load_file<ET>(f, array, m_format_config);
+        return true;
     }
 
     template <class C>
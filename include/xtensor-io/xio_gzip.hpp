@@ -10,14 +10,26 @@
 #ifndef XTENSOR_IO_GZIP_HPP
 #define XTENSOR_IO_GZIP_HPP
 
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "zlib.h"
 
 #include "xtensor/containers/xadapt.hpp"
 #include "xtensor-io.hpp"
 #include "xfile_array.hpp"
+#include "xio_scratch_arena.hpp"
 #include "xio_stream_wrapper.hpp"
+#include "xthread_pool.hpp"
 
 #ifndef GZIP_CHUNK
 #define GZIP_CHUNK 0x4000
@@ -35,34 +47,443 @@
 #define ENABLE_ZLIB_GZIP 32
 #endif
 
+#ifndef GZIP_BLOCK_SIZE
+#define GZIP_BLOCK_SIZE 0x100000
+#endif
+
 namespace xt
 {
     namespace detail
     {
+        // Returns the uncompressed size of a gzip stream, read from its
+        // ISIZE trailer, or 0 if the buffer is not a gzip stream. ISIZE is
+        // only exact for single-member streams smaller than 4 GiB, the result
+        // must be considered as a hint.
+        inline std::size_t gzip_size_hint(const std::string& compressed_buffer)
+        {
+            std::size_t size = compressed_buffer.size();
+            const unsigned char* buf = reinterpret_cast<const unsigned char*>(compressed_buffer.data());
+            // 10 bytes header, 8 bytes trailer
+            if (size < 18 || buf[0] != 0x1f || buf[1] != 0x8b)
+            {
+                return 0;
+            }
+            const unsigned char* isize = buf + size - 4;
+            std::size_t res = std::size_t(isize[0])
+                | (std::size_t(isize[1]) << 8)
+                | (std::size_t(isize[2]) << 16)
+                | (std::size_t(isize[3]) << 24);
+            // deflate cannot compress more than ~1032:1
+            return std::min(res, size * 1032);
+        }
+
+        // Multithreaded dumps split the data in blocks of GZIP_BLOCK_SIZE
+        // bytes, compressed independently and written as consecutive gzip
+        // members, which gunzip decompresses as a single file. The header
+        // of each member indexes it with an extra field (subfield "XI")
+        // holding its compressed and uncompressed sizes, so that readers
+        // can locate the members and inflate them concurrently.
+        struct gzip_member
+        {
+            std::size_t data_offset;
+            std::size_t compressed_size;
+            std::size_t output_offset;
+            std::size_t size;
+            uLong crc;
+        };
+
+        // 10 bytes header, XLEN, subfield ID and length, sizes
+        constexpr std::size_t gzip_member_header_size = 10 + 2 + 4 + 16;
+
+        inline void gzip_write_le(unsigned char* buf, std::uint64_t value, std::size_t nbytes)
+        {
+            for (std::size_t i = 0; i < nbytes; ++i)
+            {
+                buf[i] = static_cast<unsigned char>(value >> (8 * i));
+            }
+        }
+
+        inline std::uint64_t gzip_read_le(const unsigned char* buf, std::size_t nbytes)
+        {
+            std::uint64_t value = 0;
+            for (std::size_t i = 0; i < nbytes; ++i)
+            {
+                value |= std::uint64_t(buf[i]) << (8 * i);
+            }
+            return value;
+        }
+
+        // Returns false if the buffer is not made of indexed members only.
+        inline bool gzip_index(const std::string& compressed_buffer, std::vector<gzip_member>& members)
+        {
+            members.clear();
+            const unsigned char* buf = reinterpret_cast<const unsigned char*>(compressed_buffer.data());
+            std::size_t size = compressed_buffer.size();
+            std::size_t pos = 0;
+            std::size_t output_offset = 0;
+            while (pos < size)
+            {
+                const unsigned char* header = buf + pos;
+                // FLG must be FEXTRA only, with the "XI" subfield only
+                if (size - pos < gzip_member_header_size + 8 ||
+                    header[0] != 0x1f || header[1] != 0x8b || header[2] != Z_DEFLATED || header[3] != 4 ||
+                    gzip_read_le(header + 10, 2) != 20 || header[12] != 'X' || header[13] != 'I' ||
+                    gzip_read_le(header + 14, 2) != 16)
+                {
+                    return false;
+                }
+                gzip_member member;
+                member.data_offset = pos + gzip_member_header_size;
+                member.compressed_size = gzip_read_le(header + 16, 8);
+                member.output_offset = output_offset;
+                member.size = gzip_read_le(header + 24, 8);
+                if (member.compressed_size > size - member.data_offset - 8 ||
+                    member.compressed_size > UINT_MAX || member.size > UINT_MAX)
+                {
+                    return false;
+                }
+                const unsigned char* trailer = buf + member.data_offset + member.compressed_size;
+                member.crc = static_cast<uLong>(gzip_read_le(trailer, 4));
+                if (gzip_read_le(trailer + 4, 4) != member.size)
+                {
+                    return false;
+                }
+                members.push_back(member);
+                output_offset += member.size;
+                pos = member.data_offset + member.compressed_size + 8;
+            }
+            return !members.empty();
+        }
+
+        inline std::size_t gzip_index_size(const std::vector<gzip_member>& members)
+        {
+            return members.back().output_offset + members.back().size;
+        }
+
+        inline void inflate_gzip_member(const std::string& compressed_buffer, const gzip_member& member, char* out)
+        {
+            z_stream zs;
+            zs.zalloc = Z_NULL;
+            zs.zfree = Z_NULL;
+            zs.opaque = Z_NULL;
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed_buffer.data() + member.data_offset));
+            zs.avail_in = static_cast<uInt>(member.compressed_size);
+            inflateInit2(&zs, -GZIP_WINDOWBITS);
+            // inflate needs an output buffer, even for an empty member
+            Bytef empty;
+            Bytef* dst = member.size != 0 ? reinterpret_cast<Bytef*>(out + member.output_offset) : &empty;
+            zs.next_out = dst;
+            zs.avail_out = static_cast<uInt>(member.size);
+            int zlib_status = inflate(&zs, Z_FINISH);
+            bool complete = zlib_status == Z_STREAM_END && zs.avail_in == 0 && zs.avail_out == 0;
+            inflateEnd(&zs);
+            if (!complete)
+            {
+                XTENSOR_THROW(std::runtime_error, "gzip decompression failed (corrupted member)");
+            }
+            if (crc32(0L, dst, static_cast<uInt>(member.size)) != member.crc)
+            {
+                XTENSOR_THROW(std::runtime_error, "gzip decompression failed (CRC mismatch)");
+            }
+        }
+
+        // Worker threads of the calling thread, kept between the calls,
+        // and started again when the number of threads changes.
+        inline xthread_pool& gzip_thread_pool(int nthreads)
+        {
+            thread_local std::unique_ptr<xthread_pool> pool;
+            std::size_t size = static_cast<std::size_t>(std::max(nthreads, 1));
+            if (!pool || pool->size() != size)
+            {
+                pool.reset();
+                pool = std::make_unique<xthread_pool>(size);
+            }
+            return *pool;
+        }
+
+        inline void inflate_gzip_members(const std::string& compressed_buffer, const std::vector<gzip_member>& members, char* out, int nthreads)
+        {
+            xthread_pool& pool = gzip_thread_pool(nthreads);
+            for (const auto& member: members)
+            {
+                pool.submit([&compressed_buffer, &member, out]()
+                {
+                    inflate_gzip_member(compressed_buffer, member, out);
+                });
+            }
+            pool.wait();
+        }
+
+        // Compresses a block into a complete gzip member.
+        inline std::string deflate_gzip_member(const char* data, std::size_t size, int level)
+        {
+            z_stream zs;
+            zs.zalloc = Z_NULL;
+            zs.zfree = Z_NULL;
+            zs.opaque = Z_NULL;
+            deflateInit2(&zs, level, Z_DEFLATED, -GZIP_WINDOWBITS, 8, Z_DEFAULT_STRATEGY);
+            uLong bound = deflateBound(&zs, static_cast<uLong>(size));
+            std::string member(gzip_member_header_size + bound + 8, '\0');
+            unsigned char* buf = reinterpret_cast<unsigned char*>(&member[0]);
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            zs.avail_in = static_cast<uInt>(size);
+            zs.next_out = buf + gzip_member_header_size;
+            zs.avail_out = static_cast<uInt>(bound);
+            int zlib_status = deflate(&zs, Z_FINISH);
+            std::size_t compressed_size = zs.total_out;
+            deflateEnd(&zs);
+            if (zlib_status != Z_STREAM_END)
+            {
+                XTENSOR_THROW(std::runtime_error, "gzip compression failed (" + std::to_string(zlib_status) + ")");
+            }
+            // ID1, ID2, CM, FLG (FEXTRA), MTIME, XFL, OS (unknown)
+            const unsigned char header[10] = {0x1f, 0x8b, Z_DEFLATED, 4, 0, 0, 0, 0, 0, 255};
+            std::memcpy(buf, header, sizeof(header));
+            gzip_write_le(buf + 10, 20, 2);
+            buf[12] = 'X';
+            buf[13] = 'I';
+            gzip_write_le(buf + 14, 16, 2);
+            gzip_write_le(buf + 16, compressed_size, 8);
+            gzip_write_le(buf + 24, size, 8);
+            unsigned char* trailer = buf + gzip_member_header_size + compressed_size;
+            gzip_write_le(trailer, crc32(0L, reinterpret_cast<const Bytef*>(data), static_cast<uInt>(size)), 4);
+            gzip_write_le(trailer + 4, size & 0xffffffff, 4);
+            member.resize(gzip_member_header_size + compressed_size + 8);
+            return member;
+        }
+
+        // Each worker swaps its own block, if needed, in its scratch buffer
+        // before compressing it. The members are written in order as soon
+        // as they are compressed, at most two per thread being held in
+        // memory.
+        template <class O, class T>
+        inline void dump_gzip_members(O& stream, const T* data, std::size_t size, bool swap, int level, int nthreads)
+        {
+            struct member_slot
+            {
+                std::string member;
+                std::exception_ptr error;
+                bool ready = false;
+            };
+
+            std::size_t member_size = std::max<std::size_t>(GZIP_BLOCK_SIZE / sizeof(T), 1);
+            std::size_t nb_members = std::max<std::size_t>((size + member_size - 1) / member_size, 1);
+            xthread_pool& pool = gzip_thread_pool(nthreads);
+            std::size_t window = std::min<std::size_t>(2 * pool.size(), nb_members);
+            std::vector<member_slot> slots(window);
+            std::mutex mutex;
+            std::condition_variable cond;
+            auto compress = [&](std::size_t i)
+            {
+                pool.submit([&, i]()
+                {
+                    std::string member;
+                    std::exception_ptr error;
+                    try
+                    {
+                        std::size_t offset = i * member_size;
+                        std::size_t block_size = std::min<std::size_t>(member_size, size - offset);
+                        const char* block = reinterpret_cast<const char*>(data + offset);
+                        xscratch_arena::buffer swapped;
+                        if (swap)
+                        {
+                            swapped = scratch_arena().acquire(block_size * sizeof(T));
+                            copy_swap_endianness(data + offset, block_size, reinterpret_cast<T*>(swapped.data()));
+                            block = swapped.data();
+                        }
+                        member = deflate_gzip_member(block, block_size * sizeof(T), level);
+                    }
+                    catch (...)
+                    {
+                        error = std::current_exception();
+                    }
+                    // notified under the lock, the writer may return as
+                    // soon as it is released
+                    std::lock_guard<std::mutex> lock(mutex);
+                    member_slot& slot = slots[i % window];
+                    slot.member = std::move(member);
+                    slot.error = error;
+                    slot.ready = true;
+                    cond.notify_all();
+                });
+            };
+            std::size_t next = 0;
+            try
+            {
+                for (; next < window; ++next)
+                {
+                    compress(next);
+                }
+                for (std::size_t i = 0; i < nb_members; ++i)
+                {
+                    member_slot& slot = slots[i % window];
+                    std::string member;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        cond.wait(lock, [&slot]() { return slot.ready; });
+                        if (slot.error)
+                        {
+                            std::rethrow_exception(slot.error);
+                        }
+                        member = std::move(slot.member);
+                        slot.ready = false;
+                    }
+                    if (next < nb_members)
+                    {
+                        compress(next++);
+                    }
+                    stream.write(member.data(), static_cast<std::streamsize>(member.size()));
+                }
+            }
+            catch (...)
+            {
+                // the pending tasks refer to the slots
+                pool.wait();
+                throw;
+            }
+        }
+
         template <typename T, class I>
-        inline xt::svector<T> load_gzip(I& stream, bool as_big_endian)
+        inline xt::svector<T> load_gzip(I& stream, bool as_big_endian, int nthreads = 1)
         {
-            char in[GZIP_CHUNK];
-            T out[GZIP_CHUNK / sizeof(T)];
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            std::vector<gzip_member> members;
+            if (nthreads > 1 && gzip_index(compressed_buffer, members))
+            {
+                std::size_t nbytes = gzip_index_size(members);
+                if (nbytes % sizeof(T) != 0)
+                {
+                    XTENSOR_THROW(std::runtime_error, "gzip decompression failed (size is not a multiple of the element size)");
+                }
+                xt::svector<T> uncompressed_buffer(nbytes / sizeof(T));
+                inflate_gzip_members(compressed_buffer, members, reinterpret_cast<char*>(uncompressed_buffer.data()), nthreads);
+                if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+                {
+                    swap_endianness(uncompressed_buffer);
+                }
+                return uncompressed_buffer;
+            }
             z_stream zs;
             zs.zalloc = Z_NULL;
             zs.zfree = Z_NULL;
             zs.opaque = Z_NULL;
-            zs.next_in = reinterpret_cast<Bytef*>(in);
+            zs.next_in = reinterpret_cast<Bytef*>(&compressed_buffer[0]);
             zs.avail_in = 0;
             inflateInit2(&zs, GZIP_WINDOWBITS | ENABLE_ZLIB_GZIP);
-            xt::svector<T> uncompressed_buffer;
-            while (true)
+            std::size_t in_left = compressed_buffer.size();
+            std::size_t size_hint = gzip_size_hint(compressed_buffer);
+            if (size_hint == 0)
+            {
+                size_hint = 4 * in_left;
+            }
+            xt::svector<T> uncompressed_buffer((size_hint + sizeof(T) - 1) / sizeof(T));
+            if (uncompressed_buffer.empty())
+            {
+                uncompressed_buffer.resize(1);
+            }
+            std::size_t nbytes = 0;
+            int zlib_status = Z_OK;
+            do
+            {
+                if (zs.avail_in == 0)
+                {
+                    zs.avail_in = static_cast<uInt>(std::min<std::size_t>(in_left, UINT_MAX));
+                    in_left -= zs.avail_in;
+                }
+                std::size_t capacity = uncompressed_buffer.size() * sizeof(T);
+                if (nbytes == capacity)
+                {
+                    uncompressed_buffer.resize(2 * uncompressed_buffer.size());
+                    capacity *= 2;
+                }
+                zs.next_out = reinterpret_cast<Bytef*>(uncompressed_buffer.data()) + nbytes;
+                zs.avail_out = static_cast<uInt>(std::min<std::size_t>(capacity - nbytes, UINT_MAX));
+                uInt avail_out = zs.avail_out;
+                zlib_status = inflate(&zs, Z_NO_FLUSH);
+                switch (zlib_status)
+                {
+                    case Z_OK:
+                    case Z_STREAM_END:
+                    case Z_BUF_ERROR:
+                        break;
+                    default:
+                        inflateEnd(&zs);
+                        XTENSOR_THROW(std::runtime_error, "gzip decompression failed (" + std::to_string(zlib_status) + ")");
+                }
+                nbytes += avail_out - zs.avail_out;
+                if (zlib_status == Z_STREAM_END && (zs.avail_in != 0 || in_left != 0))
+                {
+                    // next member of a multi-member file
+                    inflateReset(&zs);
+                    zlib_status = Z_OK;
+                }
+            }
+            // Z_BUF_ERROR: no more input
+            while (zlib_status != Z_STREAM_END && zlib_status != Z_BUF_ERROR);
+            inflateEnd(&zs);
+            if (nbytes % sizeof(T) != 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "gzip decompression failed (size is not a multiple of the element size)");
+            }
+            uncompressed_buffer.resize(nbytes / sizeof(T));
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
             {
-                stream.read(in, sizeof(in));
-                uInt bytes_read = static_cast<uInt>(stream.gcount());
-                zs.avail_in = bytes_read;
-                zs.next_in = reinterpret_cast<Bytef*>(in);
+                swap_endianness(uncompressed_buffer);
+            }
+            return uncompressed_buffer;
+        }
+
+        template <typename T, class I>
+        inline void load_gzip_into(I& stream, T* data, std::size_t size, bool as_big_endian, int nthreads = 1)
+        {
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            std::vector<gzip_member> members;
+            if (nthreads > 1 && gzip_index(compressed_buffer, members))
+            {
+                if (gzip_index_size(members) != size * sizeof(T))
+                {
+                    XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+                }
+                inflate_gzip_members(compressed_buffer, members, reinterpret_cast<char*>(data), nthreads);
+            }
+            else
+            {
+                z_stream zs;
+                zs.zalloc = Z_NULL;
+                zs.zfree = Z_NULL;
+                zs.opaque = Z_NULL;
+                zs.next_in = reinterpret_cast<Bytef*>(&compressed_buffer[0]);
+                zs.avail_in = 0;
+                inflateInit2(&zs, GZIP_WINDOWBITS | ENABLE_ZLIB_GZIP);
+                std::size_t in_left = compressed_buffer.size();
+                Bytef* out = reinterpret_cast<Bytef*>(data);
+                std::size_t remaining = size * sizeof(T);
+                // receives the data in excess, if any
+                Bytef extra;
+                int zlib_status = Z_OK;
                 do
                 {
-                    zs.avail_out = GZIP_CHUNK;
-                    zs.next_out = reinterpret_cast<Bytef*>(out);
-                    int zlib_status = inflate(&zs, Z_NO_FLUSH);
+                    if (zs.avail_in == 0)
+                    {
+                        zs.avail_in = static_cast<uInt>(std::min<std::size_t>(in_left, UINT_MAX));
+                        in_left -= zs.avail_in;
+                    }
+                    if (remaining != 0)
+                    {
+                        zs.next_out = out;
+                        zs.avail_out = static_cast<uInt>(std::min<std::size_t>(remaining, UINT_MAX));
+                    }
+                    else
+                    {
+                        zs.next_out = &extra;
+                        zs.avail_out = 1;
+                    }
+                    uInt avail_out = zs.avail_out;
+                    zlib_status = inflate(&zs, Z_NO_FLUSH);
                     switch (zlib_status)
                     {
                         case Z_OK:
@@ -73,65 +494,84 @@ namespace xt
                             inflateEnd(&zs);
                             XTENSOR_THROW(std::runtime_error, "gzip decompression failed (" + std::to_string(zlib_status) + ")");
                     }
-                    unsigned int have = GZIP_CHUNK - zs.avail_out;
-                    uncompressed_buffer.insert(std::end(uncompressed_buffer), out, out + have / sizeof(T));
+                    std::size_t have = avail_out - zs.avail_out;
+                    if (remaining == 0 && have != 0)
+                    {
+                        inflateEnd(&zs);
+                        XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+                    }
+                    out += have;
+                    remaining -= have;
+                    if (zlib_status == Z_STREAM_END && (zs.avail_in != 0 || in_left != 0))
+                    {
+                        // next member of a multi-member file
+                        inflateReset(&zs);
+                        zlib_status = Z_OK;
+                    }
                 }
-                while (zs.avail_out == 0);
-                if (stream.eof())
+                // Z_BUF_ERROR: no more input
+                while (zlib_status != Z_STREAM_END && zlib_status != Z_BUF_ERROR);
+                inflateEnd(&zs);
+                if (remaining != 0)
                 {
-                    inflateEnd(&zs);
-                    break;
+                    XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
                 }
             }
             if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
             {
-                swap_endianness(uncompressed_buffer);
+                swap_endianness(data, size);
             }
-            return uncompressed_buffer;
         }
 
         template <class O, class E>
-        inline void dump_gzip(O& stream, const xexpression<E>& e, bool as_big_endian, int level)
+        inline void dump_gzip(O& stream, const xexpression<E>& e, bool as_big_endian, int level, int nthreads = 1)
         {
             using value_type = typename E::value_type;
             const E& ex = e.derived_cast();
             auto&& eval_ex = eval(ex);
             auto shape = eval_ex.shape();
             std::size_t size = compute_size(shape);
-            const char* uncompressed_buffer;
-            xt::svector<value_type> swapped_buffer;
-            if ((sizeof(value_type) > 1) && (as_big_endian != is_big_endian()))
-            {
-                swapped_buffer.resize(size);
-                std::copy(eval_ex.data(), eval_ex.data() + size, swapped_buffer.begin());
-                swap_endianness(swapped_buffer);
-                uncompressed_buffer = reinterpret_cast<const char*>(swapped_buffer.data());
-            }
-            else
+            bool swap = (sizeof(value_type) > 1) && (as_big_endian != is_big_endian());
+            if (nthreads > 1)
             {
-                uncompressed_buffer = reinterpret_cast<const char*>(eval_ex.data());
+                dump_gzip_members(stream, eval_ex.data(), size, swap, level, nthreads);
+                stream.flush();
+                return;
             }
             z_stream zs;
             zs.zalloc = Z_NULL;
             zs.zfree = Z_NULL;
             zs.opaque = Z_NULL;
             deflateInit2(&zs, level, Z_DEFLATED, GZIP_WINDOWBITS | GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY);
-            zs.avail_in = static_cast<uInt>(size * sizeof(value_type));
-            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(uncompressed_buffer));
             char out[GZIP_CHUNK];
-            do
+            // the data is fed to deflate in blocks, swapped on the fly if needed
+            for_each_swapped_block(eval_ex.data(), size, swap, [&](const char* block, std::size_t block_size, bool last_block)
             {
-                zs.avail_out = GZIP_CHUNK;
-                zs.next_out = reinterpret_cast<Bytef*>(out);
-                int zlib_status = deflate(&zs, Z_FINISH);
-                if (zlib_status < 0)
+                const char* in = block;
+                const char* block_end = block + block_size;
+                do
                 {
-                    XTENSOR_THROW(std::runtime_error, "gzip compression failed (" + std::to_string(zlib_status) + ")");
+                    std::size_t in_size = std::min<std::size_t>(UINT_MAX, static_cast<std::size_t>(block_end - in));
+                    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+                    zs.avail_in = static_cast<uInt>(in_size);
+                    in += in_size;
+                    int flush = (last_block && in == block_end) ? Z_FINISH : Z_NO_FLUSH;
+                    do
+                    {
+                        zs.avail_out = GZIP_CHUNK;
+                        zs.next_out = reinterpret_cast<Bytef*>(out);
+                        int zlib_status = deflate(&zs, flush);
+                        if (zlib_status < 0 && zlib_status != Z_BUF_ERROR)
+                        {
+                            XTENSOR_THROW(std::runtime_error, "gzip compression failed (" + std::to_string(zlib_status) + ")");
+                        }
+                        uInt have = GZIP_CHUNK - zs.avail_out;
+                        stream.write(out, static_cast<std::streamsize>(have));
+                    }
+                    while (zs.avail_out == 0);
                 }
-                uInt have = GZIP_CHUNK - zs.avail_out;
-                stream.write(out, static_cast<std::streamsize>(have));
-            }
-            while (zs.avail_out == 0);
+                while (in != block_end);
+            });
             deflateEnd(&zs);
             stream.flush();
         }
@@ -140,20 +580,27 @@ namespace xt
     /**
      * Save xexpression to GZIP format
      *
+     * With several threads, the data is compressed in independent blocks,
+     * written as indexed gzip members. The file remains a standard gzip
+     * file, and load_gzip can inflate the blocks concurrently.
+     *
      * @param stream An output stream to which to dump the data
      * @param e the xexpression
+     * @param as_big_endian whether to store the data in big endian
+     * @param level the compression level
+     * @param nthreads the number of compression threads
      */
     template <typename E, class O>
-    inline void dump_gzip(O& stream, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1)
+    inline void dump_gzip(O& stream, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1, int nthreads=1)
     {
-        detail::dump_gzip(stream, e, as_big_endian, level);
+        detail::dump_gzip(stream, e, as_big_endian, level, nthreads);
     }
 
     template <typename E>
-    inline void dump_gzip(std::ostream& stream, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1)
+    inline void dump_gzip(std::ostream& stream, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1, int nthreads=1)
     {
         auto s = xostream_wrapper(stream);
-        detail::dump_gzip(s, e, as_big_endian, level);
+        detail::dump_gzip(s, e, as_big_endian, level, nthreads);
     }
 
     /**
@@ -163,7 +610,7 @@ namespace xt
      * @param e the xexpression
      */
     template <typename E>
-    inline void dump_gzip(const char* filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1)
+    inline void dump_gzip(const char* filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1, int nthreads=1)
     {
         std::ofstream stream(filename, std::ofstream::binary);
         if (!stream.is_open())
@@ -171,13 +618,13 @@ namespace xt
             std::runtime_error("IO Error: failed to open file");
         }
         auto s = xostream_wrapper(stream);
-        detail::dump_gzip(s, e, as_big_endian, level);
+        detail::dump_gzip(s, e, as_big_endian, level, nthreads);
     }
 
     template <typename E>
-    inline void dump_gzip(const std::string& filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1)
+    inline void dump_gzip(const std::string& filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1, int nthreads=1)
     {
-        dump_gzip<E>(filename.c_str(), e, as_big_endian, level);
+        dump_gzip<E>(filename.c_str(), e, as_big_endian, level, nthreads);
     }
 
     /**
@@ -186,27 +633,32 @@ namespace xt
      * @param e the xexpression
      */
     template <typename E>
-    inline std::string dump_gzip(const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1)
+    inline std::string dump_gzip(const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1, int nthreads=1)
     {
         std::stringstream stream;
         auto s = xostream_wrapper(stream);
-        detail::dump_gzip(s, e, as_big_endian, level);
+        detail::dump_gzip(s, e, as_big_endian, level, nthreads);
         return stream.str();
     }
 
     /**
      * Loads a GZIP file
      *
+     * Files written with several threads are inflated with up to
+     * ``nthreads`` threads.
+     *
      * @param stream An input stream from which to load the file
+     * @param as_big_endian whether the data is stored in big endian
+     * @param nthreads the number of decompression threads
      * @tparam T select the type of the GZIP file
      * @tparam L select layout_type::column_major if you stored data in
      *           Fortran format
      * @return xarray with contents from GZIP file
      */
     template <typename T, layout_type L = layout_type::dynamic, class I>
-    inline auto load_gzip(I& stream, bool as_big_endian=is_big_endian())
+    inline auto load_gzip(I& stream, bool as_big_endian=is_big_endian(), int nthreads=1)
     {
-        xt::svector<T> uncompressed_buffer = detail::load_gzip<T>(stream, as_big_endian);
+        xt::svector<T> uncompressed_buffer = detail::load_gzip<T>(stream, as_big_endian, nthreads);
         std::vector<std::size_t> shape = {uncompressed_buffer.size()};
         auto array = adapt(std::move(uncompressed_buffer), shape);
         return array;
@@ -222,7 +674,7 @@ namespace xt
      * @return xarray with contents from GZIP file
      */
     template <typename T, layout_type L = layout_type::dynamic>
-    inline auto load_gzip(const char* filename, bool as_big_endian=is_big_endian())
+    inline auto load_gzip(const char* filename, bool as_big_endian=is_big_endian(), int nthreads=1)
     {
         std::ifstream stream(filename, std::ifstream::binary);
         if (!stream.is_open())
@@ -230,13 +682,13 @@ namespace xt
             std::runtime_error(std::string("load_gzip: failed to open file ") + filename);
         }
         auto s = xistream_wrapper(stream);
-        return load_gzip<T, L>(s, as_big_endian);
+        return load_gzip<T, L>(s, as_big_endian, nthreads);
     }
 
     template <typename T, layout_type L = layout_type::dynamic>
-    inline auto load_gzip(const std::string& filename, bool as_big_endian=is_big_endian())
+    inline auto load_gzip(const std::string& filename, bool as_big_endian=is_big_endian(), int nthreads=1)
     {
-        return load_gzip<T, L>(filename.c_str(), as_big_endian);
+        return load_gzip<T, L>(filename.c_str(), as_big_endian, nthreads);
     }
 
     struct xio_gzip_config
@@ -245,12 +697,16 @@ namespace xt
         std::string version;
         bool big_endian;
         int level;
+        // number of compression and decompression threads, not saved
+        // with the data
+        int nthreads;
 
         xio_gzip_config()
             : name("gzip")
             , version(ZLIB_VERSION)
             , big_endian(is_big_endian())
             , level(1)
+            , nthreads(1)
         {
         }
 
@@ -266,7 +722,7 @@ namespace xt
             level = j["level"];
         }
 
-        bool will_dump(xfile_dirty dirty)
+        bool will_dump(const xfile_dirty& dirty)
         {
             return dirty.data_dirty;
         }
@@ -277,7 +733,14 @@ namespace xt
     {
         E& ex = e.derived_cast();
         auto shape = ex.shape();
-        ex = load_gzip<typename E::value_type>(stream, config.big_endian);
+        auto* data = detail::decode_destination(ex);
+        if (!shape.empty() && data != nullptr)
+        {
+            // the array already has the expected size
+            detail::load_gzip_into(stream, data, ex.size(), config.big_endian, config.nthreads);
+            return;
+        }
+        ex = load_gzip<typename E::value_type>(stream, config.big_endian, config.nthreads);
         if (!shape.empty())
         {
             if (compute_size(shape) != ex.size())
@@ -291,7 +754,7 @@ namespace xt
     template <class E, class O>
     void dump_file(O& stream, const xexpression<E> &e, const xio_gzip_config& config)
     {
-        dump_gzip(stream, e, config.big_endian, config.level);
+        dump_gzip(stream, e, config.big_endian, config.level, config.nthreads);
     }
 }  // namespace xt
 
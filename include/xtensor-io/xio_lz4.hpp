@@ -0,0 +1,353 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_LZ4_HPP
+#define XTENSOR_IO_LZ4_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+#include "lz4frame.h"
+#include "lz4hc.h"
+
+#include "xtensor/containers/xadapt.hpp"
+#include "xtensor-io.hpp"
+#include "xfile_array.hpp"
+#include "xio_scratch_arena.hpp"
+#include "xio_stream_wrapper.hpp"
+
+namespace xt
+{
+    /**
+     * @struct xio_lz4_config
+     * @brief Configuration of the LZ4 file format.
+     *
+     * Files are stored in the LZ4 frame format, with the size of the data
+     * in the frame header. In fast mode, acceleration trades compression
+     * ratio for speed (1 is the default, larger is faster); in high
+     * compression mode (high_compression set to true), level ranges from
+     * LZ4HC_CLEVEL_MIN to LZ4HC_CLEVEL_MAX. Decompression speed is the
+     * same in both modes.
+     */
+    struct xio_lz4_config
+    {
+        std::string name;
+        std::string version;
+        bool big_endian;
+        bool high_compression;
+        int level;
+        int acceleration;
+
+        xio_lz4_config()
+            : name("lz4")
+            , version(LZ4_VERSION_STRING)
+            , big_endian(is_big_endian())
+            , high_compression(false)
+            , level(LZ4HC_CLEVEL_DEFAULT)
+            , acceleration(1)
+        {
+        }
+
+        template <class T>
+        void write_to(T& j) const
+        {
+            j["high_compression"] = high_compression;
+            j["level"] = level;
+            j["acceleration"] = acceleration;
+        }
+
+        template <class T>
+        void read_from(T& j)
+        {
+            high_compression = j["high_compression"];
+            level = j["level"];
+            acceleration = j["acceleration"];
+        }
+
+        bool will_dump(const xfile_dirty& dirty)
+        {
+            return dirty.data_dirty;
+        }
+    };
+
+    namespace detail
+    {
+        inline void check_lz4(std::size_t res, const char* what)
+        {
+            if (LZ4F_isError(res))
+            {
+                XTENSOR_THROW(std::runtime_error, std::string("LZ4: ") + what + " failed (" + LZ4F_getErrorName(res) + ")");
+            }
+        }
+
+        using lz4_dctx_ptr = std::unique_ptr<LZ4F_dctx, LZ4F_errorCode_t(*)(LZ4F_dctx*)>;
+
+        inline lz4_dctx_ptr make_lz4_dctx()
+        {
+            LZ4F_dctx* dctx = nullptr;
+            check_lz4(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION), "creating context");
+            return lz4_dctx_ptr(dctx, LZ4F_freeDecompressionContext);
+        }
+
+        // Decompresses the frames in [src, src + src_size) into out. When out
+        // is full and more data must be decompressed, grow(nbytes) must return
+        // a larger buffer (and its capacity) holding the first nbytes bytes.
+        // Returns the number of decompressed bytes.
+        template <class G>
+        inline std::size_t lz4_decompress(LZ4F_dctx* dctx, const char* src, std::size_t src_size,
+                                          char* out, std::size_t capacity, G&& grow)
+        {
+            std::size_t nbytes = 0;
+            std::size_t hint = 1;
+            while (src_size != 0 || hint != 0)
+            {
+                std::size_t in_size = src_size;
+                std::size_t out_size = capacity - nbytes;
+                hint = LZ4F_decompress(dctx, out + nbytes, &out_size, src, &in_size, nullptr);
+                check_lz4(hint, "decompression");
+                src += in_size;
+                src_size -= in_size;
+                nbytes += out_size;
+                if (hint != 0 && in_size == 0 && out_size == 0)
+                {
+                    if (nbytes < capacity)
+                    {
+                        XTENSOR_THROW(std::runtime_error, "LZ4: decompression failed (truncated input)");
+                    }
+                    std::tie(out, capacity) = grow(nbytes);
+                }
+            }
+            return nbytes;
+        }
+
+        template <typename T, class I>
+        inline xt::svector<T> load_lz4(I& stream, bool as_big_endian)
+        {
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            auto dctx = make_lz4_dctx();
+            LZ4F_frameInfo_t info;
+            std::size_t header_size = compressed_buffer.size();
+            check_lz4(LZ4F_getFrameInfo(dctx.get(), &info, compressed_buffer.data(), &header_size), "reading frame header");
+            // the content size is optional in the frame format
+            std::size_t size_hint = info.contentSize != 0 ? std::size_t(info.contentSize) : 4 * compressed_buffer.size();
+            xt::svector<T> uncompressed_buffer(std::max<std::size_t>((size_hint + sizeof(T) - 1) / sizeof(T), 1));
+            auto grow = [&uncompressed_buffer](std::size_t)
+            {
+                uncompressed_buffer.resize(2 * uncompressed_buffer.size());
+                return std::make_pair(reinterpret_cast<char*>(uncompressed_buffer.data()), uncompressed_buffer.size() * sizeof(T));
+            };
+            std::size_t nbytes = lz4_decompress(dctx.get(), compressed_buffer.data() + header_size, compressed_buffer.size() - header_size,
+                                                reinterpret_cast<char*>(uncompressed_buffer.data()), uncompressed_buffer.size() * sizeof(T), grow);
+            if (nbytes % sizeof(T) != 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "LZ4: decompression failed (size is not a multiple of the element size)");
+            }
+            uncompressed_buffer.resize(nbytes / sizeof(T));
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+            {
+                swap_endianness(uncompressed_buffer);
+            }
+            return uncompressed_buffer;
+        }
+
+        template <typename T, class I>
+        inline void load_lz4_into(I& stream, T* data, std::size_t size, bool as_big_endian)
+        {
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            auto dctx = make_lz4_dctx();
+            auto grow = [](std::size_t) -> std::pair<char*, std::size_t>
+            {
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            };
+            std::size_t nbytes = lz4_decompress(dctx.get(), compressed_buffer.data(), compressed_buffer.size(),
+                                                reinterpret_cast<char*>(data), size * sizeof(T), grow);
+            if (nbytes != size * sizeof(T))
+            {
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            }
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+            {
+                swap_endianness(data, size);
+            }
+        }
+
+        template <class O, class E>
+        inline void dump_lz4(O& stream, const xexpression<E>& e, const xio_lz4_config& config)
+        {
+            using value_type = typename E::value_type;
+            const E& ex = e.derived_cast();
+            auto&& eval_ex = eval(ex);
+            auto shape = eval_ex.shape();
+            std::size_t size = compute_size(shape);
+            std::size_t uncompressed_size = size * sizeof(value_type);
+            const char* uncompressed_buffer;
+            xscratch_arena::buffer swapped_buffer;
+            if ((sizeof(value_type) > 1) && (config.big_endian != is_big_endian()))
+            {
+                swapped_buffer = scratch_arena().acquire(uncompressed_size);
+                copy_swap_endianness(eval_ex.data(), size, reinterpret_cast<value_type*>(swapped_buffer.data()));
+                uncompressed_buffer = swapped_buffer.data();
+            }
+            else
+            {
+                uncompressed_buffer = reinterpret_cast<const char*>(eval_ex.data());
+            }
+
+            LZ4F_preferences_t prefs;
+            std::memset(&prefs, 0, sizeof(prefs));
+            prefs.frameInfo.contentSize = uncompressed_size;
+            // in the frame API, negative levels select the acceleration of
+            // the fast mode, and levels from LZ4HC_CLEVEL_MIN the HC mode
+            if (config.high_compression)
+            {
+                prefs.compressionLevel = std::max(config.level, LZ4HC_CLEVEL_MIN);
+            }
+            else
+            {
+                prefs.compressionLevel = config.acceleration > 1 ? -config.acceleration : 0;
+            }
+
+            std::size_t max_compressed_size = LZ4F_compressFrameBound(uncompressed_size, &prefs);
+            auto compressed_buffer = scratch_arena().acquire(max_compressed_size);
+            std::size_t compressed_size = LZ4F_compressFrame(compressed_buffer.data(), max_compressed_size, uncompressed_buffer, uncompressed_size, &prefs);
+            check_lz4(compressed_size, "compression");
+            stream.write(compressed_buffer.data(), std::streamsize(compressed_size));
+            stream.flush();
+        }
+    }  // namespace detail
+
+    /**
+     * Save xexpression to LZ4 format
+     *
+     * @param stream An output stream to which to dump the data
+     * @param e the xexpression
+     * @param config the compression settings
+     */
+    template <typename E, class O>
+    inline void dump_lz4(O& stream, const xexpression<E>& e, const xio_lz4_config& config = xio_lz4_config())
+    {
+        detail::dump_lz4(stream, e, config);
+    }
+
+    template <typename E>
+    inline void dump_lz4(std::ostream& stream, const xexpression<E>& e, const xio_lz4_config& config = xio_lz4_config())
+    {
+        auto s = xostream_wrapper(stream);
+        detail::dump_lz4(s, e, config);
+    }
+
+    /**
+     * Save xexpression to LZ4 format
+     *
+     * @param filename The filename or path to dump the data
+     * @param e the xexpression
+     * @param config the compression settings
+     */
+    template <typename E>
+    inline void dump_lz4(const char* filename, const xexpression<E>& e, const xio_lz4_config& config = xio_lz4_config())
+    {
+        std::ofstream stream(filename, std::ofstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("LZ4: failed to open file ") + filename);
+        }
+        auto s = xostream_wrapper(stream);
+        detail::dump_lz4(s, e, config);
+    }
+
+    template <typename E>
+    inline void dump_lz4(const std::string& filename, const xexpression<E>& e, const xio_lz4_config& config = xio_lz4_config())
+    {
+        dump_lz4<E>(filename.c_str(), e, config);
+    }
+
+    /**
+     * Loads a LZ4 file
+     *
+     * @param stream An input stream from which to load the file
+     * @tparam T select the type of the LZ4 file
+     * @tparam L select layout_type::column_major if you stored data in
+     *           Fortran format
+     * @return xarray with contents from LZ4 file
+     */
+    template <typename T, layout_type L = layout_type::dynamic, class I>
+    inline auto load_lz4(I& stream, bool as_big_endian=is_big_endian())
+    {
+        xt::svector<T> uncompressed_buffer = detail::load_lz4<T>(stream, as_big_endian);
+        std::vector<std::size_t> shape = {uncompressed_buffer.size()};
+        auto array = adapt(std::move(uncompressed_buffer), shape);
+        return array;
+    }
+
+    /**
+     * Loads a LZ4 file
+     *
+     * @param filename The filename or path to the file
+     * @tparam T select the type of the LZ4 file
+     * @tparam L select layout_type::column_major if you stored data in
+     *           Fortran format
+     * @return xarray with contents from LZ4 file
+     */
+    template <typename T, layout_type L = layout_type::dynamic>
+    inline auto load_lz4(const char* filename, bool as_big_endian=is_big_endian())
+    {
+        std::ifstream stream(filename, std::ifstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("LZ4: failed to open file ") + filename);
+        }
+        auto s = xistream_wrapper(stream);
+        return load_lz4<T, L>(s, as_big_endian);
+    }
+
+    template <typename T, layout_type L = layout_type::dynamic>
+    inline auto load_lz4(const std::string& filename, bool as_big_endian=is_big_endian())
+    {
+        return load_lz4<T, L>(filename.c_str(), as_big_endian);
+    }
+
+    template <class E, class I>
+    void load_file(I& stream, xexpression<E>& e, const xio_lz4_config& config)
+    {
+        E& ex = e.derived_cast();
+        auto shape = ex.shape();
+        auto* data = detail::decode_destination(ex);
+        if (!shape.empty() && data != nullptr)
+        {
+            // the array already has the expected size
+            detail::load_lz4_into(stream, data, ex.size(), config.big_endian);
+            return;
+        }
+        ex = load_lz4<typename E::value_type>(stream, config.big_endian);
+        if (!shape.empty())
+        {
+            if (compute_size(shape) != ex.size())
+            {
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            }
+            ex.reshape(shape);
+        }
+    }
+
+    template <class E, class O>
+    void dump_file(O& stream, const xexpression<E> &e, const xio_lz4_config& config)
+    {
+        dump_lz4(stream, e, config);
+    }
+}  // namespace xt
+
+#endif
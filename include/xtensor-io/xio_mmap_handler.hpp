@@ -0,0 +1,609 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_MMAP_HANDLER_HPP
+#define XTENSOR_IO_MMAP_HANDLER_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <xtensor/containers/xarray.hpp>
+#include <xtensor/core/xexpression.hpp>
+
+#include "xtensor-io.hpp"
+#include "xfile_array.hpp"
+#include "xio_binary.hpp"
+#include "xio_disk_handler.hpp"
+
+namespace xt
+{
+    /**
+     * @class xmmap_buffer
+     * @brief Contiguous buffer which can hold a memory-mapped file.
+     *
+     * The buffer either owns memory allocated on the heap, or a mapping of
+     * a file. Modifications of the elements of a shared mapping go to the
+     * page cache, while a read-only file is mapped privately (copy on
+     * write). Copies are always held in memory.
+     *
+     * @tparam T The type of the elements, which must be trivially copyable
+     */
+    template <class T>
+    class xmmap_buffer
+    {
+    public:
+
+        static_assert(std::is_trivially_copyable<T>::value, "xmmap_buffer requires trivially copyable elements");
+
+        using value_type = T;
+        using allocator_type = std::allocator<T>;
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using pointer = T*;
+        using const_pointer = const T*;
+        using iterator = pointer;
+        using const_iterator = const_pointer;
+        using reverse_iterator = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        xmmap_buffer() noexcept = default;
+        explicit xmmap_buffer(size_type size);
+        xmmap_buffer(size_type size, const_reference value);
+        ~xmmap_buffer();
+
+        xmmap_buffer(const xmmap_buffer& rhs);
+        xmmap_buffer& operator=(const xmmap_buffer& rhs);
+
+        xmmap_buffer(xmmap_buffer&& rhs) noexcept;
+        xmmap_buffer& operator=(xmmap_buffer&& rhs) noexcept;
+
+        bool empty() const noexcept;
+        size_type size() const noexcept;
+        void resize(size_type size);
+
+        reference operator[](size_type i);
+        const_reference operator[](size_type i) const;
+
+        reference front();
+        const_reference front() const;
+        reference back();
+        const_reference back() const;
+
+        pointer data() noexcept;
+        const_pointer data() const noexcept;
+
+        iterator begin() noexcept;
+        iterator end() noexcept;
+        const_iterator begin() const noexcept;
+        const_iterator end() const noexcept;
+        const_iterator cbegin() const noexcept;
+        const_iterator cend() const noexcept;
+
+        reverse_iterator rbegin() noexcept;
+        reverse_iterator rend() noexcept;
+        const_reverse_iterator rbegin() const noexcept;
+        const_reverse_iterator rend() const noexcept;
+        const_reverse_iterator crbegin() const noexcept;
+        const_reverse_iterator crend() const noexcept;
+
+        void swap(xmmap_buffer& rhs) noexcept;
+
+        void map(const std::string& path);
+        void unmap();
+        void sync() const;
+        bool is_mapped() const noexcept;
+        bool is_shared() const noexcept;
+        const std::string& mapped_path() const noexcept;
+
+    private:
+
+        void release() noexcept;
+
+        pointer p_data = nullptr;
+        size_type m_size = 0;
+        size_type m_mapped_bytes = 0;
+        bool m_shared = false;
+        std::string m_path;
+    };
+
+    template <class T>
+    void swap(xmmap_buffer<T>& lhs, xmmap_buffer<T>& rhs) noexcept;
+
+    /**
+     * @class xio_mmap_handler
+     * @brief IO handler mapping binary files in memory.
+     *
+     * Reading a file maps it in the storage of the array instead of copying
+     * its content, and writing the array back to the same file only
+     * synchronizes the mapping with msync. Read-only files are mapped
+     * privately, and can be modified in memory only. Files which are not in the native
+     * endianness, or arrays which are not mapped, are read and written
+     * like with xio_disk_handler<xio_binary_config>. Only available on POSIX
+     * systems.
+     *
+     * @sa xmmap_file_array
+     */
+    class xio_mmap_handler
+    {
+    public:
+
+        using format_config = xio_binary_config;
+        using io_config = xio_disk_config;
+
+        template <class E>
+        void write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty);
+
+        template <class ET>
+        void read(ET& array, const std::string& path);
+
+        template <class ET>
+        bool try_read(ET& array, const std::string& path);
+
+        void configure(const xio_binary_config& format_config, const xio_disk_config& io_config);
+        void configure_io(const xio_disk_config& io_config);
+
+    private:
+
+        xio_binary_config m_format_config;
+        xio_disk_handler<xio_binary_config> m_disk_handler;
+    };
+
+    /**
+     * File-backed array whose storage is the memory mapping of the file,
+     * in the native binary format.
+     */
+    template <class T, layout_type L = XTENSOR_DEFAULT_LAYOUT>
+    using xmmap_file_array = xfile_array_container<xarray_container<xmmap_buffer<T>, L, svector<typename xmmap_buffer<T>::size_type, 4>>,
+                                                   xio_mmap_handler>;
+
+    /*******************************
+     * xmmap_buffer implementation *
+     *******************************/
+
+    template <class T>
+    inline xmmap_buffer<T>::xmmap_buffer(size_type size)
+        : p_data(size != 0 ? new T[size]() : nullptr)
+        , m_size(size)
+    {
+    }
+
+    template <class T>
+    inline xmmap_buffer<T>::xmmap_buffer(size_type size, const_reference value)
+        : xmmap_buffer(size)
+    {
+        std::fill(begin(), end(), value);
+    }
+
+    template <class T>
+    inline xmmap_buffer<T>::~xmmap_buffer()
+    {
+        release();
+    }
+
+    template <class T>
+    inline xmmap_buffer<T>::xmmap_buffer(const xmmap_buffer& rhs)
+        : xmmap_buffer(rhs.m_size)
+    {
+        std::copy(rhs.begin(), rhs.end(), begin());
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::operator=(const xmmap_buffer& rhs) -> xmmap_buffer&
+    {
+        xmmap_buffer tmp(rhs);
+        swap(tmp);
+        return *this;
+    }
+
+    template <class T>
+    inline xmmap_buffer<T>::xmmap_buffer(xmmap_buffer&& rhs) noexcept
+        : p_data(std::exchange(rhs.p_data, nullptr))
+        , m_size(std::exchange(rhs.m_size, 0))
+        , m_mapped_bytes(std::exchange(rhs.m_mapped_bytes, 0))
+        , m_shared(std::exchange(rhs.m_shared, false))
+        , m_path(std::move(rhs.m_path))
+    {
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::operator=(xmmap_buffer&& rhs) noexcept -> xmmap_buffer&
+    {
+        xmmap_buffer tmp(std::move(rhs));
+        swap(tmp);
+        return *this;
+    }
+
+    template <class T>
+    inline bool xmmap_buffer<T>::empty() const noexcept
+    {
+        return m_size == 0;
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::size() const noexcept -> size_type
+    {
+        return m_size;
+    }
+
+    /**
+     * Resizes the buffer. The content is not preserved, and a mapped
+     * buffer is unmapped if the size changes.
+     */
+    template <class T>
+    inline void xmmap_buffer<T>::resize(size_type size)
+    {
+        if (size != m_size)
+        {
+            xmmap_buffer tmp(size);
+            swap(tmp);
+        }
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::operator[](size_type i) -> reference
+    {
+        return p_data[i];
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::operator[](size_type i) const -> const_reference
+    {
+        return p_data[i];
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::front() -> reference
+    {
+        return p_data[0];
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::front() const -> const_reference
+    {
+        return p_data[0];
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::back() -> reference
+    {
+        return p_data[m_size - 1];
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::back() const -> const_reference
+    {
+        return p_data[m_size - 1];
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::data() noexcept -> pointer
+    {
+        return p_data;
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::data() const noexcept -> const_pointer
+    {
+        return p_data;
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::begin() noexcept -> iterator
+    {
+        return p_data;
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::end() noexcept -> iterator
+    {
+        return p_data + m_size;
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::begin() const noexcept -> const_iterator
+    {
+        return p_data;
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::end() const noexcept -> const_iterator
+    {
+        return p_data + m_size;
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::cbegin() const noexcept -> const_iterator
+    {
+        return begin();
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::cend() const noexcept -> const_iterator
+    {
+        return end();
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::rbegin() noexcept -> reverse_iterator
+    {
+        return reverse_iterator(end());
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::rend() noexcept -> reverse_iterator
+    {
+        return reverse_iterator(begin());
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::rbegin() const noexcept -> const_reverse_iterator
+    {
+        return const_reverse_iterator(end());
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::rend() const noexcept -> const_reverse_iterator
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::crbegin() const noexcept -> const_reverse_iterator
+    {
+        return rbegin();
+    }
+
+    template <class T>
+    inline auto xmmap_buffer<T>::crend() const noexcept -> const_reverse_iterator
+    {
+        return rend();
+    }
+
+    template <class T>
+    inline void xmmap_buffer<T>::swap(xmmap_buffer& rhs) noexcept
+    {
+        std::swap(p_data, rhs.p_data);
+        std::swap(m_size, rhs.m_size);
+        std::swap(m_mapped_bytes, rhs.m_mapped_bytes);
+        std::swap(m_shared, rhs.m_shared);
+        std::swap(m_path, rhs.m_path);
+    }
+
+    /**
+     * Replaces the content of the buffer with a mapping of a file. The
+     * size of the buffer becomes the number of elements in the file.
+     * The mapping is shared with the file, unless the file cannot be
+     * written, in which case it is private.
+     *
+     * @param path The path to the file
+     */
+    template <class T>
+    inline void xmmap_buffer<T>::map(const std::string& path)
+    {
+        bool shared = true;
+        int fd = ::open(path.c_str(), O_RDWR);
+        if (fd < 0 && (errno == EACCES || errno == EROFS || errno == EPERM))
+        {
+            shared = false;
+            fd = ::open(path.c_str(), O_RDONLY);
+        }
+        if (fd < 0)
+        {
+            XTENSOR_THROW(std::runtime_error, "mmap: failed to open file " + path);
+        }
+        struct stat file_stat;
+        if (::fstat(fd, &file_stat) != 0)
+        {
+            ::close(fd);
+            XTENSOR_THROW(std::runtime_error, "mmap: failed to stat file " + path);
+        }
+        size_type file_size = static_cast<size_type>(file_stat.st_size);
+        if (file_size % sizeof(T) != 0)
+        {
+            ::close(fd);
+            XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+        }
+        size_type size = file_size / sizeof(T);
+        if (size == 0)
+        {
+            ::close(fd);
+            xmmap_buffer tmp;
+            swap(tmp);
+            return;
+        }
+        size_type bytes = size * sizeof(T);
+        void* address = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        // the mapping stays valid after the file is closed
+        ::close(fd);
+        if (address == MAP_FAILED)
+        {
+            XTENSOR_THROW(std::runtime_error, "mmap: failed to map file " + path);
+        }
+        release();
+        p_data = static_cast<pointer>(address);
+        m_size = size;
+        m_mapped_bytes = bytes;
+        m_shared = shared;
+        m_path = path;
+    }
+
+    /**
+     * Releases the mapping of the file, if any. The buffer keeps its size,
+     * but its content is not preserved.
+     */
+    template <class T>
+    inline void xmmap_buffer<T>::unmap()
+    {
+        if (is_mapped())
+        {
+            xmmap_buffer tmp(m_size);
+            swap(tmp);
+        }
+    }
+
+    /**
+     * Writes the modified pages of a shared mapping to the file.
+     */
+    template <class T>
+    inline void xmmap_buffer<T>::sync() const
+    {
+        if (is_shared() && ::msync(static_cast<void*>(p_data), m_mapped_bytes, MS_SYNC) != 0)
+        {
+            XTENSOR_THROW(std::runtime_error, "mmap: failed to sync file " + m_path);
+        }
+    }
+
+    template <class T>
+    inline bool xmmap_buffer<T>::is_mapped() const noexcept
+    {
+        return m_mapped_bytes != 0;
+    }
+
+    /**
+     * Returns true if the modifications of the elements go to the mapped file.
+     */
+    template <class T>
+    inline bool xmmap_buffer<T>::is_shared() const noexcept
+    {
+        return is_mapped() && m_shared;
+    }
+
+    template <class T>
+    inline const std::string& xmmap_buffer<T>::mapped_path() const noexcept
+    {
+        return m_path;
+    }
+
+    template <class T>
+    inline void xmmap_buffer<T>::release() noexcept
+    {
+        if (is_mapped())
+        {
+            ::munmap(static_cast<void*>(p_data), m_mapped_bytes);
+        }
+        else
+        {
+            delete[] p_data;
+        }
+        p_data = nullptr;
+        m_size = 0;
+        m_mapped_bytes = 0;
+        m_shared = false;
+        m_path.clear();
+    }
+
+    template <class T>
+    inline void swap(xmmap_buffer<T>& lhs, xmmap_buffer<T>& rhs) noexcept
+    {
+        lhs.swap(rhs);
+    }
+
+    /***********************************
+     * xio_mmap_handler implementation *
+     ***********************************/
+
+    namespace detail
+    {
+        template <class E>
+        inline bool sync_mapped(const xexpression<E>&, const std::string&)
+        {
+            return false;
+        }
+
+        template <class T, layout_type L, class SC, class Tag>
+        inline bool sync_mapped(const xexpression<xarray_container<xmmap_buffer<T>, L, SC, Tag>>& e, const std::string& path)
+        {
+            const auto& storage = e.derived_cast().storage();
+            // a private mapping is written like an array in memory
+            if (storage.is_shared() && storage.mapped_path() == path)
+            {
+                storage.sync();
+                return true;
+            }
+            return false;
+        }
+    }
+
+    template <class E>
+    inline void xio_mmap_handler::write(const xexpression<E>& expression, const std::string& path, const xfile_dirty& dirty)
+    {
+        if (m_format_config.will_dump(dirty) && !detail::sync_mapped(expression, path))
+        {
+            m_disk_handler.write(expression, path, dirty);
+        }
+    }
+
+    template <class ET>
+    inline void xio_mmap_handler::read(ET& array, const std::string& path)
+    {
+        auto& storage = array.storage();
+        // the previous file must not be modified through the mapping
+        storage.unmap();
+        if ((sizeof(typename ET::value_type) > 1) && (m_format_config.big_endian != is_big_endian()))
+        {
+            m_disk_handler.read(array, path);
+            return;
+        }
+        auto shape = array.shape();
+        storage.map(path);
+        if (!shape.empty())
+        {
+            std::size_t size = compute_size(shape);
+            if (size != storage.size())
+            {
+                storage.resize(size);
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            }
+        }
+        else
+        {
+            array.resize({storage.size()});
+        }
+    }
+
+    template <class ET>
+    inline bool xio_mmap_handler::try_read(ET& array, const std::string& path)
+    {
+        // the previous file must not be modified through the mapping
+        array.storage().unmap();
+        struct stat file_stat;
+        if (::stat(path.c_str(), &file_stat) != 0)
+        {
+            return false;
+        }
+        read(array, path);
+        return true;
+    }
+
+    inline void xio_mmap_handler::configure(const xio_binary_config& format_config, const xio_disk_config& io_config)
+    {
+        m_format_config = format_config;
+        m_disk_handler.configure(format_config, io_config);
+    }
+
+    inline void xio_mmap_handler::configure_io(const xio_disk_config& io_config)
+    {
+        m_disk_handler.configure_io(io_config);
+    }
+}
+
+#endif
@@ -0,0 +1,311 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_SCRATCH_ARENA_HPP
+#define XTENSOR_IO_SCRATCH_ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace xt
+{
+    /**
+     * @struct xscratch_stats
+     * @brief Statistics of a scratch arena.
+     *
+     * A buffer is counted as an allocation when it had to be (re)allocated
+     * to fit the requested size, and as a reuse when a cached buffer was
+     * large enough.
+     */
+    struct xscratch_stats
+    {
+        std::size_t allocations = 0;
+        std::size_t reuses = 0;
+        std::size_t bytes_allocated = 0;
+        std::size_t bytes_reused = 0;
+    };
+
+    /**
+     * @class xscratch_arena
+     * @brief Cache of temporary buffers used by the codecs.
+     *
+     * Compressing or decompressing a chunk requires temporary buffers
+     * (compressed bytes, byte-swapped copies) whose size is usually the
+     * same from one chunk to the next. The arena keeps released buffers
+     * so that they can be reused by the next acquisition instead of being
+     * freed and allocated again.
+     *
+     * An arena is not thread-safe; the codecs use the arena of the calling
+     * thread, returned by scratch_arena().
+     */
+    class xscratch_arena
+    {
+    public:
+
+        class buffer;
+
+        explicit xscratch_arena(std::size_t max_buffers = 4);
+
+        buffer acquire(std::size_t size = 0);
+
+        const xscratch_stats& stats() const noexcept;
+        void reset_stats() noexcept;
+
+        std::size_t cached_buffers() const noexcept;
+        std::size_t cached_bytes() const noexcept;
+        void release();
+
+    private:
+
+        std::string take(std::size_t size);
+        void recycle(std::string&& storage, std::size_t initial_capacity);
+
+        std::vector<std::string> m_free;
+        std::size_t m_max_buffers;
+        xscratch_stats m_stats;
+    };
+
+    /**
+     * @class xscratch_arena::buffer
+     * @brief Buffer borrowed from a scratch arena.
+     *
+     * The buffer is given back to its arena when it is destroyed. It can
+     * be resized, or filled with the read_all method of a stream wrapper
+     * through str(); the arena keeps the grown storage.
+     */
+    class xscratch_arena::buffer
+    {
+    public:
+
+        buffer() = default;
+        ~buffer();
+
+        buffer(const buffer&) = delete;
+        buffer& operator=(const buffer&) = delete;
+
+        buffer(buffer&& rhs) noexcept;
+        buffer& operator=(buffer&& rhs) noexcept;
+
+        char* data() noexcept;
+        const char* data() const noexcept;
+        std::size_t size() const noexcept;
+        void resize(std::size_t size);
+
+        std::string& str() noexcept;
+
+    private:
+
+        buffer(xscratch_arena* arena, std::string&& storage);
+
+        void give_back();
+
+        xscratch_arena* p_arena = nullptr;
+        std::string m_storage;
+        std::size_t m_initial_capacity = 0;
+
+        friend class xscratch_arena;
+    };
+
+    xscratch_arena& scratch_arena();
+
+    /*********************************
+     * xscratch_arena implementation *
+     *********************************/
+
+    inline xscratch_arena::xscratch_arena(std::size_t max_buffers)
+        : m_max_buffers(max_buffers)
+    {
+    }
+
+    /**
+     * Returns a buffer of the given size, reusing a cached buffer if
+     * possible. The content of the buffer is unspecified. When the final
+     * size is not known (e.g. the buffer is filled by read_all), pass 0
+     * to get the largest cached buffer.
+     * @param size the size of the buffer, in bytes
+     */
+    inline auto xscratch_arena::acquire(std::size_t size) -> buffer
+    {
+        buffer res(this, take(size));
+        res.resize(size);
+        return res;
+    }
+
+    /**
+     * Returns the statistics of the arena.
+     */
+    inline const xscratch_stats& xscratch_arena::stats() const noexcept
+    {
+        return m_stats;
+    }
+
+    inline void xscratch_arena::reset_stats() noexcept
+    {
+        m_stats = xscratch_stats();
+    }
+
+    inline std::size_t xscratch_arena::cached_buffers() const noexcept
+    {
+        return m_free.size();
+    }
+
+    inline std::size_t xscratch_arena::cached_bytes() const noexcept
+    {
+        std::size_t res = 0;
+        for (const auto& s: m_free)
+        {
+            res += s.capacity();
+        }
+        return res;
+    }
+
+    /**
+     * Frees the cached buffers.
+     */
+    inline void xscratch_arena::release()
+    {
+        m_free.clear();
+        m_free.shrink_to_fit();
+    }
+
+    inline std::string xscratch_arena::take(std::size_t size)
+    {
+        std::string res;
+        if (!m_free.empty())
+        {
+            // smallest buffer large enough, or the largest one otherwise
+            auto it = std::min_element(m_free.begin(), m_free.end(), [size](const std::string& lhs, const std::string& rhs)
+            {
+                bool lhs_fits = size != 0 && lhs.capacity() >= size;
+                bool rhs_fits = size != 0 && rhs.capacity() >= size;
+                if (lhs_fits != rhs_fits)
+                {
+                    return lhs_fits;
+                }
+                return lhs_fits ? lhs.capacity() < rhs.capacity() : lhs.capacity() > rhs.capacity();
+            });
+            res = std::move(*it);
+            m_free.erase(it);
+        }
+        return res;
+    }
+
+    inline void xscratch_arena::recycle(std::string&& storage, std::size_t initial_capacity)
+    {
+        if (storage.capacity() > initial_capacity)
+        {
+            ++m_stats.allocations;
+            m_stats.bytes_allocated += storage.capacity();
+        }
+        else
+        {
+            ++m_stats.reuses;
+            m_stats.bytes_reused += storage.size();
+        }
+        if (m_free.size() < m_max_buffers)
+        {
+            m_free.push_back(std::move(storage));
+        }
+        else
+        {
+            // keep the largest buffers
+            auto it = std::min_element(m_free.begin(), m_free.end(), [](const std::string& lhs, const std::string& rhs)
+            {
+                return lhs.capacity() < rhs.capacity();
+            });
+            if (it != m_free.end() && it->capacity() < storage.capacity())
+            {
+                *it = std::move(storage);
+            }
+        }
+    }
+
+    /*****************************************
+     * xscratch_arena::buffer implementation *
+     *****************************************/
+
+    inline xscratch_arena::buffer::buffer(xscratch_arena* arena, std::string&& storage)
+        : p_arena(arena)
+        , m_storage(std::move(storage))
+        , m_initial_capacity(m_storage.capacity())
+    {
+    }
+
+    inline xscratch_arena::buffer::~buffer()
+    {
+        give_back();
+    }
+
+    inline xscratch_arena::buffer::buffer(buffer&& rhs) noexcept
+        : p_arena(std::exchange(rhs.p_arena, nullptr))
+        , m_storage(std::move(rhs.m_storage))
+        , m_initial_capacity(rhs.m_initial_capacity)
+    {
+    }
+
+    inline auto xscratch_arena::buffer::operator=(buffer&& rhs) noexcept -> buffer&
+    {
+        if (this != &rhs)
+        {
+            give_back();
+            p_arena = std::exchange(rhs.p_arena, nullptr);
+            m_storage = std::move(rhs.m_storage);
+            m_initial_capacity = rhs.m_initial_capacity;
+        }
+        return *this;
+    }
+
+    inline char* xscratch_arena::buffer::data() noexcept
+    {
+        return &m_storage[0];
+    }
+
+    inline const char* xscratch_arena::buffer::data() const noexcept
+    {
+        return m_storage.data();
+    }
+
+    inline std::size_t xscratch_arena::buffer::size() const noexcept
+    {
+        return m_storage.size();
+    }
+
+    inline void xscratch_arena::buffer::resize(std::size_t size)
+    {
+        m_storage.resize(size);
+    }
+
+    inline std::string& xscratch_arena::buffer::str() noexcept
+    {
+        return m_storage;
+    }
+
+    inline void xscratch_arena::buffer::give_back()
+    {
+        if (p_arena != nullptr)
+        {
+            p_arena->recycle(std::move(m_storage), m_initial_capacity);
+            p_arena = nullptr;
+        }
+    }
+
+    /**
+     * Returns the scratch arena of the calling thread.
+     */
+    inline xscratch_arena& scratch_arena()
+    {
+        thread_local xscratch_arena arena;
+        return arena;
+    }
+}
+
+#endif
@@ -24,7 +24,14 @@ namespace xt
 
     inline xistream_wrapper&  xistream_wrapper::read_all(std::string& s)
     {
-        s = {std::istreambuf_iterator<char>{m_stream}, {}};
+        // keeps the capacity of s, which may be a reused buffer
+        s.clear();
+        char buffer[4096];
+        std::streamsize n;
+        while ((n = m_stream.rdbuf()->sgetn(buffer, sizeof(buffer))) > 0)
+        {
+            s.append(buffer, static_cast<std::size_t>(n));
+        }
         return *this;
     }
 
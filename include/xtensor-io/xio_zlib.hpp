@@ -10,21 +10,64 @@
 #ifndef XTENSOR_IO_ZLIB_HPP
 #define XTENSOR_IO_ZLIB_HPP
 
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <vector>
 
 #include "zlib.h"
 
 #include "xtensor/containers/xadapt.hpp"
 #include "xtensor-io.hpp"
 #include "xfile_array.hpp"
+#include "xio_scratch_arena.hpp"
 #include "xio_stream_wrapper.hpp"
 
 #ifndef ZLIB_CHUNK
 #define ZLIB_CHUNK 0x4000
 #endif
 
+#ifndef ZLIB_INDEX_SPAN
+#define ZLIB_INDEX_SPAN 0x100000
+#endif
+
 namespace xt
 {
+    /**
+     * @struct xzlib_access_point
+     * @brief Position in a zlib stream from which inflating can start.
+     *
+     * The window holds the uncompressed data preceding the point, which
+     * the following data may refer to. It is empty for the points written
+     * by dump_zlib, where the stream is fully flushed.
+     */
+    struct xzlib_access_point
+    {
+        // offset in the uncompressed data
+        std::size_t out;
+        // offset of the first complete byte in the compressed stream
+        std::size_t in;
+        // number of bits of the previous byte that belong to the point
+        int bits;
+        std::string window;
+    };
+
+    /**
+     * @struct xzlib_index
+     * @brief Access points of a zlib stream, for random access.
+     */
+    struct xzlib_index
+    {
+        std::size_t compressed_size = 0;
+        std::size_t uncompressed_size = 0;
+        // checksum of the uncompressed data, stored at the end of the stream
+        std::uint32_t adler32 = 0;
+        std::vector<xzlib_access_point> points;
+    };
+
     namespace detail
     {
         inline std::string zlib_err(int ret)
@@ -44,8 +87,287 @@ namespace xt
             }
         }
 
+        constexpr std::size_t zlib_window_size = std::size_t(1) << MAX_WBITS;
+        constexpr char zlib_index_magic[4] = {'X', 'Z', 'I', '2'};
+
+        inline void write_zlib_index_value(std::ostream& stream, std::uint64_t value)
+        {
+            char buf[8];
+            for (std::size_t i = 0; i < 8; ++i)
+            {
+                buf[i] = static_cast<char>(value >> (8 * i));
+            }
+            stream.write(buf, 8);
+        }
+
+        inline std::uint64_t read_zlib_index_value(std::istream& stream)
+        {
+            unsigned char buf[8] = {0};
+            stream.read(reinterpret_cast<char*>(buf), 8);
+            std::uint64_t value = 0;
+            for (std::size_t i = 0; i < 8; ++i)
+            {
+                value |= std::uint64_t(buf[i]) << (8 * i);
+            }
+            return value;
+        }
+
+        inline void write_zlib_index(std::ostream& stream, const xzlib_index& index)
+        {
+            stream.write(zlib_index_magic, sizeof(zlib_index_magic));
+            write_zlib_index_value(stream, index.compressed_size);
+            write_zlib_index_value(stream, index.uncompressed_size);
+            write_zlib_index_value(stream, index.adler32);
+            write_zlib_index_value(stream, index.points.size());
+            for (const auto& point: index.points)
+            {
+                write_zlib_index_value(stream, point.out);
+                write_zlib_index_value(stream, point.in);
+                write_zlib_index_value(stream, static_cast<std::uint64_t>(point.bits));
+                write_zlib_index_value(stream, point.window.size());
+                stream.write(point.window.data(), static_cast<std::streamsize>(point.window.size()));
+            }
+        }
+
+        // Returns false if the stream doesn't hold a valid index.
+        inline bool read_zlib_index(std::istream& stream, xzlib_index& index)
+        {
+            char magic[sizeof(zlib_index_magic)] = {0};
+            stream.read(magic, sizeof(magic));
+            if (!stream || !std::equal(magic, magic + sizeof(magic), zlib_index_magic))
+            {
+                return false;
+            }
+            index.compressed_size = read_zlib_index_value(stream);
+            index.uncompressed_size = read_zlib_index_value(stream);
+            index.adler32 = static_cast<std::uint32_t>(read_zlib_index_value(stream));
+            std::uint64_t nb_points = read_zlib_index_value(stream);
+            index.points.clear();
+            for (std::uint64_t i = 0; i < nb_points && stream; ++i)
+            {
+                xzlib_access_point point;
+                point.out = read_zlib_index_value(stream);
+                point.in = read_zlib_index_value(stream);
+                point.bits = static_cast<int>(read_zlib_index_value(stream));
+                std::uint64_t window_size = read_zlib_index_value(stream);
+                if (!stream || point.bits > 7 || window_size > zlib_window_size)
+                {
+                    return false;
+                }
+                point.window.resize(window_size);
+                stream.read(&point.window[0], static_cast<std::streamsize>(window_size));
+                index.points.push_back(std::move(point));
+            }
+            return bool(stream) && !index.points.empty();
+        }
+
+        // Reads the adler32 checksum at the end of a ZLIB stream of the
+        // given size, and leaves the stream at its start.
+        inline std::uint32_t read_zlib_trailer(std::istream& stream, std::size_t size)
+        {
+            unsigned char buf[4] = {0};
+            if (size >= sizeof(buf))
+            {
+                stream.seekg(static_cast<std::streamoff>(size - sizeof(buf)));
+                stream.read(reinterpret_cast<char*>(buf), sizeof(buf));
+            }
+            stream.clear();
+            stream.seekg(0);
+            return (std::uint32_t(buf[0]) << 24) | (std::uint32_t(buf[1]) << 16) | (std::uint32_t(buf[2]) << 8) | std::uint32_t(buf[3]);
+        }
+
+        template <typename T>
+        inline xt::svector<T> load_zlib_range(std::istream& stream, const xzlib_index& index, std::size_t offset, std::size_t count, bool as_big_endian)
+        {
+            std::size_t nb_elements = index.uncompressed_size / sizeof(T);
+            if (offset > nb_elements || count > nb_elements - offset)
+            {
+                XTENSOR_THROW(std::runtime_error, "load_zlib_range: range out of bounds");
+            }
+            std::size_t begin = offset * sizeof(T);
+            std::size_t nbytes = count * sizeof(T);
+            xt::svector<T> uncompressed_buffer(count);
+            if (nbytes == 0)
+            {
+                return uncompressed_buffer;
+            }
+            // last access point before the range
+            auto point = std::upper_bound(index.points.cbegin(), index.points.cend(), begin,
+                                          [](std::size_t value, const xzlib_access_point& p) { return value < p.out; });
+            if (point == index.points.cbegin())
+            {
+                XTENSOR_THROW(std::runtime_error, "load_zlib_range: invalid index");
+            }
+            --point;
+
+            z_stream strm;
+            strm.zalloc = Z_NULL;
+            strm.zfree = Z_NULL;
+            strm.opaque = Z_NULL;
+            strm.avail_in = 0;
+            strm.next_in = Z_NULL;
+            int ret = inflateInit2(&strm, -MAX_WBITS);
+            if (ret != Z_OK)
+            {
+                XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + zlib_err(ret) + ")");
+            }
+            stream.clear();
+            stream.seekg(static_cast<std::streamoff>(point->in - (point->bits != 0 ? 1 : 0)));
+            if (point->bits != 0)
+            {
+                int c = stream.get();
+                if (c == std::char_traits<char>::eof())
+                {
+                    static_cast<void>(inflateEnd(&strm));
+                    XTENSOR_THROW(std::runtime_error, "load_zlib_range: unexpected end of file");
+                }
+                inflatePrime(&strm, point->bits, c >> (8 - point->bits));
+            }
+            if (!point->window.empty())
+            {
+                inflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(point->window.data()), static_cast<uInt>(point->window.size()));
+            }
+
+            char in[ZLIB_CHUNK];
+            // receives the data between the access point and the range
+            char skipped[ZLIB_CHUNK];
+            std::size_t skip = begin - point->out;
+            Bytef* out = reinterpret_cast<Bytef*>(uncompressed_buffer.data());
+            std::size_t remaining = nbytes;
+            while (remaining != 0)
+            {
+                if (strm.avail_in == 0)
+                {
+                    stream.read(in, sizeof(in));
+                    strm.avail_in = static_cast<uInt>(stream.gcount());
+                    if (strm.avail_in == 0)
+                    {
+                        static_cast<void>(inflateEnd(&strm));
+                        XTENSOR_THROW(std::runtime_error, "load_zlib_range: unexpected end of file");
+                    }
+                    strm.next_in = reinterpret_cast<Bytef*>(in);
+                }
+                if (skip != 0)
+                {
+                    strm.next_out = reinterpret_cast<Bytef*>(skipped);
+                    strm.avail_out = static_cast<uInt>(std::min<std::size_t>(skip, sizeof(skipped)));
+                }
+                else
+                {
+                    strm.next_out = out;
+                    strm.avail_out = static_cast<uInt>(std::min<std::size_t>(remaining, UINT_MAX));
+                }
+                uInt avail_out = strm.avail_out;
+                ret = inflate(&strm, Z_NO_FLUSH);
+                switch (ret)
+                {
+                    case Z_NEED_DICT:
+                        ret = Z_DATA_ERROR;
+                    case Z_STREAM_ERROR:
+                    case Z_DATA_ERROR:
+                    case Z_MEM_ERROR:
+                        static_cast<void>(inflateEnd(&strm));
+                        XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + zlib_err(ret) + ")");
+                }
+                std::size_t have = avail_out - strm.avail_out;
+                if (skip != 0)
+                {
+                    skip -= have;
+                }
+                else
+                {
+                    out += have;
+                    remaining -= have;
+                }
+                if (ret == Z_STREAM_END && remaining != 0)
+                {
+                    static_cast<void>(inflateEnd(&strm));
+                    XTENSOR_THROW(std::runtime_error, "load_zlib_range: unexpected end of stream");
+                }
+            }
+            static_cast<void>(inflateEnd(&strm));
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+            {
+                swap_endianness(uncompressed_buffer);
+            }
+            return uncompressed_buffer;
+        }
+
         template <typename T, class I>
         inline xt::svector<T> load_zlib(I& stream, bool as_big_endian)
+        {
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            z_stream strm;
+            strm.zalloc = Z_NULL;
+            strm.zfree = Z_NULL;
+            strm.opaque = Z_NULL;
+            strm.avail_in = 0;
+            strm.next_in = reinterpret_cast<Bytef*>(&compressed_buffer[0]);
+            int ret = inflateInit(&strm);
+            if (ret != Z_OK)
+            {
+                XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + zlib_err(ret) + ")");
+            }
+            // the uncompressed size is not stored in the stream, start from
+            // a typical compression ratio and grow geometrically
+            std::size_t in_left = compressed_buffer.size();
+            xt::svector<T> uncompressed_buffer(std::max<std::size_t>(4 * in_left / sizeof(T), 1));
+            std::size_t nbytes = 0;
+            do
+            {
+                if (strm.avail_in == 0)
+                {
+                    strm.avail_in = static_cast<uInt>(std::min<std::size_t>(in_left, UINT_MAX));
+                    in_left -= strm.avail_in;
+                }
+                std::size_t capacity = uncompressed_buffer.size() * sizeof(T);
+                if (nbytes == capacity)
+                {
+                    uncompressed_buffer.resize(2 * uncompressed_buffer.size());
+                    capacity *= 2;
+                }
+                strm.next_out = reinterpret_cast<Bytef*>(uncompressed_buffer.data()) + nbytes;
+                strm.avail_out = static_cast<uInt>(std::min<std::size_t>(capacity - nbytes, UINT_MAX));
+                uInt avail_out = strm.avail_out;
+                ret = inflate(&strm, Z_NO_FLUSH);
+                if (ret == Z_STREAM_ERROR)
+                {
+                    XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + zlib_err(Z_STREAM_ERROR) + ")");
+                }
+                switch (ret) {
+                    case Z_NEED_DICT:
+                        ret = Z_DATA_ERROR;
+                    case Z_DATA_ERROR:
+                    case Z_MEM_ERROR:
+                        static_cast<void>(inflateEnd(&strm));
+                        XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + zlib_err(ret) + ")");
+                }
+                nbytes += avail_out - strm.avail_out;
+            }
+            // Z_BUF_ERROR: the input is truncated
+            while (ret != Z_STREAM_END && ret != Z_BUF_ERROR);
+
+            static_cast<void>(inflateEnd(&strm));
+            if (ret != Z_STREAM_END)
+            {
+                XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + zlib_err(Z_DATA_ERROR) + ")");
+            }
+            if (nbytes % sizeof(T) != 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "zlib decompression failed (size is not a multiple of the element size)");
+            }
+            uncompressed_buffer.resize(nbytes / sizeof(T));
+            if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
+            {
+                swap_endianness(uncompressed_buffer);
+            }
+            return uncompressed_buffer;
+        }
+
+        template <typename T, class I>
+        inline void load_zlib_into(I& stream, T* data, std::size_t size, bool as_big_endian)
         {
             z_stream strm;
             strm.zalloc = Z_NULL;
@@ -59,8 +381,10 @@ namespace xt
                 XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + zlib_err(ret) + ")");
             }
             char in[ZLIB_CHUNK];
-            T out[ZLIB_CHUNK / sizeof(T)];
-            xt::svector<T> uncompressed_buffer;
+            Bytef* out = reinterpret_cast<Bytef*>(data);
+            std::size_t remaining = size * sizeof(T);
+            // receives the data in excess, if any
+            Bytef extra;
             do
             {
                 stream.read(in, sizeof(in));
@@ -72,8 +396,17 @@ namespace xt
                 strm.next_in = reinterpret_cast<Bytef*>(in);
                 do
                 {
-                    strm.avail_out = ZLIB_CHUNK;
-                    strm.next_out = reinterpret_cast<Bytef*>(out);
+                    if (remaining != 0)
+                    {
+                        strm.next_out = out;
+                        strm.avail_out = static_cast<uInt>(std::min<std::size_t>(remaining, UINT_MAX));
+                    }
+                    else
+                    {
+                        strm.next_out = &extra;
+                        strm.avail_out = 1;
+                    }
+                    uInt avail_out = strm.avail_out;
                     ret = inflate(&strm, Z_NO_FLUSH);
                     if (ret == Z_STREAM_ERROR)
                     {
@@ -87,8 +420,14 @@ namespace xt
                             static_cast<void>(inflateEnd(&strm));
                             XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + zlib_err(ret) + ")");
                     }
-                    unsigned int have = ZLIB_CHUNK - strm.avail_out;
-                    uncompressed_buffer.insert(std::end(uncompressed_buffer), out, out + have / sizeof(T));
+                    std::size_t have = avail_out - strm.avail_out;
+                    if (remaining == 0 && have != 0)
+                    {
+                        static_cast<void>(inflateEnd(&strm));
+                        XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+                    }
+                    out += have;
+                    remaining -= have;
                 }
                 while (strm.avail_out == 0);
             }
@@ -99,15 +438,19 @@ namespace xt
             {
                 XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + zlib_err(Z_DATA_ERROR) + ")");
             }
+            if (remaining != 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            }
             if ((sizeof(T) > 1) && (as_big_endian != is_big_endian()))
             {
-                swap_endianness(uncompressed_buffer);
+                swap_endianness(data, size);
             }
-            return uncompressed_buffer;
         }
 
         template <class O, class E>
-        inline void dump_zlib(O& stream, const xexpression<E>& e, bool as_big_endian, int level)
+        inline void dump_zlib(O& stream, const xexpression<E>& e, bool as_big_endian, int level,
+                              xzlib_index* index = nullptr, std::size_t span = ZLIB_INDEX_SPAN)
         {
             using value_type = typename E::value_type;
             const E& ex = e.derived_cast();
@@ -115,19 +458,7 @@ namespace xt
             auto shape = eval_ex.shape();
             std::size_t size = compute_size(shape);
             std::size_t uncompressed_size = size * sizeof(value_type);
-            const char* uncompressed_buffer;
-            xt::svector<value_type> swapped_buffer;
-            if ((sizeof(value_type) > 1) && (as_big_endian != is_big_endian()))
-            {
-                swapped_buffer.resize(size);
-                std::copy(eval_ex.data(), eval_ex.data() + size, swapped_buffer.begin());
-                swap_endianness(swapped_buffer);
-                uncompressed_buffer = reinterpret_cast<const char*>(swapped_buffer.data());
-            }
-            else
-            {
-                uncompressed_buffer = reinterpret_cast<const char*>(eval_ex.data());
-            }
+            bool swap = (sizeof(value_type) > 1) && (as_big_endian != is_big_endian());
 
             z_stream strm;
             strm.zalloc = Z_NULL;
@@ -139,35 +470,66 @@ namespace xt
                 XTENSOR_THROW(std::runtime_error, "zlib compression failed (" + zlib_err(ret) + ")");
             }
 
-            const char* in = uncompressed_buffer;
             char out[ZLIB_CHUNK];
-            int flush;
-            do
+            // the index points are where the stream is fully flushed, and
+            // can be inflated without the previous data
+            std::size_t written = 0;
+            std::size_t consumed = 0;
+            std::size_t next_point = span;
+            if (index != nullptr)
+            {
+                // after the 2 bytes header
+                index->points.assign(1, xzlib_access_point{0, 2, 0, std::string()});
+            }
+            // the data is fed to deflate in blocks, swapped on the fly if needed
+            for_each_swapped_block(eval_ex.data(), size, swap, [&](const char* block, std::size_t block_size, bool last_block)
             {
-                strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
-                in += ZLIB_CHUNK;
-                flush = (in >= uncompressed_buffer + uncompressed_size) ? Z_FINISH : Z_NO_FLUSH;
-                long int in_size = (flush == Z_FINISH) ? (ZLIB_CHUNK - (in - (uncompressed_buffer + uncompressed_size))) : ZLIB_CHUNK;
-                strm.avail_in = static_cast<uInt>(in_size);
+                const char* in = block;
+                const char* block_end = block + block_size;
                 do
                 {
-                    strm.avail_out = ZLIB_CHUNK;
-                    strm.next_out = reinterpret_cast<Bytef*>(out);
-                    ret = deflate(&strm, flush);
-                    if (ret == Z_STREAM_ERROR)
+                    std::size_t in_size = std::min<std::size_t>(ZLIB_CHUNK, static_cast<std::size_t>(block_end - in));
+                    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+                    strm.avail_in = static_cast<uInt>(in_size);
+                    in += in_size;
+                    consumed += in_size;
+                    int flush = (last_block && in == block_end) ? Z_FINISH : Z_NO_FLUSH;
+                    if (index != nullptr && flush == Z_NO_FLUSH && consumed >= next_point)
                     {
-                        XTENSOR_THROW(std::runtime_error, "zlib compression failed (" + zlib_err(Z_STREAM_ERROR) + ")");
+                        flush = Z_FULL_FLUSH;
+                    }
+                    do
+                    {
+                        strm.avail_out = ZLIB_CHUNK;
+                        strm.next_out = reinterpret_cast<Bytef*>(out);
+                        ret = deflate(&strm, flush);
+                        if (ret == Z_STREAM_ERROR)
+                        {
+                            XTENSOR_THROW(std::runtime_error, "zlib compression failed (" + zlib_err(Z_STREAM_ERROR) + ")");
+                        }
+                        unsigned int have = ZLIB_CHUNK - strm.avail_out;
+                        stream.write(reinterpret_cast<const char*>(out), static_cast<std::streamsize>(have));
+                        written += have;
+                    }
+                    while (strm.avail_out == 0);
+                    if (strm.avail_in != 0)
+                    {
+                        XTENSOR_THROW(std::runtime_error, "zlib compression failed (remaining input data)");
+                    }
+                    if (flush == Z_FULL_FLUSH)
+                    {
+                        index->points.push_back(xzlib_access_point{consumed, written, 0, std::string()});
+                        next_point = consumed + span;
                     }
-                    unsigned int have = ZLIB_CHUNK - strm.avail_out;
-                    stream.write(reinterpret_cast<const char*>(out), static_cast<std::streamsize>(have));
-                }
-                while (strm.avail_out == 0);
-                if (strm.avail_in != 0)
-                {
-                    XTENSOR_THROW(std::runtime_error, "zlib compression failed (remaining input data)");
                 }
+                while (in != block_end);
+            });
+            if (index != nullptr)
+            {
+                index->compressed_size = written;
+                index->uncompressed_size = uncompressed_size;
+                index->adler32 = static_cast<std::uint32_t>(strm.adler);
             }
-            while (flush != Z_FINISH);
             if (ret != Z_STREAM_END)
             {
                 XTENSOR_THROW(std::runtime_error, "zlib compression failed (stream not complete)");
@@ -196,14 +558,24 @@ namespace xt
         detail::dump_zlib(s, e, as_big_endian, level);
     }
 
+    void dump_zlib_index(const std::string& filename, const xzlib_index& index);
+
     /**
      * Save xexpression to ZLIB format
      *
+     * The random access index used by load_zlib_range can be built while
+     * compressing, and saved next to the file, with the ".idx" extension.
+     * The stream is then fully flushed every ZLIB_INDEX_SPAN bytes of
+     * data, which slightly lowers the compression ratio.
+     *
      * @param filename The filename or path to dump the data
      * @param e the xexpression
+     * @param as_big_endian whether to store the data in big endian
+     * @param level the compression level
+     * @param with_index whether to save the random access index
      */
     template <typename E>
-    inline void dump_zlib(const char* filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1)
+    inline void dump_zlib(const char* filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1, bool with_index=false)
     {
         std::ofstream stream(filename, std::ofstream::binary);
         if (!stream.is_open())
@@ -211,13 +583,25 @@ namespace xt
             std::runtime_error("IO Error: failed to open file");
         }
         auto s = xostream_wrapper(stream);
-        detail::dump_zlib(s, e, as_big_endian, level);
+        std::string index_filename = std::string(filename) + ".idx";
+        if (with_index)
+        {
+            xzlib_index index;
+            detail::dump_zlib(s, e, as_big_endian, level, &index);
+            dump_zlib_index(index_filename, index);
+        }
+        else
+        {
+            detail::dump_zlib(s, e, as_big_endian, level);
+            // an index of the previous content would be wrong
+            std::remove(index_filename.c_str());
+        }
     }
 
     template <typename E>
-    inline void dump_zlib(const std::string& filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1)
+    inline void dump_zlib(const std::string& filename, const xexpression<E>& e, bool as_big_endian=is_big_endian(), int level=1, bool with_index=false)
     {
-        dump_zlib<E>(filename.c_str(), e, as_big_endian, level);
+        dump_zlib<E>(filename.c_str(), e, as_big_endian, level, with_index);
     }
 
     /**
@@ -279,6 +663,206 @@ namespace xt
         return load_zlib<T, L>(filename.c_str(), as_big_endian);
     }
 
+    /**
+     * Builds the random access index of a ZLIB stream, by inflating it
+     * once. An access point is recorded at the first deflate block
+     * boundary after each span of uncompressed data, together with the
+     * 32 KiB of data preceding it.
+     *
+     * @param stream An input stream positioned at the start of the ZLIB stream
+     * @param span The distance between the access points, in bytes
+     * @return the index of the stream
+     */
+    inline xzlib_index build_zlib_index(std::istream& stream, std::size_t span = ZLIB_INDEX_SPAN)
+    {
+        z_stream strm;
+        strm.zalloc = Z_NULL;
+        strm.zfree = Z_NULL;
+        strm.opaque = Z_NULL;
+        strm.avail_in = 0;
+        strm.next_in = Z_NULL;
+        int ret = inflateInit(&strm);
+        if (ret != Z_OK)
+        {
+            XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + detail::zlib_err(ret) + ")");
+        }
+        xzlib_index index;
+        char in[ZLIB_CHUNK];
+        // the output is only kept for the windows of the access points
+        std::string window(detail::zlib_window_size, '\0');
+        std::size_t total_in = 0;
+        std::size_t total_out = 0;
+        std::size_t last = 0;
+        strm.avail_out = 0;
+        do
+        {
+            stream.read(in, sizeof(in));
+            strm.avail_in = static_cast<uInt>(stream.gcount());
+            if (strm.avail_in == 0)
+            {
+                static_cast<void>(inflateEnd(&strm));
+                XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + detail::zlib_err(Z_DATA_ERROR) + ")");
+            }
+            strm.next_in = reinterpret_cast<Bytef*>(in);
+            do
+            {
+                if (strm.avail_out == 0)
+                {
+                    strm.next_out = reinterpret_cast<Bytef*>(&window[0]);
+                    strm.avail_out = static_cast<uInt>(window.size());
+                }
+                total_in += strm.avail_in;
+                total_out += strm.avail_out;
+                // stop at the end of each deflate block
+                ret = inflate(&strm, Z_BLOCK);
+                total_in -= strm.avail_in;
+                total_out -= strm.avail_out;
+                switch (ret)
+                {
+                    case Z_NEED_DICT:
+                        ret = Z_DATA_ERROR;
+                    case Z_STREAM_ERROR:
+                    case Z_DATA_ERROR:
+                    case Z_MEM_ERROR:
+                        static_cast<void>(inflateEnd(&strm));
+                        XTENSOR_THROW(std::runtime_error, "zlib decompression failed (" + detail::zlib_err(ret) + ")");
+                }
+                if (ret == Z_STREAM_END)
+                {
+                    break;
+                }
+                // bit 7: end of a block, bit 6: last block
+                bool boundary = (strm.data_type & 128) && !(strm.data_type & 64);
+                if (boundary && (total_out == 0 || total_out - last > span))
+                {
+                    xzlib_access_point point{total_out, total_in, strm.data_type & 7, std::string()};
+                    // the window is circular, its oldest byte is the next one to be written
+                    std::size_t left = strm.avail_out;
+                    if (total_out >= window.size())
+                    {
+                        point.window.reserve(window.size());
+                        point.window.append(window, window.size() - left, left);
+                        point.window.append(window, 0, window.size() - left);
+                    }
+                    else
+                    {
+                        point.window.assign(window, 0, total_out);
+                    }
+                    index.points.push_back(std::move(point));
+                    last = total_out;
+                }
+            }
+            while (strm.avail_in != 0);
+        }
+        while (ret != Z_STREAM_END);
+        index.compressed_size = total_in;
+        index.uncompressed_size = total_out;
+        index.adler32 = static_cast<std::uint32_t>(strm.adler);
+        static_cast<void>(inflateEnd(&strm));
+        return index;
+    }
+
+    /**
+     * Saves the random access index of a ZLIB file.
+     *
+     * @param filename The filename or path of the index
+     * @param index the index
+     */
+    inline void dump_zlib_index(const std::string& filename, const xzlib_index& index)
+    {
+        std::ofstream stream(filename, std::ofstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, "dump_zlib_index: failed to open file " + filename);
+        }
+        detail::write_zlib_index(stream, index);
+    }
+
+    /**
+     * Loads the random access index of a ZLIB file.
+     *
+     * @param filename The filename or path of the index
+     * @return the index
+     */
+    inline xzlib_index load_zlib_index(const std::string& filename)
+    {
+        std::ifstream stream(filename, std::ifstream::binary);
+        xzlib_index index;
+        if (!stream.is_open() || !detail::read_zlib_index(stream, index))
+        {
+            XTENSOR_THROW(std::runtime_error, "load_zlib_index: invalid index " + filename);
+        }
+        return index;
+    }
+
+    /**
+     * Loads a range of elements of a ZLIB stream, inflating from the
+     * closest access point of its index.
+     *
+     * @param stream An input stream from which to load the data
+     * @param index The index of the stream
+     * @param offset The index of the first element
+     * @param count The number of elements
+     * @tparam T select the type of the ZLIB file
+     * @return xarray with the elements of the range
+     */
+    template <typename T, layout_type L = layout_type::dynamic>
+    inline auto load_zlib_range(std::istream& stream, const xzlib_index& index, std::size_t offset, std::size_t count, bool as_big_endian=is_big_endian())
+    {
+        xt::svector<T> uncompressed_buffer = detail::load_zlib_range<T>(stream, index, offset, count, as_big_endian);
+        std::vector<std::size_t> shape = {uncompressed_buffer.size()};
+        return adapt(std::move(uncompressed_buffer), shape);
+    }
+
+    /**
+     * Loads a range of elements of a ZLIB file. The index saved next to
+     * the file (with the ".idx" extension) is used if it matches the size
+     * and the checksum of the file, which is stored at its end. Otherwise
+     * it is built by inflating the file once, and saved for the next reads.
+     *
+     * @param filename The filename or path to the file
+     * @param offset The index of the first element
+     * @param count The number of elements
+     * @tparam T select the type of the ZLIB file
+     * @return xarray with the elements of the range
+     */
+    template <typename T, layout_type L = layout_type::dynamic>
+    inline auto load_zlib_range(const char* filename, std::size_t offset, std::size_t count, bool as_big_endian=is_big_endian())
+    {
+        std::ifstream stream(filename, std::ifstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("load_zlib_range: failed to open file ") + filename);
+        }
+        stream.seekg(0, std::ios::end);
+        std::size_t file_size = static_cast<std::size_t>(stream.tellg());
+        std::uint32_t adler32 = detail::read_zlib_trailer(stream, file_size);
+        std::string index_filename = std::string(filename) + ".idx";
+        xzlib_index index;
+        std::ifstream index_stream(index_filename, std::ifstream::binary);
+        // a file rewritten since the index was saved may have the same size
+        bool valid_index = index_stream.is_open() && detail::read_zlib_index(index_stream, index) &&
+                           index.compressed_size == file_size && index.adler32 == adler32;
+        index_stream.close();
+        if (!valid_index)
+        {
+            index = build_zlib_index(stream);
+            // the index is not saved if the directory is read-only
+            std::ofstream out_stream(index_filename, std::ofstream::binary);
+            if (out_stream.is_open())
+            {
+                detail::write_zlib_index(out_stream, index);
+            }
+        }
+        return load_zlib_range<T, L>(stream, index, offset, count, as_big_endian);
+    }
+
+    template <typename T, layout_type L = layout_type::dynamic>
+    inline auto load_zlib_range(const std::string& filename, std::size_t offset, std::size_t count, bool as_big_endian=is_big_endian())
+    {
+        return load_zlib_range<T, L>(filename.c_str(), offset, count, as_big_endian);
+    }
+
     struct xio_zlib_config
     {
         std::string name;
@@ -306,7 +890,7 @@ namespace xt
             level = j["level"];
         }
 
-        bool will_dump(xfile_dirty dirty)
+        bool will_dump(const xfile_dirty& dirty)
         {
             return dirty.data_dirty;
         }
@@ -317,6 +901,13 @@ namespace xt
     {
         E& ex = e.derived_cast();
         auto shape = ex.shape();
+        auto* data = detail::decode_destination(ex);
+        if (!shape.empty() && data != nullptr)
+        {
+            // the array already has the expected size
+            detail::load_zlib_into(stream, data, ex.size(), config.big_endian);
+            return;
+        }
         ex = load_zlib<typename E::value_type>(stream, config.big_endian);
         if (!shape.empty())
         {
@@ -0,0 +1,616 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_ZSTD_HPP
+#define XTENSOR_IO_ZSTD_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zstd.h"
+#include "zstd_errors.h"
+#include "zdict.h"
+
+#include "xtensor/containers/xadapt.hpp"
+#include "xtensor-io.hpp"
+#include "xfile_array.hpp"
+#include "xio_scratch_arena.hpp"
+#include "xio_stream_wrapper.hpp"
+
+namespace xt
+{
+    /**
+     * @class xzstd_dictionary
+     * @brief Zstandard dictionary.
+     *
+     * Holds the content of a dictionary, and its digested forms for
+     * compression and decompression, so that they are built once and
+     * shared by all the chunks using the dictionary.
+     */
+    class xzstd_dictionary
+    {
+    public:
+
+        explicit xzstd_dictionary(std::string content, int level = ZSTD_CLEVEL_DEFAULT);
+
+        const std::string& content() const noexcept;
+        unsigned int id() const noexcept;
+        int level() const noexcept;
+
+        const ZSTD_CDict* cdict() const noexcept;
+        const ZSTD_DDict* ddict() const noexcept;
+
+    private:
+
+        std::string m_content;
+        int m_level;
+        std::unique_ptr<ZSTD_CDict, std::size_t(*)(ZSTD_CDict*)> m_cdict;
+        std::unique_ptr<ZSTD_DDict, std::size_t(*)(ZSTD_DDict*)> m_ddict;
+    };
+
+    std::string train_zstd_dictionary(const std::string& samples,
+                                      const std::vector<std::size_t>& sample_sizes,
+                                      std::size_t capacity = 112640);
+
+    /**
+     * @struct xio_zstd_config
+     * @brief Configuration of the Zstandard file format.
+     *
+     * When a dictionary is set, the compression parameters are the ones
+     * it was built with, and the same dictionary must be used to load
+     * the files. In a chunked array, the dictionary is shared by all the
+     * chunks and saved once at the root of the store. The dictionaries
+     * it replaces are kept, so that the files compressed with them can
+     * still be loaded.
+     */
+    struct xio_zstd_config
+    {
+        std::string name;
+        std::string version;
+        bool big_endian;
+        int level;
+        bool long_distance_matching;
+        // log2 of the window size, 0 for the default of the level
+        int window_log;
+        // number of compression threads, not saved with the data
+        int nb_workers;
+        std::shared_ptr<const xzstd_dictionary> dictionary;
+        // dictionaries replaced by a training, only used for loading
+        std::vector<std::shared_ptr<const xzstd_dictionary>> previous_dictionaries;
+
+        xio_zstd_config()
+            : name("zstd")
+            , version(ZSTD_VERSION_STRING)
+            , big_endian(is_big_endian())
+            , level(ZSTD_CLEVEL_DEFAULT)
+            , long_distance_matching(false)
+            , window_log(0)
+            , nb_workers(0)
+        {
+        }
+
+        template <class T>
+        void write_to(T& j) const
+        {
+            j["level"] = level;
+            j["long_distance_matching"] = long_distance_matching;
+            j["window_log"] = window_log;
+        }
+
+        template <class T>
+        void read_from(T& j)
+        {
+            level = j["level"];
+            long_distance_matching = j["long_distance_matching"];
+            window_log = j["window_log"];
+        }
+
+        bool will_dump(const xfile_dirty& dirty)
+        {
+            return dirty.data_dirty;
+        }
+
+        void train_dictionary(const std::string& samples, const std::vector<std::size_t>& sample_sizes)
+        {
+            auto trained = std::make_shared<const xzstd_dictionary>(train_zstd_dictionary(samples, sample_sizes), level);
+            if (dictionary != nullptr && dictionary->id() != 0 && dictionary->id() != trained->id())
+            {
+                previous_dictionaries.push_back(std::move(dictionary));
+            }
+            dictionary = std::move(trained);
+        }
+
+        // Saves the dictionary at the root of a store, or reads it from
+        // there if this configuration doesn't have one. The current
+        // dictionary is zstd.dict, and each dictionary is also saved as
+        // zstd.<id>.dict, so that the files compressed with a dictionary
+        // replaced by a later training can still be loaded.
+        void configure_store(const std::string& directory)
+        {
+            namespace fs = std::filesystem;
+            auto read_content = [](const fs::path& path)
+            {
+                std::ifstream in_file(path, std::ifstream::binary);
+                return std::string((std::istreambuf_iterator<char>(in_file)), std::istreambuf_iterator<char>());
+            };
+            auto write_content = [](const fs::path& path, const std::string& content)
+            {
+                std::ofstream out_file(path, std::ofstream::binary);
+                out_file.write(content.data(), std::streamsize(content.size()));
+                if (!out_file)
+                {
+                    XTENSOR_THROW(std::runtime_error, "Zstd: failed to write dictionary " + path.string());
+                }
+            };
+            // dictionaries without ID are not recorded in the frames,
+            // the files compressed with them cannot be told apart
+            auto save_by_id = [&](const std::string& content)
+            {
+                unsigned int id = ZSTD_getDictID_fromDict(content.data(), content.size());
+                fs::path id_path = fs::path(directory) / ("zstd." + std::to_string(id) + ".dict");
+                if (id != 0 && !fs::exists(id_path))
+                {
+                    write_content(id_path, content);
+                }
+            };
+            fs::path path = fs::path(directory) / "zstd.dict";
+            if (dictionary != nullptr)
+            {
+                fs::create_directories(directory);
+                if (fs::exists(path))
+                {
+                    // the replaced dictionary may not have been saved
+                    // under its ID by an older version
+                    save_by_id(read_content(path));
+                }
+                save_by_id(dictionary->content());
+                write_content(path, dictionary->content());
+            }
+            else if (fs::exists(path))
+            {
+                dictionary = std::make_shared<const xzstd_dictionary>(read_content(path), level);
+            }
+            if (dictionary == nullptr)
+            {
+                return;
+            }
+            for (const auto& entry: fs::directory_iterator(directory))
+            {
+                std::string name = entry.path().filename().string();
+                if (name.size() > 10 && name.compare(0, 5, "zstd.") == 0 && name.compare(name.size() - 5, 5, ".dict") == 0)
+                {
+                    std::string content = read_content(entry.path());
+                    unsigned int id = ZSTD_getDictID_fromDict(content.data(), content.size());
+                    bool known = id == 0 || id == dictionary->id() ||
+                        std::any_of(previous_dictionaries.cbegin(), previous_dictionaries.cend(),
+                                    [id](const auto& d) { return d->id() == id; });
+                    if (!known)
+                    {
+                        previous_dictionaries.push_back(std::make_shared<const xzstd_dictionary>(std::move(content), level));
+                    }
+                }
+            }
+        }
+    };
+
+    /***********************************
+     * xzstd_dictionary implementation *
+     ***********************************/
+
+    /**
+     * Builds a dictionary from its content, e.g. the output of the zstd
+     * --train command or of ZDICT_trainFromBuffer.
+     * @param content the content of the dictionary
+     * @param level the compression level used with the dictionary
+     */
+    inline xzstd_dictionary::xzstd_dictionary(std::string content, int level)
+        : m_content(std::move(content))
+        , m_level(level)
+        , m_cdict(ZSTD_createCDict(m_content.data(), m_content.size(), level), ZSTD_freeCDict)
+        , m_ddict(ZSTD_createDDict(m_content.data(), m_content.size()), ZSTD_freeDDict)
+    {
+        if (m_cdict == nullptr || m_ddict == nullptr)
+        {
+            XTENSOR_THROW(std::runtime_error, "Zstd: invalid dictionary");
+        }
+    }
+
+    inline const std::string& xzstd_dictionary::content() const noexcept
+    {
+        return m_content;
+    }
+
+    /**
+     * Returns the ID of the dictionary, 0 if it doesn't have one (raw
+     * content dictionary).
+     */
+    inline unsigned int xzstd_dictionary::id() const noexcept
+    {
+        return ZSTD_getDictID_fromDict(m_content.data(), m_content.size());
+    }
+
+    inline int xzstd_dictionary::level() const noexcept
+    {
+        return m_level;
+    }
+
+    inline const ZSTD_CDict* xzstd_dictionary::cdict() const noexcept
+    {
+        return m_cdict.get();
+    }
+
+    inline const ZSTD_DDict* xzstd_dictionary::ddict() const noexcept
+    {
+        return m_ddict.get();
+    }
+
+    /**
+     * Trains a dictionary on samples of the data to compress, e.g. some
+     * chunks of an array. Dictionaries mostly help with small inputs,
+     * and need at least a few dozens of samples.
+     * @param samples the concatenated samples
+     * @param sample_sizes the size of each sample
+     * @param capacity the maximum size of the dictionary
+     * @return the content of the dictionary
+     */
+    inline std::string train_zstd_dictionary(const std::string& samples,
+                                             const std::vector<std::size_t>& sample_sizes,
+                                             std::size_t capacity)
+    {
+        std::string content(capacity, '\0');
+        std::size_t res = ZDICT_trainFromBuffer(&content[0], capacity, samples.data(), sample_sizes.data(), static_cast<unsigned>(sample_sizes.size()));
+        if (ZDICT_isError(res))
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("Zstd: dictionary training failed (") + ZDICT_getErrorName(res) + ")");
+        }
+        content.resize(res);
+        return content;
+    }
+
+    namespace detail
+    {
+        inline void check_zstd(std::size_t res, const char* what)
+        {
+            if (ZSTD_isError(res))
+            {
+                XTENSOR_THROW(std::runtime_error, std::string("Zstd: ") + what + " failed (" + ZSTD_getErrorName(res) + ")");
+            }
+        }
+
+        // Compression and decompression contexts are reused by the calls
+        // made from the same thread.
+        inline ZSTD_CCtx* zstd_cctx()
+        {
+            thread_local std::unique_ptr<ZSTD_CCtx, std::size_t(*)(ZSTD_CCtx*)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+            ZSTD_CCtx_reset(cctx.get(), ZSTD_reset_session_and_parameters);
+            return cctx.get();
+        }
+
+        // Returns the dictionary a frame was compressed with, selected by
+        // the ID recorded in the frame. Data written before the dictionary
+        // was set (e.g. before it was trained) doesn't refer to it, while
+        // dictionaries without ID are not recorded and are always used.
+        inline const xzstd_dictionary* find_zstd_dictionary(const xio_zstd_config& config, const std::string& compressed_buffer)
+        {
+            unsigned int id = ZSTD_getDictID_fromFrame(compressed_buffer.data(), compressed_buffer.size());
+            if (id == 0)
+            {
+                return config.dictionary != nullptr && config.dictionary->id() == 0 ? config.dictionary.get() : nullptr;
+            }
+            if (config.dictionary != nullptr && config.dictionary->id() == id)
+            {
+                return config.dictionary.get();
+            }
+            for (const auto& dictionary: config.previous_dictionaries)
+            {
+                if (dictionary->id() == id)
+                {
+                    return dictionary.get();
+                }
+            }
+            XTENSOR_THROW(std::runtime_error, "Zstd: dictionary " + std::to_string(id) + " not found");
+        }
+
+        inline ZSTD_DCtx* zstd_dctx(const xio_zstd_config& config, const std::string& compressed_buffer)
+        {
+            thread_local std::unique_ptr<ZSTD_DCtx, std::size_t(*)(ZSTD_DCtx*)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+            ZSTD_DCtx_reset(dctx.get(), ZSTD_reset_session_and_parameters);
+            if (config.window_log > 0)
+            {
+                // windows larger than the default limit must be allowed explicitly
+                check_zstd(ZSTD_DCtx_setParameter(dctx.get(), ZSTD_d_windowLogMax, config.window_log), "setting window size");
+            }
+            const xzstd_dictionary* dictionary = find_zstd_dictionary(config, compressed_buffer);
+            if (dictionary != nullptr)
+            {
+                check_zstd(ZSTD_DCtx_refDDict(dctx.get(), dictionary->ddict()), "loading dictionary");
+            }
+            return dctx.get();
+        }
+
+        // Decompresses frames whose size is not stored, growing the output.
+        template <typename T>
+        inline xt::svector<T> zstd_decompress_stream(ZSTD_DCtx* dctx, const std::string& compressed_buffer)
+        {
+            xt::svector<T> uncompressed_buffer(std::max<std::size_t>(4 * compressed_buffer.size() / sizeof(T), 1));
+            ZSTD_inBuffer in = {compressed_buffer.data(), compressed_buffer.size(), 0};
+            std::size_t nbytes = 0;
+            std::size_t capacity = 0;
+            std::size_t res = 0;
+            do
+            {
+                capacity = uncompressed_buffer.size() * sizeof(T);
+                if (nbytes == capacity)
+                {
+                    uncompressed_buffer.resize(2 * uncompressed_buffer.size());
+                    capacity *= 2;
+                }
+                ZSTD_outBuffer out = {reinterpret_cast<char*>(uncompressed_buffer.data()), capacity, nbytes};
+                res = ZSTD_decompressStream(dctx, &out, &in);
+                check_zstd(res, "decompression");
+                nbytes = out.pos;
+            }
+            // a full output buffer may hide data not flushed yet
+            while (in.pos < in.size || (res != 0 && nbytes == capacity));
+            if (res != 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "Zstd: decompression failed (truncated input)");
+            }
+            if (nbytes % sizeof(T) != 0)
+            {
+                XTENSOR_THROW(std::runtime_error, "Zstd: decompression failed (size is not a multiple of the element size)");
+            }
+            uncompressed_buffer.resize(nbytes / sizeof(T));
+            return uncompressed_buffer;
+        }
+
+        template <typename T, class I>
+        inline xt::svector<T> load_zstd(I& stream, const xio_zstd_config& config)
+        {
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            ZSTD_DCtx* dctx = zstd_dctx(config, compressed_buffer);
+            unsigned long long nbytes = ZSTD_getFrameContentSize(compressed_buffer.data(), compressed_buffer.size());
+            if (nbytes == ZSTD_CONTENTSIZE_ERROR)
+            {
+                XTENSOR_THROW(std::runtime_error, "Zstd: decompression failed (invalid frame)");
+            }
+            // the size of the first frame is the size of the data only if
+            // there is a single frame
+            bool single_frame = ZSTD_findFrameCompressedSize(compressed_buffer.data(), compressed_buffer.size()) == compressed_buffer.size();
+            xt::svector<T> uncompressed_buffer;
+            if (nbytes == ZSTD_CONTENTSIZE_UNKNOWN || !single_frame)
+            {
+                uncompressed_buffer = zstd_decompress_stream<T>(dctx, compressed_buffer);
+            }
+            else
+            {
+                if (nbytes % sizeof(T) != 0)
+                {
+                    XTENSOR_THROW(std::runtime_error, "Zstd: decompression failed (size is not a multiple of the element size)");
+                }
+                uncompressed_buffer.resize(nbytes / sizeof(T));
+                std::size_t res = ZSTD_decompressDCtx(dctx, uncompressed_buffer.data(), nbytes, compressed_buffer.data(), compressed_buffer.size());
+                check_zstd(res, "decompression");
+            }
+            if ((sizeof(T) > 1) && (config.big_endian != is_big_endian()))
+            {
+                swap_endianness(uncompressed_buffer);
+            }
+            return uncompressed_buffer;
+        }
+
+        template <typename T, class I>
+        inline void load_zstd_into(I& stream, T* data, std::size_t size, const xio_zstd_config& config)
+        {
+            auto scratch = scratch_arena().acquire();
+            std::string& compressed_buffer = scratch.str();
+            stream.read_all(compressed_buffer);
+            ZSTD_DCtx* dctx = zstd_dctx(config, compressed_buffer);
+            std::size_t res = ZSTD_decompressDCtx(dctx, data, size * sizeof(T), compressed_buffer.data(), compressed_buffer.size());
+            if (ZSTD_isError(res) && ZSTD_getErrorCode(res) == ZSTD_error_dstSize_tooSmall)
+            {
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            }
+            check_zstd(res, "decompression");
+            if (res != size * sizeof(T))
+            {
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            }
+            if ((sizeof(T) > 1) && (config.big_endian != is_big_endian()))
+            {
+                swap_endianness(data, size);
+            }
+        }
+
+        template <class O, class E>
+        inline void dump_zstd(O& stream, const xexpression<E>& e, const xio_zstd_config& config)
+        {
+            using value_type = typename E::value_type;
+            const E& ex = e.derived_cast();
+            auto&& eval_ex = eval(ex);
+            auto shape = eval_ex.shape();
+            std::size_t size = compute_size(shape);
+            std::size_t uncompressed_size = size * sizeof(value_type);
+            const char* uncompressed_buffer;
+            xscratch_arena::buffer swapped_buffer;
+            if ((sizeof(value_type) > 1) && (config.big_endian != is_big_endian()))
+            {
+                swapped_buffer = scratch_arena().acquire(uncompressed_size);
+                copy_swap_endianness(eval_ex.data(), size, reinterpret_cast<value_type*>(swapped_buffer.data()));
+                uncompressed_buffer = swapped_buffer.data();
+            }
+            else
+            {
+                uncompressed_buffer = reinterpret_cast<const char*>(eval_ex.data());
+            }
+
+            ZSTD_CCtx* cctx = zstd_cctx();
+            if (config.dictionary != nullptr)
+            {
+                check_zstd(ZSTD_CCtx_refCDict(cctx, config.dictionary->cdict()), "loading dictionary");
+            }
+            else
+            {
+                check_zstd(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, config.level), "setting level");
+            }
+            if (config.long_distance_matching)
+            {
+                check_zstd(ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, 1), "enabling long distance matching");
+            }
+            if (config.window_log > 0)
+            {
+                check_zstd(ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, config.window_log), "setting window size");
+            }
+            if (config.nb_workers > 0)
+            {
+                // fails if zstd was built without multithreading support
+                check_zstd(ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, config.nb_workers), "setting workers");
+            }
+
+            std::size_t max_compressed_size = ZSTD_compressBound(uncompressed_size);
+            auto compressed_buffer = scratch_arena().acquire(max_compressed_size);
+            std::size_t compressed_size = ZSTD_compress2(cctx, compressed_buffer.data(), max_compressed_size, uncompressed_buffer, uncompressed_size);
+            check_zstd(compressed_size, "compression");
+            stream.write(compressed_buffer.data(), std::streamsize(compressed_size));
+            stream.flush();
+        }
+    }  // namespace detail
+
+    /**
+     * Save xexpression to Zstandard format
+     *
+     * @param stream An output stream to which to dump the data
+     * @param e the xexpression
+     * @param config the compression settings
+     */
+    template <typename E, class O>
+    inline void dump_zstd(O& stream, const xexpression<E>& e, const xio_zstd_config& config = xio_zstd_config())
+    {
+        detail::dump_zstd(stream, e, config);
+    }
+
+    template <typename E>
+    inline void dump_zstd(std::ostream& stream, const xexpression<E>& e, const xio_zstd_config& config = xio_zstd_config())
+    {
+        auto s = xostream_wrapper(stream);
+        detail::dump_zstd(s, e, config);
+    }
+
+    /**
+     * Save xexpression to Zstandard format
+     *
+     * @param filename The filename or path to dump the data
+     * @param e the xexpression
+     * @param config the compression settings
+     */
+    template <typename E>
+    inline void dump_zstd(const char* filename, const xexpression<E>& e, const xio_zstd_config& config = xio_zstd_config())
+    {
+        std::ofstream stream(filename, std::ofstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("Zstd: failed to open file ") + filename);
+        }
+        auto s = xostream_wrapper(stream);
+        detail::dump_zstd(s, e, config);
+    }
+
+    template <typename E>
+    inline void dump_zstd(const std::string& filename, const xexpression<E>& e, const xio_zstd_config& config = xio_zstd_config())
+    {
+        dump_zstd<E>(filename.c_str(), e, config);
+    }
+
+    /**
+     * Loads a Zstandard file
+     *
+     * @param stream An input stream from which to load the file
+     * @param config the settings, used for the endianness, the window size
+     *        and the dictionary
+     * @tparam T select the type of the Zstandard file
+     * @tparam L select layout_type::column_major if you stored data in
+     *           Fortran format
+     * @return xarray with contents from Zstandard file
+     */
+    template <typename T, layout_type L = layout_type::dynamic, class I>
+    inline auto load_zstd(I& stream, const xio_zstd_config& config = xio_zstd_config())
+    {
+        xt::svector<T> uncompressed_buffer = detail::load_zstd<T>(stream, config);
+        std::vector<std::size_t> shape = {uncompressed_buffer.size()};
+        auto array = adapt(std::move(uncompressed_buffer), shape);
+        return array;
+    }
+
+    /**
+     * Loads a Zstandard file
+     *
+     * @param filename The filename or path to the file
+     * @param config the settings, used for the endianness, the window size
+     *        and the dictionary
+     * @tparam T select the type of the Zstandard file
+     * @tparam L select layout_type::column_major if you stored data in
+     *           Fortran format
+     * @return xarray with contents from Zstandard file
+     */
+    template <typename T, layout_type L = layout_type::dynamic>
+    inline auto load_zstd(const char* filename, const xio_zstd_config& config = xio_zstd_config())
+    {
+        std::ifstream stream(filename, std::ifstream::binary);
+        if (!stream.is_open())
+        {
+            XTENSOR_THROW(std::runtime_error, std::string("Zstd: failed to open file ") + filename);
+        }
+        auto s = xistream_wrapper(stream);
+        return load_zstd<T, L>(s, config);
+    }
+
+    template <typename T, layout_type L = layout_type::dynamic>
+    inline auto load_zstd(const std::string& filename, const xio_zstd_config& config = xio_zstd_config())
+    {
+        return load_zstd<T, L>(filename.c_str(), config);
+    }
+
+    template <class E, class I>
+    void load_file(I& stream, xexpression<E>& e, const xio_zstd_config& config)
+    {
+        E& ex = e.derived_cast();
+        auto shape = ex.shape();
+        auto* data = detail::decode_destination(ex);
+        if (!shape.empty() && data != nullptr)
+        {
+            // the array already has the expected size
+            detail::load_zstd_into(stream, data, ex.size(), config);
+            return;
+        }
+        ex = load_zstd<typename E::value_type>(stream, config);
+        if (!shape.empty())
+        {
+            if (compute_size(shape) != ex.size())
+            {
+                XTENSOR_THROW(std::runtime_error, "load_file: size mismatch");
+            }
+            ex.reshape(shape);
+        }
+    }
+
+    template <class E, class O>
+    void dump_file(O& stream, const xexpression<E> &e, const xio_zstd_config& config)
+    {
+        dump_zstd(stream, e, config);
+    }
+}  // namespace xt
+
+#endif
@@ -0,0 +1,377 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_STORE_MANIFEST_HPP
+#define XTENSOR_IO_STORE_MANIFEST_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <xtensor/core/xtensor_config.hpp>
+
+namespace xt
+{
+    /**
+     * @class xmanifest_value
+     * @brief Value of an entry of a store manifest.
+     *
+     * The value is kept as text, and converted from and to booleans,
+     * numbers, strings and sequences of sizes.
+     */
+    class xmanifest_value
+    {
+    public:
+
+        template <class T>
+        xmanifest_value& operator=(const T& value);
+
+        xmanifest_value& operator=(const char* value);
+
+        template <class T>
+        T as() const;
+
+        template <class T, std::enable_if_t<std::is_arithmetic<T>::value, int> = 0>
+        operator T() const;
+
+        operator std::string() const;
+
+        const std::string& str() const noexcept;
+
+    private:
+
+        std::string m_text;
+    };
+
+    class xstore_manifest;
+
+    /**
+     * @class xmanifest_group
+     * @brief Entries of a store manifest sharing a prefix.
+     *
+     * A group is passed to the ``write_to`` and ``read_from`` methods of the
+     * format configurations, so that their entries do not collide with the
+     * entries of the store.
+     */
+    class xmanifest_group
+    {
+    public:
+
+        xmanifest_group(xstore_manifest& manifest, const std::string& name);
+
+        xmanifest_value& operator[](const std::string& key);
+
+    private:
+
+        xstore_manifest* p_manifest;
+        std::string m_prefix;
+    };
+
+    /**
+     * @class xstore_manifest
+     * @brief Metadata saved at the root of a chunk store.
+     *
+     * The manifest is a set of entries ``key=value``, one per line, which
+     * can be read back without knowing the stored array. Lines starting
+     * with ``#`` are ignored.
+     */
+    class xstore_manifest
+    {
+    public:
+
+        xmanifest_value& operator[](const std::string& key);
+        const xmanifest_value& operator[](const std::string& key) const;
+
+        bool contains(const std::string& key) const;
+        void erase(const std::string& key);
+        void update(const xstore_manifest& other);
+        xmanifest_group group(const std::string& name);
+
+        bool load(const std::string& path);
+        void save(const std::string& path) const;
+
+    private:
+
+        std::map<std::string, xmanifest_value> m_values;
+    };
+
+    /*********************************
+     * xmanifest_value implementation *
+     *********************************/
+
+    template <class T>
+    inline xmanifest_value& xmanifest_value::operator=(const T& value)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+        {
+            m_text = value ? "true" : "false";
+        }
+        else if constexpr (std::is_integral<T>::value)
+        {
+            m_text = std::is_signed<T>::value ? std::to_string(static_cast<long long>(value))
+                                              : std::to_string(static_cast<unsigned long long>(value));
+        }
+        else if constexpr (std::is_floating_point<T>::value)
+        {
+            // enough digits to read the same value back
+            char buffer[64];
+            std::snprintf(buffer, sizeof(buffer), "%.*Lg", std::numeric_limits<T>::max_digits10, static_cast<long double>(value));
+            m_text = buffer;
+        }
+        else if constexpr (std::is_convertible<T, std::string>::value)
+        {
+            m_text = value;
+        }
+        else
+        {
+            m_text.clear();
+            for (const auto& v: value)
+            {
+                if (!m_text.empty())
+                {
+                    m_text.push_back(',');
+                }
+                m_text.append(std::to_string(v));
+            }
+        }
+        return *this;
+    }
+
+    inline xmanifest_value& xmanifest_value::operator=(const char* value)
+    {
+        m_text = value;
+        return *this;
+    }
+
+    template <class T>
+    inline T xmanifest_value::as() const
+    {
+        if constexpr (std::is_same<T, bool>::value)
+        {
+            if (m_text != "true" && m_text != "false")
+            {
+                XTENSOR_THROW(std::runtime_error, "manifest: invalid boolean '" + m_text + "'");
+            }
+            return m_text == "true";
+        }
+        else if constexpr (std::is_arithmetic<T>::value)
+        {
+            if (m_text.empty())
+            {
+                XTENSOR_THROW(std::runtime_error, "manifest: missing value");
+            }
+            const char* first = m_text.c_str();
+            char* last = nullptr;
+            bool in_range = true;
+            T value;
+            if constexpr (std::is_floating_point<T>::value)
+            {
+                // subnormal values are read back, although strtold reports them
+                value = static_cast<T>(std::strtold(first, &last));
+            }
+            else if constexpr (std::is_signed<T>::value)
+            {
+                errno = 0;
+                long long v = std::strtoll(first, &last, 10);
+                in_range = errno == 0 &&
+                           v >= static_cast<long long>(std::numeric_limits<T>::min()) &&
+                           v <= static_cast<long long>(std::numeric_limits<T>::max());
+                value = static_cast<T>(v);
+            }
+            else
+            {
+                errno = 0;
+                unsigned long long v = std::strtoull(first, &last, 10);
+                in_range = errno == 0 && m_text[0] != '-' &&
+                           v <= static_cast<unsigned long long>(std::numeric_limits<T>::max());
+                value = static_cast<T>(v);
+            }
+            if (!in_range || last != first + m_text.size())
+            {
+                XTENSOR_THROW(std::runtime_error, "manifest: invalid number '" + m_text + "'");
+            }
+            return value;
+        }
+        else if constexpr (std::is_convertible<std::string, T>::value)
+        {
+            return m_text;
+        }
+        else
+        {
+            T values;
+            std::size_t first = 0;
+            while (first < m_text.size())
+            {
+                std::size_t last = m_text.find(',', first);
+                if (last == std::string::npos)
+                {
+                    last = m_text.size();
+                }
+                xmanifest_value item;
+                item.m_text = m_text.substr(first, last - first);
+                values.push_back(item.as<typename T::value_type>());
+                first = last + 1;
+            }
+            return values;
+        }
+    }
+
+    template <class T, std::enable_if_t<std::is_arithmetic<T>::value, int>>
+    inline xmanifest_value::operator T() const
+    {
+        return as<T>();
+    }
+
+    inline xmanifest_value::operator std::string() const
+    {
+        return m_text;
+    }
+
+    inline const std::string& xmanifest_value::str() const noexcept
+    {
+        return m_text;
+    }
+
+    /**********************************
+     * xmanifest_group implementation *
+     **********************************/
+
+    inline xmanifest_group::xmanifest_group(xstore_manifest& manifest, const std::string& name)
+        : p_manifest(&manifest)
+        , m_prefix(name + '.')
+    {
+    }
+
+    inline xmanifest_value& xmanifest_group::operator[](const std::string& key)
+    {
+        return (*p_manifest)[m_prefix + key];
+    }
+
+    /*********************************
+     * xstore_manifest implementation *
+     *********************************/
+
+    inline xmanifest_value& xstore_manifest::operator[](const std::string& key)
+    {
+        return m_values[key];
+    }
+
+    inline const xmanifest_value& xstore_manifest::operator[](const std::string& key) const
+    {
+        auto it = m_values.find(key);
+        if (it == m_values.end())
+        {
+            XTENSOR_THROW(std::runtime_error, "manifest: missing entry " + key);
+        }
+        return it->second;
+    }
+
+    inline bool xstore_manifest::contains(const std::string& key) const
+    {
+        return m_values.find(key) != m_values.end();
+    }
+
+    inline void xstore_manifest::erase(const std::string& key)
+    {
+        m_values.erase(key);
+    }
+
+    /**
+     * Copies the entries of another manifest, replacing the entries
+     * with the same keys.
+     */
+    inline void xstore_manifest::update(const xstore_manifest& other)
+    {
+        for (const auto& entry: other.m_values)
+        {
+            m_values[entry.first] = entry.second;
+        }
+    }
+
+    inline xmanifest_group xstore_manifest::group(const std::string& name)
+    {
+        return xmanifest_group(*this, name);
+    }
+
+    /**
+     * Loads the manifest from a file, replacing its entries.
+     *
+     * @param path The path of the file
+     * @return false if the file does not exist
+     */
+    inline bool xstore_manifest::load(const std::string& path)
+    {
+        std::ifstream in_file(path);
+        if (!in_file.is_open())
+        {
+            return false;
+        }
+        m_values.clear();
+        std::string line;
+        while (std::getline(in_file, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            std::size_t i = line.find('=');
+            if (i == std::string::npos)
+            {
+                XTENSOR_THROW(std::runtime_error, "manifest: invalid line in " + path);
+            }
+            m_values[line.substr(0, i)] = line.substr(i + 1);
+        }
+        return true;
+    }
+
+    /**
+     * Saves the manifest to a file. The file is written next to its
+     * destination and then renamed, so that readers never see a partial
+     * manifest.
+     *
+     * @param path The path of the file
+     */
+    inline void xstore_manifest::save(const std::string& path) const
+    {
+        namespace fs = std::filesystem;
+        std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream out_file(tmp_path, std::ofstream::trunc);
+            if (!out_file.is_open())
+            {
+                XTENSOR_THROW(std::runtime_error, "manifest: failed to open file " + tmp_path);
+            }
+            out_file << "# xtensor-io chunk store\n";
+            for (const auto& entry: m_values)
+            {
+                const std::string& value = entry.second.str();
+                if (entry.first.find_first_of("=\n") != std::string::npos || value.find('\n') != std::string::npos)
+                {
+                    XTENSOR_THROW(std::runtime_error, "manifest: invalid entry " + entry.first);
+                }
+                out_file << entry.first << '=' << value << '\n';
+            }
+            if (!out_file)
+            {
+                XTENSOR_THROW(std::runtime_error, "manifest: failed to write file " + tmp_path);
+            }
+        }
+        fs::rename(tmp_path, path);
+    }
+}
+
+#endif
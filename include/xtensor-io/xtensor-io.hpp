@@ -10,6 +10,31 @@
 #ifndef XTENSOR_IO_XTENSORIO_HPP
 #define XTENSOR_IO_XTENSORIO_HPP
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+#include "xio_scratch_arena.hpp"
+
+#ifndef XTENSOR_IO_SWAP_BLOCK_SIZE
+#define XTENSOR_IO_SWAP_BLOCK_SIZE 0x100000
+#endif
+
 namespace xt
 {
     enum class file_mode
@@ -36,15 +61,235 @@ namespace xt
         return bint.c[0] == 1;
     }
 
+    namespace detail
+    {
+        inline std::uint16_t byteswap(std::uint16_t value)
+        {
+#if defined(_MSC_VER)
+            return _byteswap_ushort(value);
+#else
+            return __builtin_bswap16(value);
+#endif
+        }
+
+        inline std::uint32_t byteswap(std::uint32_t value)
+        {
+#if defined(_MSC_VER)
+            return _byteswap_ulong(value);
+#else
+            return __builtin_bswap32(value);
+#endif
+        }
+
+        inline std::uint64_t byteswap(std::uint64_t value)
+        {
+#if defined(_MSC_VER)
+            return _byteswap_uint64(value);
+#else
+            return __builtin_bswap64(value);
+#endif
+        }
+
+        template <std::size_t N>
+        struct byteswap_uint;
+
+        template <>
+        struct byteswap_uint<2>
+        {
+            using type = std::uint16_t;
+        };
+
+        template <>
+        struct byteswap_uint<4>
+        {
+            using type = std::uint32_t;
+        };
+
+        template <>
+        struct byteswap_uint<8>
+        {
+            using type = std::uint64_t;
+        };
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+        // pshufb mask reversing each group of N bytes of a 128 bits lane
+        template <std::size_t N>
+        inline __m128i byteswap_mask()
+        {
+            char mask[16];
+            for (std::size_t k = 0; k < 16; ++k)
+            {
+                mask[k] = static_cast<char>((k / N) * N + (N - 1 - k % N));
+            }
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+        }
+#endif
+
+        // Reverses the bytes of size elements of N bytes from src to dst,
+        // which may be the same buffer.
+        template <std::size_t N>
+        inline void byteswap_copy(const char* src, std::size_t size, char* dst)
+        {
+            using uint_type = typename byteswap_uint<N>::type;
+            std::size_t i = 0;
+#if defined(__AVX2__)
+            const __m256i mask256 = _mm256_broadcastsi128_si256(byteswap_mask<N>());
+            for (; i + 32 / N <= size; i += 32 / N)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * N));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * N), _mm256_shuffle_epi8(v, mask256));
+            }
+#endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+            const __m128i mask = byteswap_mask<N>();
+            for (; i + 16 / N <= size; i += 16 / N)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * N));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * N), _mm_shuffle_epi8(v, mask));
+            }
+#elif defined(__ARM_NEON)
+            for (; i + 16 / N <= size; i += 16 / N)
+            {
+                uint8x16_t v = vld1q_u8(reinterpret_cast<const std::uint8_t*>(src + i * N));
+                if constexpr (N == 2)
+                {
+                    v = vrev16q_u8(v);
+                }
+                else if constexpr (N == 4)
+                {
+                    v = vrev32q_u8(v);
+                }
+                else
+                {
+                    v = vrev64q_u8(v);
+                }
+                vst1q_u8(reinterpret_cast<std::uint8_t*>(dst + i * N), v);
+            }
+#endif
+            for (; i < size; ++i)
+            {
+                uint_type value;
+                std::memcpy(&value, src + i * N, N);
+                value = byteswap(value);
+                std::memcpy(dst + i * N, &value, N);
+            }
+        }
+    }
+
+    /**
+     * Reverses the byte order of each element of a buffer, with SIMD
+     * kernels for the elements of 2, 4 and 8 bytes.
+     */
+    template <class T>
+    void swap_endianness(T* data, std::size_t size)
+    {
+        char* buf = reinterpret_cast<char*>(data);
+        if constexpr (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)
+        {
+            detail::byteswap_copy<sizeof(T)>(buf, size, buf);
+        }
+        else
+        {
+            char* end  = buf + size * sizeof(T);
+            while(buf != end)
+            {
+                std::reverse(buf, buf + sizeof(T));
+                buf += sizeof(T);
+            }
+        }
+    }
+
+    /**
+     * Copies a buffer while reversing the byte order of its elements, in a
+     * single pass over the memory.
+     */
+    template <class T>
+    void copy_swap_endianness(const T* src, std::size_t size, T* dst)
+    {
+        if constexpr (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)
+        {
+            detail::byteswap_copy<sizeof(T)>(reinterpret_cast<const char*>(src), size, reinterpret_cast<char*>(dst));
+        }
+        else if (size != 0)
+        {
+            std::memcpy(dst, src, size * sizeof(T));
+            swap_endianness(dst, size);
+        }
+    }
+
     template <class T>
     void swap_endianness(xt::svector<T>& buffer)
     {
-        char* buf = reinterpret_cast<char*>(buffer.data());
-        char* end  = buf + buffer.size() * sizeof(T);
-        while(buf != end)
+        swap_endianness(buffer.data(), buffer.size());
+    }
+
+    namespace detail
+    {
+        // Returns the contiguous storage of e, in which a file can be
+        // decoded in place, or nullptr if there is none.
+        template <class E>
+        inline typename E::value_type* decode_destination(E& e)
+        {
+            if constexpr (has_data_interface<E>::value)
+            {
+                if (e.is_contiguous())
+                {
+                    return e.data() + e.data_offset();
+                }
+            }
+            return nullptr;
+        }
+
+        template <class E, class = void>
+        struct is_resizable : std::false_type
+        {
+        };
+
+        template <class E>
+        struct is_resizable<E, std::void_t<decltype(std::declval<E&>().resize(std::declval<typename E::shape_type>()))>>
+            : std::true_type
+        {
+        };
+
+        // Returns the storage of e if it holds the elements in the order
+        // they are written, or nullptr if e must be iterated. A container
+        // is written in its own layout, like its evaluation.
+        template <class E>
+        inline const typename E::value_type* dump_source(const E& e)
+        {
+            if constexpr (has_data_interface<E>::value)
+            {
+                if (e.is_contiguous() && (is_resizable<E>::value || e.layout() == XTENSOR_DEFAULT_LAYOUT))
+                {
+                    return e.data() + e.data_offset();
+                }
+            }
+            return nullptr;
+        }
+
+        // Calls f(buffer, nbytes, last) on consecutive blocks of data, byte
+        // swapped in a scratch buffer of at most XTENSOR_IO_SWAP_BLOCK_SIZE
+        // bytes if swap is true, so that a writer never holds a full swapped
+        // copy of the data. f is called at least once.
+        template <class T, class F>
+        inline void for_each_swapped_block(const T* data, std::size_t size, bool swap, F&& f)
         {
-            std::reverse(buf, buf + sizeof(T));
-            buf += sizeof(T);
+            if (!swap)
+            {
+                f(reinterpret_cast<const char*>(data), size * sizeof(T), true);
+                return;
+            }
+            std::size_t block_size = std::max<std::size_t>(XTENSOR_IO_SWAP_BLOCK_SIZE / sizeof(T), 1);
+            xscratch_arena::buffer swapped = scratch_arena().acquire(std::min(block_size, size) * sizeof(T));
+            std::size_t i = 0;
+            do
+            {
+                std::size_t n = std::min(block_size, size - i);
+                copy_swap_endianness(data + i, n, reinterpret_cast<T*>(swapped.data()));
+                i += n;
+                f(static_cast<const char*>(swapped.data()), n * sizeof(T), i == size);
+            }
+            while (i != size);
         }
     }
 }
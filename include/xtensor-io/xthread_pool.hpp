@@ -0,0 +1,161 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#ifndef XTENSOR_IO_THREAD_POOL_HPP
+#define XTENSOR_IO_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xt
+{
+    /**
+     * @class xthread_pool
+     * @brief Fixed-size pool of worker threads.
+     *
+     * Tasks are run in submission order by the first available worker.
+     * The first exception thrown by a task is kept and rethrown by wait().
+     */
+    class xthread_pool
+    {
+    public:
+
+        explicit xthread_pool(std::size_t nthreads = std::thread::hardware_concurrency());
+        ~xthread_pool();
+
+        xthread_pool(const xthread_pool&) = delete;
+        xthread_pool& operator=(const xthread_pool&) = delete;
+
+        xthread_pool(xthread_pool&&) = delete;
+        xthread_pool& operator=(xthread_pool&&) = delete;
+
+        std::size_t size() const noexcept;
+
+        template <class F>
+        void submit(F&& task);
+
+        void wait();
+
+    private:
+
+        void run();
+
+        std::vector<std::thread> m_threads;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_task_cond;
+        std::condition_variable m_done_cond;
+        std::size_t m_running;
+        bool m_stop;
+        std::exception_ptr m_error;
+    };
+
+    /*******************************
+     * xthread_pool implementation *
+     *******************************/
+
+    inline xthread_pool::xthread_pool(std::size_t nthreads)
+        : m_running(0)
+        , m_stop(false)
+    {
+        nthreads = std::max<std::size_t>(nthreads, 1);
+        m_threads.reserve(nthreads);
+        for (std::size_t i = 0; i < nthreads; ++i)
+        {
+            m_threads.emplace_back([this]() { run(); });
+        }
+    }
+
+    inline xthread_pool::~xthread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_task_cond.notify_all();
+        // pending tasks are run before the workers exit
+        for (auto& thread: m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    inline std::size_t xthread_pool::size() const noexcept
+    {
+        return m_threads.size();
+    }
+
+    template <class F>
+    inline void xthread_pool::submit(F&& task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace_back(std::forward<F>(task));
+        }
+        m_task_cond.notify_one();
+    }
+
+    inline void xthread_pool::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done_cond.wait(lock, [this]() { return m_tasks.empty() && m_running == 0; });
+        if (m_error)
+        {
+            std::exception_ptr error = m_error;
+            m_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    inline void xthread_pool::run()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_task_cond.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+                if (m_tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+                ++m_running;
+            }
+            std::exception_ptr error;
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                --m_running;
+                if (error && !m_error)
+                {
+                    m_error = error;
+                }
+            }
+            m_done_cond.notify_all();
+        }
+    }
+}
+
+#endif
@@ -9,6 +9,10 @@
 
 #include "gtest/gtest.h"
 
+#include <cmath>
+#include <limits>
+
+#include <xtensor/generators/xbuilder.hpp>
 #include <xtensor/views/xbroadcast.hpp>
 #include "xtensor-io/xchunk_store_manager.hpp"
 #include "xtensor-io/xfile_array.hpp"
@@ -125,6 +129,35 @@ namespace xt
         }
     }
 
+    TEST(xchunked_array, fill_value_chunks)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files_fill";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        double nan = std::numeric_limits<double>::quiet_NaN();
+        auto a1 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 1, true, nan);
+        a1(0, 0) = 1.;
+        a1(0, 2) = 2.;
+        // the chunks only holding the init value are not written
+        a1(2, 0) = 3.;
+        a1(2, 0) = nan;
+        a1.chunks().flush();
+        EXPECT_TRUE(fs::exists(chunk_dir + "/0.0"));
+        EXPECT_TRUE(fs::exists(chunk_dir + "/0.1"));
+        EXPECT_FALSE(fs::exists(chunk_dir + "/1.0"));
+        EXPECT_FALSE(fs::exists(chunk_dir + "/1.1"));
+
+        // a chunk which becomes filled with the init value is removed
+        a1(0, 2) = nan;
+        a1.chunks().flush();
+        EXPECT_FALSE(fs::exists(chunk_dir + "/0.1"));
+        EXPECT_EQ(a1(0, 0), 1.);
+        EXPECT_TRUE(std::isnan(static_cast<double>(a1(0, 2))));
+        EXPECT_TRUE(std::isnan(static_cast<double>(a1(3, 3))));
+    }
+
     TEST(xchunked_array, shape_initializer_list)
     {
         auto a = chunked_file_array<double, xio_disk_handler<xio_binary_config>>({4, 4}, {2, 2}, "files3", 5.5);
@@ -154,4 +187,287 @@ namespace xt
         a1.chunks().configure(format_config, io_config);
         a1.chunks().flush();
     }
+
+    TEST(xchunked_array, lru_policy)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files4";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        auto a1 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 2);
+        a1(0, 0) = 1.;
+        a1(0, 2) = 2.;
+        double v = a1(0, 0);
+        EXPECT_EQ(v, 1.);
+        // chunk 0.1 is the least recently used, it is unloaded
+        a1(2, 0) = 3.;
+        EXPECT_TRUE(fs::exists(chunk_dir + "/0.1"));
+        EXPECT_FALSE(fs::exists(chunk_dir + "/0.0"));
+    }
+
+    TEST(xchunked_array, clock_policy)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files5";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        auto a1 = chunked_file_array<double, xio_disk_handler<xio_binary_config>, XTENSOR_DEFAULT_LAYOUT, xindex_path, xclock_policy>(shape, chunk_shape, chunk_dir, 2);
+        a1(0, 0) = 1.;
+        a1(0, 2) = 2.;
+        double v = a1(0, 0);
+        EXPECT_EQ(v, 1.);
+        // both chunks are referenced, the clock hand makes a full turn
+        // and unloads the first chunk
+        a1(2, 0) = 3.;
+        EXPECT_TRUE(fs::exists(chunk_dir + "/0.0"));
+        EXPECT_FALSE(fs::exists(chunk_dir + "/0.1"));
+        EXPECT_EQ(a1(0, 2), 2.);
+        EXPECT_EQ(a1(2, 0), 3.);
+    }
+
+    TEST(xchunked_array, pinned_policy)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files6";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        using policy_type = xpinned_policy<xlru_policy>;
+        auto a1 = chunked_file_array<double, xio_disk_handler<xio_binary_config>, XTENSOR_DEFAULT_LAYOUT, xindex_path, policy_type>(shape, chunk_shape, chunk_dir, 2);
+        a1.chunks().get_policy().pin(std::vector<size_t>({0, 0}));
+        a1(0, 0) = 1.;
+        a1(0, 2) = 2.;
+        a1(2, 0) = 3.;
+        a1(2, 2) = 4.;
+        // chunk 0.0 is pinned, the other chunks are unloaded in turn
+        EXPECT_FALSE(fs::exists(chunk_dir + "/0.0"));
+        EXPECT_TRUE(fs::exists(chunk_dir + "/0.1"));
+        EXPECT_TRUE(fs::exists(chunk_dir + "/1.0"));
+        EXPECT_EQ(a1(0, 0), 1.);
+    }
+
+    TEST(xchunked_array, lfu_policy)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files12";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        auto a1 = chunked_file_array<double, xio_disk_handler<xio_binary_config>, XTENSOR_DEFAULT_LAYOUT, xindex_path, xlfu_policy>(shape, chunk_shape, chunk_dir, 3);
+        // all the elements of chunk 0.0 in a row count as one access
+        a1(0, 0) = 1.;
+        a1(0, 1) = 1.;
+        a1(1, 0) = 1.;
+        a1(1, 1) = 1.;
+        a1(0, 2) = 2.;
+        a1(2, 0) = 3.;
+        a1(0, 3) = 2.;
+        // chunks 0.0 and 1.0 have been accessed once, 0.0 is the oldest
+        a1(2, 2) = 4.;
+        EXPECT_TRUE(fs::exists(chunk_dir + "/0.0"));
+        EXPECT_FALSE(fs::exists(chunk_dir + "/1.0"));
+    }
+
+    TEST(xchunked_array, pool_stats)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files7";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        auto a1 = chunked_file_array<double, xio_disk_handler<xio_binary_config>, XTENSOR_DEFAULT_LAYOUT, xindex_path, xarc_policy>(shape, chunk_shape, chunk_dir, 0.5, 2);
+        a1(0, 0) = 1.;
+        a1(0, 2) = 2.;
+        a1.chunks().reset_pool_stats();
+        a1(0, 0) = 3.;
+        a1(0, 1) = 4.;
+        a1(2, 0) = 5.;
+        a1(2, 1) = 6.;
+        const auto& stats = a1.chunks().pool_stats();
+        // (0, 1) and (2, 1) are in the chunks of the previous accesses
+        EXPECT_EQ(stats.misses, 1u);
+        EXPECT_EQ(stats.hits, 1u);
+        EXPECT_EQ(stats.evictions, 1u);
+        EXPECT_EQ(stats.hit_ratio(), 0.5);
+    }
+
+    TEST(xchunked_array, write_back)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files8";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        auto a1 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 1);
+        a1.chunks().set_write_back(2);
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            for (std::size_t j = 0; j < 4; ++j)
+            {
+                a1(i, j) = double(i * 4 + j);
+            }
+        }
+        // chunks are read back after their pending write
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            for (std::size_t j = 0; j < 4; ++j)
+            {
+                EXPECT_EQ(a1(i, j), double(i * 4 + j));
+            }
+        }
+        a1.chunks().flush();
+
+        std::ifstream in_file(chunk_dir + "/1.1");
+        auto i1 = xt::xistream_wrapper(in_file);
+        xt::xarray<double> data = xt::load_bin<double>(i1);
+        xt::xarray<double> ref = {10., 11., 14., 15.};
+        EXPECT_TRUE(xt::all(xt::equal(data, ref)));
+    }
+
+    TEST(xchunked_array, prefetch)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files9";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        {
+            auto a1 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 4);
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+                for (std::size_t j = 0; j < 4; ++j)
+                {
+                    a1(i, j) = double(i * 4 + j);
+                }
+            }
+            a1.chunks().flush();
+        }
+
+        auto a2 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 3);
+        a2.chunks().set_prefetch(2);
+        a2.chunks().reset_pool_stats();
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            for (std::size_t j = 0; j < 4; ++j)
+            {
+                EXPECT_EQ(a2(i, j), double(i * 4 + j));
+            }
+        }
+        EXPECT_GT(a2.chunks().pool_stats().prefetches, 0u);
+
+        // a copy has its own prefetcher and collects the chunks
+        // prefetched by the original
+        auto a3 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 3);
+        a3.chunks().set_prefetch(2);
+        a3.chunks().set_write_back(1);
+        EXPECT_EQ(a3(0, 0), 0.);
+        auto a4 = a3;
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            for (std::size_t j = 0; j < 4; ++j)
+            {
+                EXPECT_EQ(a4(i, j), double(i * 4 + j));
+            }
+        }
+        EXPECT_EQ(a3(0, 2), 2.);
+    }
+
+    TEST(xchunked_array, parallel_assign)
+    {
+        std::vector<size_t> shape = {5, 5};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files10";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        auto a1 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 2);
+        // the chunks are written by the workers with the format of a1
+        xio_binary_config format_config;
+        format_config.big_endian = !is_big_endian();
+        xio_disk_config io_config;
+        a1.chunks().configure(format_config, io_config);
+        a1.chunks().set_assign_threads(3);
+        xt::xarray<double> ref = xt::arange<double>(25.);
+        ref.reshape({5, 5});
+        a1 = ref;
+        for (std::size_t i = 0; i < 5; ++i)
+        {
+            for (std::size_t j = 0; j < 5; ++j)
+            {
+                EXPECT_EQ(a1(i, j), ref(i, j));
+            }
+        }
+    }
+
+    TEST(xchunked_array, chunk_handle)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files11";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        auto a1 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 2);
+        {
+            auto handle = a1.chunks().chunk(0, 1);
+            (*handle)(0, 0) = 1.5;
+            // the other chunks go through the single unpinned slot
+            a1(2, 0) = 2.5;
+            a1(3, 3) = 3.5;
+            EXPECT_EQ(handle->path(), chunk_dir + "/0.1");
+            double v = (*handle)(0, 0);
+            EXPECT_EQ(v, 1.5);
+            EXPECT_EQ(a1(0, 2), 1.5);
+        }
+        a1.chunks().flush();
+
+        auto a2 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 1);
+        auto handle = a2.chunks().chunk(0, 0);
+        EXPECT_THROW(a2(3, 3), std::runtime_error);
+        handle.reset();
+        EXPECT_EQ(a2(3, 3), 3.5);
+    }
+
+    TEST(xchunked_array, manifest)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files_manifest";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        EXPECT_THROW(open_chunked_file_array<double, xio_disk_handler<xio_binary_config>>(chunk_dir), std::runtime_error);
+        {
+            auto a1 = make_test_chunked_array(shape, chunk_shape, chunk_dir, 2, true, 1.5);
+            xio_binary_config format_config;
+            format_config.big_endian = !is_big_endian();
+            xio_disk_config io_config;
+            io_config.create_directories = true;
+            a1.chunks().configure(format_config, io_config);
+            a1.chunks().set_manifest(true);
+            a1(0, 0) = 2.;
+            a1(3, 3) = 4.;
+            a1.chunks().flush();
+        }
+        EXPECT_TRUE(fs::exists(chunk_dir + "/xstore.manifest"));
+        // a chunk missing from the index is not read
+        fs::copy_file(chunk_dir + "/0.0", chunk_dir + "/0.1");
+
+        auto a2 = open_chunked_file_array<double, xio_disk_handler<xio_binary_config>>(chunk_dir, 2);
+        EXPECT_TRUE(a2.chunks().has_manifest());
+        EXPECT_TRUE(std::equal(a2.shape().cbegin(), a2.shape().cend(), shape.cbegin(), shape.cend()));
+        EXPECT_EQ(a2(0, 0), 2.);
+        EXPECT_EQ(a2(3, 3), 4.);
+        EXPECT_EQ(a2(0, 2), 1.5);
+        a2(2, 0) = 3.;
+        a2.chunks().flush();
+
+        xstore_manifest manifest;
+        EXPECT_TRUE(manifest.load(chunk_dir + "/xstore.manifest"));
+        EXPECT_EQ(manifest["grid_shape"].str(), "2,2");
+        // chunks 0.0, 1.0 and 1.1
+        EXPECT_EQ(manifest["chunks"].str(), "d");
+        EXPECT_EQ(manifest["dtype"].str(), "float64");
+        EXPECT_EQ(manifest["codec"].str(), "binary");
+        EXPECT_EQ(manifest["codec.big_endian"].as<bool>(), !is_big_endian());
+    }
 }
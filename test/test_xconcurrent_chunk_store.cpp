@@ -0,0 +1,146 @@
+/***************************************************************************
+* Copyright (c) Johan Mabille, Sylvain Corlay and Wolf Vollprecht          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "xtensor-io/xconcurrent_chunk_store.hpp"
+#include "xtensor-io/xchunk_store_manager.hpp"
+#include "xtensor-io/xfile_array.hpp"
+#include "xtensor-io/xio_binary.hpp"
+#include "xtensor-io/xio_disk_handler.hpp"
+
+namespace xt
+{
+    namespace fs = std::filesystem;
+
+    using test_chunk_type = xfile_array<double, xio_disk_handler<xio_binary_config>>;
+
+    inline void make_test_store(const std::vector<size_t>& shape,
+                                const std::vector<size_t>& chunk_shape,
+                                const std::string& chunk_dir)
+    {
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        auto a = chunked_file_array<double, xio_disk_handler<xio_binary_config>>(shape, chunk_shape, chunk_dir, 2);
+        for (std::size_t i = 0; i < shape[0]; ++i)
+        {
+            for (std::size_t j = 0; j < shape[1]; ++j)
+            {
+                a(i, j) = double(i * shape[1] + j);
+            }
+        }
+        a.chunks().flush();
+    }
+
+    TEST(xconcurrent_chunk_store, concurrent_read)
+    {
+        std::vector<size_t> shape = {10, 10};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files_concurrent1";
+        make_test_store(shape, chunk_shape, chunk_dir);
+
+        xconcurrent_chunk_store<test_chunk_type> store(shape, chunk_shape, chunk_dir, 8, 4);
+        EXPECT_EQ(store.get_nb_shards(), 4u);
+        std::atomic<std::size_t> errors(0);
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&store, &errors, t]()
+            {
+                for (std::size_t n = 0; n < 100; ++n)
+                {
+                    std::size_t i = (n + t * 3) % 10;
+                    std::size_t j = (n * 7 + t) % 10;
+                    if (store(i, j) != double(i * 10 + j))
+                    {
+                        ++errors;
+                    }
+                }
+            });
+        }
+        for (auto& thread: threads)
+        {
+            thread.join();
+        }
+        EXPECT_EQ(errors.load(), 0u);
+        // accesses to the chunk of the previous access of a shard are not counted
+        xchunk_pool_stats stats = store.pool_stats();
+        EXPECT_GT(stats.misses, 0u);
+        EXPECT_LE(stats.hits + stats.misses, 400u);
+    }
+
+    TEST(xconcurrent_chunk_store, pinned_chunk)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files_concurrent2";
+        make_test_store(shape, chunk_shape, chunk_dir);
+
+        xconcurrent_chunk_store<test_chunk_type> store(shape, chunk_shape, chunk_dir, 2, 1);
+        auto handle = store.chunk(0, 1);
+        // the other chunks go through the single unpinned slot
+        EXPECT_EQ(store(2, 0), 8.);
+        EXPECT_EQ(store(3, 3), 15.);
+        EXPECT_EQ(store(0, 0), 0.);
+        const test_chunk_type& chunk = *handle;
+        EXPECT_EQ(chunk(0, 0), 2.);
+        EXPECT_EQ(chunk(1, 1), 7.);
+        EXPECT_EQ(store.pool_stats().evictions, 2u);
+    }
+
+    TEST(xconcurrent_chunk_store, evict_dirty_chunk)
+    {
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files_concurrent3";
+        make_test_store(shape, chunk_shape, chunk_dir);
+
+        xconcurrent_chunk_store<test_chunk_type> store(shape, chunk_shape, chunk_dir, 2, 1);
+        // the writes are synchronized with the reads, but not the
+        // evictions of the modified chunk by the writer thread
+        std::mutex mutex;
+        double last = 0.;
+        std::atomic<std::size_t> errors(0);
+        std::thread writer([&]()
+        {
+            for (std::size_t n = 1; n <= 50; ++n)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto handle = store.chunk(0, 0);
+                    (*handle)(0, 0) = double(n);
+                    last = double(n);
+                }
+                store(0, 2);
+                store(2, 0);
+                store(2, 2);
+            }
+        });
+        std::thread reader([&]()
+        {
+            for (std::size_t n = 0; n < 100; ++n)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (store(0, 0) != last)
+                {
+                    ++errors;
+                }
+            }
+        });
+        writer.join();
+        reader.join();
+        EXPECT_EQ(errors.load(), 0u);
+        store.flush();
+        EXPECT_EQ(store(0, 0), 50.);
+    }
+}
@@ -9,6 +9,7 @@
 
 #include "gtest/gtest.h"
 
+#include <xtensor/generators/xbuilder.hpp>
 #include <xtensor/views/xbroadcast.hpp>
 #include "xtensor-io/xfile_array.hpp"
 #include "xtensor-io/xio_binary.hpp"
@@ -63,6 +64,79 @@ namespace xt
         in_file.close();
     }
 
+    TEST(xfile_array, bulk_assign)
+    {
+        std::vector<std::size_t> shape = {2, 3};
+        auto a = xfile_array<double, xio_disk_handler<xio_binary_config>>(broadcast(0., shape), "a3");
+        a.flush();
+
+        xarray<double> b = {{1., 2., 3.}, {4., 5., 6.}};
+        a = b;
+        noalias(a) += b;
+        a *= 2.;
+        xarray<double> ref = 4. * b;
+        EXPECT_TRUE(xt::all(xt::equal(a, ref)));
+
+        // the assignments are written by the next flush
+        a.flush();
+        std::ifstream in_file("a3");
+        auto i = xt::xistream_wrapper(in_file);
+        auto data = load_bin<double>(i);
+        data.reshape(shape);
+        EXPECT_TRUE(xt::all(xt::equal(data, ref)));
+    }
+
+    TEST(xfile_array, dirty_blocks)
+    {
+        xarray<double> ref = arange<double>(100);
+        {
+            auto a = xfile_array<double, xio_disk_handler<xio_binary_config>>(ref, "a4");
+        }
+
+        // blocks of 8 elements
+        xio_binary_config format_config;
+        format_config.dirty_block_size = 8 * sizeof(double);
+        xio_disk_config io_config;
+        io_config.create_directories = false;
+        xfile_array<double, xio_disk_handler<xio_binary_config>> a("a4");
+        a.configure(format_config, io_config);
+        EXPECT_TRUE(xt::all(xt::equal(a, ref)));
+
+        // modify the file behind the array, in the first block
+        {
+            std::fstream file("a4", std::fstream::in | std::fstream::out | std::fstream::binary);
+            double v = -1.;
+            file.write(reinterpret_cast<const char*>(&v), sizeof(double));
+        }
+        a(50) = 0.;
+        a(51) = 0.;
+        a.flush();
+        ref(50) = 0.;
+        ref(51) = 0.;
+        // only the block of the modified elements is written
+        ref(0) = -1.;
+
+        std::ifstream in_file("a4", std::ifstream::binary);
+        auto i = xt::xistream_wrapper(in_file);
+        auto data = load_bin<double>(i);
+        EXPECT_TRUE(xt::all(xt::equal(data, ref)));
+    }
+
+    TEST(xfile_array, missing_file)
+    {
+        xio_disk_handler<xio_binary_config> handler;
+        xarray<double> data;
+        EXPECT_FALSE(handler.try_read(data, "missing_file"));
+        EXPECT_THROW(handler.read(data, "missing_file"), std::runtime_error);
+
+        // a missing file is initialized without exception
+        xfile_array<double, xio_disk_handler<xio_binary_config>> a("", xfile_mode::init_on_fail, 2.);
+        a.resize({2, 2});
+        a.set_path("missing_file");
+        EXPECT_TRUE(xt::all(xt::equal(a, 2.)));
+        EXPECT_THROW((xfile_array<double, xio_disk_handler<xio_binary_config>>("missing_file")), std::runtime_error);
+    }
+
     TEST(xfile_array, flush)
     {
         std::vector<std::size_t> shape = {2, 2};
@@ -9,12 +9,32 @@
 
 #include "gtest/gtest.h"
 
+#include "xtensor/generators/xbuilder.hpp"
+#include "xtensor/views/xview.hpp"
 #include "xtensor-io/xio_binary.hpp"
 #include "xtensor-io/xio_stream_wrapper.hpp"
 #include "xtensor-io/xio_file_wrapper.hpp"
 
 namespace xt
 {
+    TEST(xio_binary, swap_endianness)
+    {
+        // sizes not multiple of the SIMD width
+        xarray<uint16_t> a16 = xt::arange<uint16_t>(37);
+        xarray<uint32_t> a32 = xt::arange<uint32_t>(37);
+        xarray<uint64_t> a64 = xt::arange<uint64_t>(37);
+        swap_endianness(a16.data(), a16.size());
+        swap_endianness(a32.data(), a32.size());
+        xarray<uint64_t> b64 = zeros<uint64_t>({37});
+        copy_swap_endianness(a64.data(), a64.size(), b64.data());
+        for (std::size_t i = 0; i < 37; ++i)
+        {
+            EXPECT_EQ(a16(i), uint16_t(i << 8));
+            EXPECT_EQ(a32(i), uint32_t(i << 24));
+            EXPECT_EQ(b64(i), uint64_t(i) << 56);
+        }
+    }
+
     TEST(xio_binary, dump_load_stream)
     {
         xtensor<double, 2> data
@@ -54,4 +74,59 @@ namespace xt
 
         ASSERT_TRUE(all(equal(a, data)));
     }
+
+    TEST(xio_binary, load_in_place)
+    {
+        xtensor<double, 2> data
+            {{ 1.0,  2.0,  3.0,  4.0},
+             {10.0, 12.0, 15.0, 18.0}};
+
+        const char* fname = "data_in_place.bin";
+        {
+            std::ofstream out_file(fname, std::ofstream::binary);
+            auto o = xt::xostream_wrapper(out_file);
+            dump_file(o, data, xio_binary_config());
+        }
+
+        xarray<double> a = zeros<double>({2, 4});
+        const double* storage = a.data();
+        {
+            std::ifstream in_file(fname, std::ifstream::binary);
+            auto i = xt::xistream_wrapper(in_file);
+            load_file(i, a, xio_binary_config());
+        }
+        EXPECT_EQ(a.data(), storage);
+        EXPECT_TRUE(all(equal(a, data)));
+
+        xarray<double> b = zeros<double>({3, 4});
+        std::ifstream in_file(fname, std::ifstream::binary);
+        auto i = xt::xistream_wrapper(in_file);
+        EXPECT_THROW(load_file(i, b, xio_binary_config()), std::runtime_error);
+    }
+
+    TEST(xio_binary, dump_load_view)
+    {
+        // views and lazy expressions are written without being evaluated,
+        // in several blocks
+        xarray<double> data = xt::arange<double>(400000);
+        data.reshape({200000, 2});
+        auto column = xt::view(data, xt::all(), 1);
+        std::string s = dump_bin(column, !is_big_endian());
+        xtensor<double, 1> expected = column;
+        EXPECT_EQ(s, dump_bin(expected, !is_big_endian()));
+        EXPECT_EQ(dump_bin(2.0 * data), dump_bin(xarray<double>(2.0 * data)));
+
+        // and read back into a view
+        xarray<double> a = zeros<double>({200000, 2});
+        auto a_column = xt::view(a, xt::all(), 1);
+        std::istringstream in_stream(s);
+        auto i = xt::xistream_wrapper(in_stream);
+        load_bin(i, a_column, !is_big_endian());
+        EXPECT_TRUE(all(equal(a_column, column)));
+        EXPECT_TRUE(all(equal(xt::view(a, xt::all(), 0), 0.0)));
+
+        std::istringstream short_stream(s.substr(8));
+        auto j = xt::xistream_wrapper(short_stream);
+        EXPECT_THROW(load_bin(j, a_column), std::runtime_error);
+    }
 }
@@ -10,8 +10,11 @@
 #include <cstdint>
 #include <sstream>
 #include <exception>
+#include <thread>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "xtensor/generators/xbuilder.hpp"
 #include "xtensor-io/xio_blosc.hpp"
 
 namespace xt
@@ -41,4 +44,47 @@ namespace xt
         auto a2 = load_blosc<dtype>("a1.blosc");
         EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
     }
+
+    TEST(xblosc, threads)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(100000);
+        xio_blosc_config config;
+        config.nthreads = 4;
+
+        // concurrent writers with different settings must not interfere
+        std::vector<std::string> buffers(4);
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < buffers.size(); ++i)
+        {
+            threads.emplace_back([&, i]()
+            {
+                xio_blosc_config c = config;
+                c.clevel = int(i) + 1;
+                c.blocksize = i % 2 ? 0 : 16384;
+                std::stringstream stream;
+                auto s = xostream_wrapper(stream);
+                dump_file(s, a1, c);
+                buffers[i] = stream.str();
+            });
+        }
+        for (auto& t: threads)
+        {
+            t.join();
+        }
+
+        for (const auto& buffer: buffers)
+        {
+            std::istringstream stream(buffer);
+            auto s = xistream_wrapper(stream);
+            xarray<dtype> a2 = zeros<dtype>({100000});
+            load_file(s, a2, config);
+            EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+        }
+
+        config.cname = "unknown";
+        std::stringstream stream;
+        auto s = xostream_wrapper(stream);
+        EXPECT_THROW(dump_file(s, a1, config), std::runtime_error);
+    }
 }
@@ -0,0 +1,59 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cstdint>
+#include <sstream>
+#include <exception>
+
+#include "gtest/gtest.h"
+#include "xtensor/generators/xbuilder.hpp"
+#include "xtensor/views/xview.hpp"
+#include "xtensor-io/xio_blosc2.hpp"
+
+namespace xt
+{
+    TEST(xblosc2, save_load)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = {0, 1, 2, 3};
+        dump_blosc2("a1.blosc2", a1);
+        auto a2 = load_blosc2<dtype>("a1.blosc2");
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+    }
+
+    TEST(xblosc2, filters)
+    {
+        using dtype = int64_t;
+        xarray<dtype> a1 = xt::arange<dtype>(100000);
+        xio_blosc2_config config;
+        config.shuffle = BLOSC_BITSHUFFLE;
+        config.delta = true;
+        config.nthreads = 2;
+        std::stringstream stream;
+        auto o = xostream_wrapper(stream);
+        dump_file(o, a1, config);
+
+        xarray<dtype> a2 = zeros<dtype>({100000});
+        auto i = xistream_wrapper(stream);
+        load_file(i, a2, config);
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+    }
+
+    TEST(xblosc2, load_range)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(100000);
+        xio_blosc2_config config;
+        config.blocksize = 4096;
+        dump_blosc2("a2.blosc2", a1, config);
+        auto a2 = load_blosc2_range<dtype>("a2.blosc2", 50000, 10);
+        EXPECT_TRUE(xt::all(xt::equal(a2, xt::view(a1, xt::range(50000, 50010)))));
+        EXPECT_THROW(load_blosc2_range<dtype>("a2.blosc2", 99995, 10), std::runtime_error);
+    }
+}
@@ -12,6 +12,7 @@
 #include <exception>
 
 #include "gtest/gtest.h"
+#include "xtensor/generators/xbuilder.hpp"
 #include "xtensor-io/xio_gzip.hpp"
 
 namespace xt
@@ -40,4 +41,58 @@ namespace xt
         auto a2 = load_gzip<dtype>("a1.gz");
         EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
     }
+
+    TEST(xgzip, save_load_large)
+    {
+        // larger than the inflate chunks, and than the initial output size
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(100000);
+        dump_gzip("a2.gz", a1);
+        auto a2 = load_gzip<dtype>("a2.gz");
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+    }
+
+    TEST(xgzip, save_load_swapped)
+    {
+        // swapped in several blocks of XTENSOR_IO_SWAP_BLOCK_SIZE bytes
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(300000);
+        dump_gzip("a5.gz", a1, !is_big_endian());
+        auto a2 = load_gzip<dtype>("a5.gz", !is_big_endian());
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+        dump_gzip("a6.gz", a1, !is_big_endian(), 1, 4);
+        auto a3 = load_gzip<dtype>("a6.gz", !is_big_endian(), 4);
+        EXPECT_TRUE(xt::all(xt::equal(a1, a3)));
+    }
+
+    TEST(xgzip, load_size_mismatch)
+    {
+        // 3 bytes cannot be loaded as doubles
+        xarray<char> a1 = {'a', 'b', 'c'};
+        dump_gzip("a3.gz", a1);
+        EXPECT_THROW(load_gzip<double>("a3.gz"), std::runtime_error);
+    }
+
+    TEST(xgzip, threads)
+    {
+        // several blocks of GZIP_BLOCK_SIZE bytes
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(300000);
+        dump_gzip("a4.gz", a1, is_big_endian(), 1, 4);
+        auto a2 = load_gzip<dtype>("a4.gz", is_big_endian(), 4);
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+        // the members are also readable sequentially
+        auto a3 = load_gzip<dtype>("a4.gz");
+        EXPECT_TRUE(xt::all(xt::equal(a1, a3)));
+
+        xio_gzip_config config;
+        config.nthreads = 4;
+        std::stringstream stream;
+        auto o = xostream_wrapper(stream);
+        dump_file(o, a1, config);
+        xarray<dtype> a4 = zeros<dtype>({300000});
+        auto i = xistream_wrapper(stream);
+        load_file(i, a4, config);
+        EXPECT_TRUE(xt::all(xt::equal(a1, a4)));
+    }
 }
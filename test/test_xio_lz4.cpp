@@ -0,0 +1,56 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cstdint>
+#include <sstream>
+#include <exception>
+
+#include "gtest/gtest.h"
+#include "xtensor/generators/xbuilder.hpp"
+#include "xtensor-io/xio_lz4.hpp"
+
+namespace xt
+{
+    TEST(xlz4, save_load)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = {0, 1, 2, 3};
+        dump_lz4("a1.lz4", a1);
+        auto a2 = load_lz4<dtype>("a1.lz4");
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+    }
+
+    TEST(xlz4, load_file)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(100000);
+        for (bool high_compression: {false, true})
+        {
+            xio_lz4_config config;
+            config.high_compression = high_compression;
+            config.acceleration = 4;
+            std::stringstream stream;
+            auto o = xostream_wrapper(stream);
+            dump_file(o, a1, config);
+
+            xarray<dtype> a2 = zeros<dtype>({100000});
+            auto i = xistream_wrapper(stream);
+            load_file(i, a2, config);
+            EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+        }
+
+        xio_lz4_config config;
+        std::stringstream stream;
+        auto o = xostream_wrapper(stream);
+        dump_file(o, a1, config);
+        xarray<dtype> a3 = zeros<dtype>({1000});
+        auto i = xistream_wrapper(stream);
+        EXPECT_THROW(load_file(i, a3, config), std::runtime_error);
+    }
+}
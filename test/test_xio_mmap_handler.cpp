@@ -0,0 +1,95 @@
+/***************************************************************************
+* Copyright (c) Johan Mabille, Sylvain Corlay and Wolf Vollprecht          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include "xtensor-io/xchunk_store_manager.hpp"
+#include "xtensor-io/xio_binary.hpp"
+#include "xtensor-io/xio_mmap_handler.hpp"
+
+namespace xt
+{
+    namespace fs = std::filesystem;
+
+    TEST(xio_mmap_handler, mapped_file)
+    {
+        xt::xarray<double> ref = {1., 2., 3., 4.};
+        {
+            std::ofstream out_file("mmap_file", std::ofstream::binary);
+            dump_bin(out_file, ref);
+        }
+
+        xmmap_file_array<double> a("mmap_file", xfile_mode::load);
+        EXPECT_TRUE(a.storage().storage().is_mapped());
+        EXPECT_TRUE(xt::all(xt::equal(a, ref)));
+
+        a(2) = 5.;
+        a.flush();
+        std::ifstream in_file("mmap_file", std::ifstream::binary);
+        auto i1 = xistream_wrapper(in_file);
+        xt::xarray<double> data = load_bin<double>(i1);
+        ref(2) = 5.;
+        EXPECT_TRUE(xt::all(xt::equal(data, ref)));
+    }
+
+    TEST(xio_mmap_handler, read_only_file)
+    {
+        xt::xarray<double> ref = {1., 2., 3., 4.};
+        {
+            std::ofstream out_file("mmap_file_ro", std::ofstream::binary);
+            dump_bin(out_file, ref);
+        }
+        fs::permissions("mmap_file_ro", fs::perms::owner_read | fs::perms::group_read | fs::perms::others_read);
+        {
+            xmmap_file_array<double> a("mmap_file_ro", xfile_mode::load);
+            EXPECT_TRUE(a.storage().storage().is_mapped());
+            EXPECT_TRUE(xt::all(xt::equal(a, ref)));
+        }
+        fs::permissions("mmap_file_ro", fs::perms::owner_write, fs::perm_options::add);
+
+        // a file holding a partial element is not truncated
+        {
+            std::ofstream out_file("mmap_file_ro", std::ofstream::binary | std::ofstream::app);
+            out_file.put('x');
+        }
+        EXPECT_THROW(xmmap_file_array<double>("mmap_file_ro", xfile_mode::load), std::runtime_error);
+    }
+
+    TEST(xio_mmap_handler, chunked_array)
+    {
+        using chunk_storage = xchunk_store_manager<xmmap_file_array<double>>;
+        std::vector<size_t> shape = {4, 4};
+        std::vector<size_t> chunk_shape = {2, 2};
+        std::string chunk_dir = "files_mmap";
+        fs::remove_all(chunk_dir);
+        fs::create_directory(chunk_dir);
+        {
+            chunk_storage chunks(shape, chunk_shape, chunk_dir, 2);
+            xchunked_array<chunk_storage> a1(std::move(chunks), shape, chunk_shape);
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+                for (std::size_t j = 0; j < 4; ++j)
+                {
+                    a1(i, j) = double(i * 4 + j);
+                }
+            }
+            a1.chunks().flush();
+        }
+
+        chunk_storage chunks(shape, chunk_shape, chunk_dir, 2);
+        xchunked_array<chunk_storage> a2(std::move(chunks), shape, chunk_shape);
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            for (std::size_t j = 0; j < 4; ++j)
+            {
+                EXPECT_EQ(a2(i, j), double(i * 4 + j));
+            }
+        }
+    }
+}
@@ -0,0 +1,75 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include "gtest/gtest.h"
+
+#include "xtensor-io/xio_binary.hpp"
+#include "xtensor-io/xio_scratch_arena.hpp"
+#include "xtensor-io/xio_stream_wrapper.hpp"
+
+namespace xt
+{
+    TEST(xscratch_arena, reuse)
+    {
+        xscratch_arena arena;
+        {
+            auto b = arena.acquire(1000);
+            EXPECT_EQ(b.size(), std::size_t(1000));
+        }
+        EXPECT_EQ(arena.stats().allocations, std::size_t(1));
+        EXPECT_EQ(arena.stats().reuses, std::size_t(0));
+        EXPECT_EQ(arena.cached_buffers(), std::size_t(1));
+
+        const char* storage = nullptr;
+        {
+            auto b = arena.acquire(500);
+            storage = b.data();
+        }
+        {
+            auto b = arena.acquire(1000);
+            EXPECT_EQ(b.data(), storage);
+        }
+        EXPECT_EQ(arena.stats().allocations, std::size_t(1));
+        EXPECT_EQ(arena.stats().reuses, std::size_t(2));
+        EXPECT_EQ(arena.stats().bytes_reused, std::size_t(1500));
+
+        arena.release();
+        EXPECT_EQ(arena.cached_buffers(), std::size_t(0));
+        EXPECT_EQ(arena.cached_bytes(), std::size_t(0));
+    }
+
+    TEST(xscratch_arena, codec)
+    {
+        xtensor<double, 2> data
+            {{ 1.0,  2.0,  3.0,  4.0},
+             {10.0, 12.0, 15.0, 18.0}};
+
+        // writing in the non-native endianness needs a swapped copy
+        xio_binary_config config;
+        config.big_endian = !is_big_endian();
+
+        const char* fname = "data_scratch.bin";
+        xscratch_arena& arena = scratch_arena();
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            std::ofstream out_file(fname, std::ofstream::binary);
+            auto o = xt::xostream_wrapper(out_file);
+            dump_file(o, data, config);
+        }
+        // the first write may allocate, the following ones reuse
+        EXPECT_GE(arena.stats().reuses, std::size_t(2));
+
+        xarray<double> a;
+        std::ifstream in_file(fname, std::ifstream::binary);
+        auto i = xt::xistream_wrapper(in_file);
+        load_file(i, a, config);
+        a.reshape({2, 4});
+        EXPECT_TRUE(all(equal(a, data)));
+    }
+}
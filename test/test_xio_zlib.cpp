@@ -12,6 +12,7 @@
 #include <exception>
 
 #include "gtest/gtest.h"
+#include "xtensor/generators/xbuilder.hpp"
 #include "xtensor-io/xio_zlib.hpp"
 
 namespace xt
@@ -41,4 +42,98 @@ namespace xt
         auto a2 = load_zlib<dtype>("a1.zl");
         EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
     }
+
+    TEST(xzlib, load_in_place)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = {{0, 1, 2, 3}, {4, 5, 6, 7}};
+        {
+            std::ofstream out_file("a3.zl", std::ofstream::binary);
+            auto o = xostream_wrapper(out_file);
+            dump_file(o, a1, xio_zlib_config());
+        }
+        xarray<dtype> a2 = zeros<dtype>({2, 4});
+        const dtype* storage = a2.data();
+        std::ifstream in_file("a3.zl", std::ifstream::binary);
+        auto i = xistream_wrapper(in_file);
+        load_file(i, a2, xio_zlib_config());
+        EXPECT_EQ(a2.data(), storage);
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+    }
+
+    TEST(xzlib, save_load_large)
+    {
+        // larger than the inflate chunks, and than the initial output size
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(100000);
+        dump_zlib("a2.zl", a1);
+        auto a2 = load_zlib<dtype>("a2.zl");
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+    }
+
+    TEST(xzlib, save_load_swapped)
+    {
+        // swapped in several blocks of XTENSOR_IO_SWAP_BLOCK_SIZE bytes
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(300000);
+        dump_zlib("a7.zl", a1, !is_big_endian(), 1, true);
+        auto a2 = load_zlib<dtype>("a7.zl", !is_big_endian());
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+        auto a3 = load_zlib_range<dtype>("a7.zl", 200000, 10, !is_big_endian());
+        EXPECT_TRUE(xt::all(xt::equal(a3, xt::arange<dtype>(200000, 200010))));
+    }
+
+    TEST(xzlib, load_size_mismatch)
+    {
+        // 3 bytes cannot be loaded as doubles
+        xarray<char> a1 = {'a', 'b', 'c'};
+        dump_zlib("a4.zl", a1);
+        EXPECT_THROW(load_zlib<double>("a4.zl"), std::runtime_error);
+    }
+
+    TEST(xzlib, load_range)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(1000000);
+        // index built while compressing
+        dump_zlib("a5.zl", a1, is_big_endian(), 1, true);
+        auto a2 = load_zlib_range<dtype>("a5.zl", 700000, 1000);
+        EXPECT_TRUE(xt::all(xt::equal(a2, xt::arange<dtype>(700000, 701000))));
+
+        // index built by the first read
+        dump_zlib("a6.zl", a1);
+        std::ifstream in_file("a6.zl", std::ifstream::binary);
+        xzlib_index index = build_zlib_index(in_file);
+        EXPECT_GT(index.points.size(), std::size_t(1));
+        auto a3 = load_zlib_range<dtype>(in_file, index, 999990, 10);
+        EXPECT_TRUE(xt::all(xt::equal(a3, xt::arange<dtype>(999990, 1000000))));
+        auto a4 = load_zlib_range<dtype>("a6.zl", 123456, 10);
+        EXPECT_TRUE(xt::all(xt::equal(a4, xt::arange<dtype>(123456, 123466))));
+        EXPECT_EQ(load_zlib_index("a6.zl.idx").compressed_size, index.compressed_size);
+
+        EXPECT_THROW(load_zlib_range<dtype>("a6.zl", 999990, 11), std::runtime_error);
+    }
+
+    TEST(xzlib, load_range_stale_index)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = xt::arange<dtype>(1000);
+        xarray<dtype> a2 = xt::arange<dtype>(1000, 2000);
+        // without compression, both files have the same size
+        dump_zlib("a8.zl", a1, is_big_endian(), 0, true);
+        xzlib_index stale_index = load_zlib_index("a8.zl.idx");
+        {
+            // the stream overload doesn't update the index
+            std::ofstream out_file("a8.zl", std::ofstream::binary);
+            dump_zlib(out_file, a2, is_big_endian(), 0);
+        }
+        std::ifstream in_file("a8.zl", std::ifstream::binary);
+        xzlib_index index = build_zlib_index(in_file);
+        EXPECT_EQ(index.compressed_size, stale_index.compressed_size);
+        EXPECT_NE(index.adler32, stale_index.adler32);
+
+        auto a3 = load_zlib_range<dtype>("a8.zl", 500, 10);
+        EXPECT_TRUE(xt::all(xt::equal(a3, xt::arange<dtype>(1500, 1510))));
+        EXPECT_EQ(load_zlib_index("a8.zl.idx").adler32, index.adler32);
+    }
 }
@@ -0,0 +1,156 @@
+/***************************************************************************
+* Copyright (c) Wolf Vollprecht, Sylvain Corlay and Johan Mabille          *
+* Copyright (c) QuantStack                                                 *
+*                                                                          *
+* Distributed under the terms of the BSD 3-Clause License.                 *
+*                                                                          *
+* The full license is in the file LICENSE, distributed with this software. *
+****************************************************************************/
+
+#include <cstdint>
+#include <sstream>
+#include <exception>
+
+#include "gtest/gtest.h"
+#include "xtensor/generators/xbuilder.hpp"
+#include "xtensor-io/xchunk_store_manager.hpp"
+#include "xtensor-io/xio_disk_handler.hpp"
+#include "xtensor-io/xio_zstd.hpp"
+
+namespace xt
+{
+    TEST(xzstd, save_load)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = {0, 1, 2, 3};
+        dump_zstd("a1.zst", a1);
+        auto a2 = load_zstd<dtype>("a1.zst");
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+    }
+
+    TEST(xzstd, load_file)
+    {
+        using dtype = int32_t;
+        xarray<dtype> a1 = xt::arange<dtype>(100000);
+        xio_zstd_config config;
+        config.level = 1;
+        config.long_distance_matching = true;
+        config.big_endian = !is_big_endian();
+        std::stringstream stream;
+        auto o = xostream_wrapper(stream);
+        dump_file(o, a1, config);
+
+        xarray<dtype> a2 = zeros<dtype>({100000});
+        auto i = xistream_wrapper(stream);
+        load_file(i, a2, config);
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+    }
+
+    TEST(xzstd, dictionary)
+    {
+        using dtype = double;
+        xarray<dtype> a1 = {0, 1, 2, 3};
+        std::string content(1024, 'x');
+        xio_zstd_config config;
+        config.dictionary = std::make_shared<xzstd_dictionary>(content, 5);
+        std::stringstream stream;
+        auto o = xostream_wrapper(stream);
+        dump_file(o, a1, config);
+
+        auto i = xistream_wrapper(stream);
+        auto a2 = load_zstd<dtype>(i, config);
+        EXPECT_TRUE(xt::all(xt::equal(a1, a2)));
+    }
+
+    TEST(xzstd, store_dictionary)
+    {
+        namespace fs = std::filesystem;
+        std::vector<std::size_t> shape = {256, 256};
+        std::vector<std::size_t> chunk_shape = {16, 16};
+        std::string chunk_dir = "files_zstd_dict";
+        fs::remove_all(chunk_dir);
+        xio_disk_config io_config;
+        {
+            auto a1 = chunked_file_array<double, xio_disk_handler<xio_zstd_config>>(shape, chunk_shape, chunk_dir, 256);
+            for (std::size_t i = 0; i < shape[0]; ++i)
+            {
+                for (std::size_t j = 0; j < shape[1]; ++j)
+                {
+                    a1(i, j) = double((i * 7 + j) % 50);
+                }
+            }
+            xio_zstd_config format_config;
+            a1.chunks().train_dictionary(format_config, io_config);
+            EXPECT_NE(format_config.dictionary, nullptr);
+            a1.chunks().flush();
+        }
+        EXPECT_TRUE(fs::exists(fs::path(chunk_dir) / "zstd.dict"));
+
+        // the dictionary is read from the store
+        auto a2 = chunked_file_array<double, xio_disk_handler<xio_zstd_config>>(shape, chunk_shape, chunk_dir, 2);
+        xio_zstd_config format_config;
+        a2.chunks().configure(format_config, io_config);
+        EXPECT_NE(format_config.dictionary, nullptr);
+        EXPECT_EQ(a2(0, 0), 0.);
+        EXPECT_EQ(a2(100, 200), double((100 * 7 + 200) % 50));
+        EXPECT_EQ(a2(255, 255), double((255 * 7 + 255) % 50));
+    }
+
+    TEST(xzstd, store_dictionary_retrain)
+    {
+        namespace fs = std::filesystem;
+        std::vector<std::size_t> shape = {256, 256};
+        std::vector<std::size_t> chunk_shape = {16, 16};
+        std::string chunk_dir = "files_zstd_retrain";
+        fs::remove_all(chunk_dir);
+        xio_disk_config io_config;
+        unsigned int first_id = 0;
+        {
+            auto a1 = chunked_file_array<double, xio_disk_handler<xio_zstd_config>>(shape, chunk_shape, chunk_dir, 256);
+            for (std::size_t i = 0; i < shape[0]; ++i)
+            {
+                for (std::size_t j = 0; j < shape[1]; ++j)
+                {
+                    a1(i, j) = double((i * 7 + j) % 50);
+                }
+            }
+            xio_zstd_config format_config;
+            a1.chunks().train_dictionary(format_config, io_config);
+            first_id = format_config.dictionary->id();
+            a1.chunks().flush();
+        }
+        {
+            // only the chunks of the first rows are written with the
+            // new dictionary
+            auto a1 = chunked_file_array<double, xio_disk_handler<xio_zstd_config>>(shape, chunk_shape, chunk_dir, 256);
+            xio_zstd_config format_config;
+            a1.chunks().configure(format_config, io_config);
+            for (std::size_t i = 0; i < shape[0]; ++i)
+            {
+                for (std::size_t j = 0; j < shape[1]; ++j)
+                {
+                    if (i < chunk_shape[0])
+                    {
+                        a1(i, j) = double((i * 13 + j * 3) % 90);
+                    }
+                    else
+                    {
+                        EXPECT_EQ(a1(i, j), double((i * 7 + j) % 50));
+                    }
+                }
+            }
+            a1.chunks().train_dictionary(format_config, io_config);
+            EXPECT_NE(format_config.dictionary->id(), first_id);
+            a1.chunks().flush();
+        }
+        EXPECT_TRUE(fs::exists(fs::path(chunk_dir) / ("zstd." + std::to_string(first_id) + ".dict")));
+
+        auto a2 = chunked_file_array<double, xio_disk_handler<xio_zstd_config>>(shape, chunk_shape, chunk_dir, 2);
+        xio_zstd_config format_config;
+        a2.chunks().configure(format_config, io_config);
+        EXPECT_EQ(format_config.previous_dictionaries.size(), 1u);
+        EXPECT_EQ(a2(3, 5), double((3 * 13 + 5 * 3) % 90));
+        EXPECT_EQ(a2(100, 200), double((100 * 7 + 200) % 50));
+        EXPECT_EQ(a2(255, 255), double((255 * 7 + 255) % 50));
+    }
+}